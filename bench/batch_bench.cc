@@ -0,0 +1,58 @@
+#include "batch_runner.h"
+
+#include <chrono>
+#include <iostream>
+
+// Emulated frames per second of a batch of headless instances with 1 thread up to all hardware threads
+auto main(int argc, char* argv[]) -> int
+{
+	if (argc < 2) {
+		std::cout << "Usage " << argv[0] << " rom... [--instances n] [--frames n]\n";
+		return 1;
+	}
+
+	auto roms = std::vector<std::string>{};
+	auto instances_per_rom = size_t{64};
+	auto frames = uint64_t{60};
+
+	for (auto i = 1; i < argc; ++i) {
+		const auto arg = std::string(argv[i]);
+		if (arg == "--instances" && i + 1 < argc) {
+			instances_per_rom = std::stoul(argv[++i]);
+		}
+		else if (arg == "--frames" && i + 1 < argc) {
+			frames = std::stoul(argv[++i]);
+		}
+		else {
+			roms.push_back(arg);
+		}
+	}
+
+	auto paths = std::vector<std::string>{};
+	for (const auto& rom : roms) { paths.insert(end(paths), instances_per_rom, rom); }
+
+	// 1, 2, 4, ... and all hardware threads
+	const auto max_threads = std::max(size_t{1}, size_t{std::thread::hardware_concurrency()});
+	auto thread_counts = std::vector<size_t>{};
+	for (auto threads = size_t{1}; threads < max_threads; threads *= 2) { thread_counts.push_back(threads); }
+	thread_counts.push_back(max_threads);
+
+	auto single_thread_fps = 0.0;
+
+	for (const auto& threads : thread_counts) {
+		auto batch = BatchRunner{paths, threads};
+
+		const auto start = std::chrono::steady_clock::now();
+		batch.run_frames(frames);
+		const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		const auto fps = static_cast<double>(frames * batch.size()) / seconds;
+		if (threads == 1) {
+			single_thread_fps = fps;
+		}
+
+		std::cout << threads << " threads: " << fps << " frames/s, " << fps / single_thread_fps << "x\n";
+	}
+
+	return 0;
+}
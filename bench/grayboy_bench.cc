@@ -0,0 +1,402 @@
+#include "emulator.h"
+#include "perf_counters.h"
+#include "synthetic_roms.h"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+// Throughput of the emulator over a ROM corpus, median and p95 over repetitions as JSON, so builds can be compared.
+// Without ROMs given it runs the synthetic ones (see synthetic_roms.h), the same in every build and on every machine.
+//
+// Per ROM:
+//   instructions_per_second  CPU, timer and interupts (execute_next) without the PPU
+//   headless_fps             run_frame() without the PPU
+//   headless_ppu_fps         run_frame() with the PPU rendering frames
+//   sdl_fps                  run_frame() and presentation through SDL (the dummy video driver unless set otherwise)
+//   component_ms             time per emulated frame of CPU, timer, PPU and present
+//
+// Components are not timed inside the emulator, it would slow down what's measured. Timer is replayed alone with the
+// same number of updates, the rest are differences of the runs above: cpu = headless - timer, ppu = headless_ppu -
+// headless, present = sdl - headless_ppu.
+//
+// With --perf, host counters (cycles, instructions, branch and L1d misses) of every run are reported too, both per
+// emulated instruction and per emulated frame. Instructions of the frame runs are counted in a separate untimed run.
+// Counters are left out if the kernel doesn't allow them, see /proc/sys/kernel/perf_event_paranoid.
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+volatile uint8_t timer_sink = {};
+
+struct Rom {
+	std::string name = {};
+	std::vector<uint8_t> bytes = {};
+};
+
+auto read_rom(const std::string& path) -> Rom
+{
+	auto file = std::ifstream(path, std::ios::binary);
+	if (!file) {
+		throw std::runtime_error("Can't read " + path);
+	}
+	return {std::filesystem::path(path).filename().string(), std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {})};
+}
+
+struct Options {
+	std::vector<Rom> roms = {};
+	std::string write_corpus = {};
+	uint32_t repetitions = 5;
+	uint32_t frames = 300;
+	bool sdl = true;
+	bool perf = false;
+	std::string output = {};
+};
+
+struct Samples {
+	std::vector<double> values = {};
+
+	[[nodiscard]] auto percentile(const double& p) const -> double
+	{
+		auto sorted = values;
+		std::sort(begin(sorted), end(sorted));
+		return sorted[static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5)];
+	}
+};
+
+// Host counters of one kind over repetitions, normalized by emulated instructions or frames
+struct CounterSamples {
+	std::array<Samples, PerfCounters::COUNTERS> counters = {};
+
+	auto add(const PerfCounters::Counts& counts, const double& units) -> void
+	{
+		for (auto i = size_t{0}; i < counts.size(); ++i) {
+			if (counts[i]) {
+				counters[i].values.push_back(*counts[i] / units);
+			}
+		}
+	}
+};
+
+// Host counters of one run, both ways
+struct RunCounters {
+	CounterSamples per_instruction = {};
+	CounterSamples per_frame = {};
+
+	auto add(const PerfCounters::Counts& counts, const double& instructions, const double& frames) -> void
+	{
+		per_instruction.add(counts, instructions);
+		per_frame.add(counts, frames);
+	}
+};
+
+auto seconds_since(const Clock::time_point& start) -> double
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+struct Run {
+	double seconds = {};
+	// Empty without --perf
+	PerfCounters::Counts counts = {};
+};
+
+template<typename Work>
+auto measure(PerfCounters* perf, const Work& work) -> Run
+{
+	if (perf != nullptr) {
+		perf->start();
+	}
+	const auto start = Clock::now();
+	work();
+	auto run = Run{.seconds = seconds_since(start)};
+	if (perf != nullptr) {
+		run.counts = perf->stop();
+	}
+	return run;
+}
+
+// Also gives `instructions` and `cycles` of the run
+auto run_instructions(const Rom& rom, const uint64_t& cycles_to_run, PerfCounters* perf, uint64_t& instructions, uint64_t& cycles) -> Run
+{
+	auto emulator = Emulator<true>{Cartridge{rom.bytes}};
+	instructions = 0;
+	cycles = 0;
+
+	return measure(perf, [&] {
+		while (cycles < cycles_to_run) {
+			cycles += emulator.execute_next();
+			++instructions;
+		}
+	});
+}
+
+// Instructions of `frames` frames, the same in every run of the ROM
+auto count_instructions(const Rom& rom, const bool& ppu, const uint32_t& frames) -> uint64_t
+{
+	auto emulator = Emulator<true>{Cartridge{rom.bytes}};
+	emulator.set_headless_rendering(ppu);
+	auto instructions = uint64_t{0};
+	while (emulator.frames() < frames) {
+		emulator.step();
+		++instructions;
+	}
+	return instructions;
+}
+
+template<bool headless>
+auto run_frames(Emulator<headless>& emulator, const uint32_t& frames, PerfCounters* perf) -> Run
+{
+	return measure(perf, [&] {
+		for (auto frame = uint32_t{0}; frame < frames; ++frame) {
+			emulator.run_frame();
+			emulator.present_frame();
+		}
+	});
+}
+
+// Timer alone, `updates` updates of the average instruction length
+auto run_timer(const Rom& rom, const uint64_t& updates, const uint64_t& cycles_per_update) -> double
+{
+	auto memory = Memory{Cartridge{rom.bytes}};
+	auto timer = Timer{};
+	// Fastest frequency, enabled
+	memory.write(0xff07, 0x05);
+
+	const auto run = measure(nullptr, [&] {
+		for (auto i = uint64_t{0}; i < updates; ++i) { timer.update(memory, cycles_per_update); }
+	});
+
+	// Keep the loop
+	timer_sink = memory.direct_read(0xff05);
+	return run.seconds;
+}
+
+auto parse_options(const int& argc, char* argv[]) -> Options
+{
+	auto options = Options{};
+	for (auto i = 1; i < argc; ++i) {
+		const auto arg = std::string(argv[i]);
+		const auto has_value = i + 1 < argc;
+		if (arg == "--repetitions" && has_value) {
+			options.repetitions = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--frames" && has_value) {
+			options.frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--output" && has_value) {
+			options.output = argv[++i];
+		}
+		else if (arg == "--corpus" && has_value) {
+			auto paths = std::vector<std::string>{};
+			for (const auto& entry : std::filesystem::directory_iterator(argv[++i])) {
+				if (entry.path().extension() == ".gb") {
+					paths.push_back(entry.path().string());
+				}
+			}
+			std::sort(begin(paths), end(paths));
+			for (const auto& path : paths) { options.roms.push_back(read_rom(path)); }
+		}
+		else if (arg == "--write-corpus" && has_value) {
+			options.write_corpus = argv[++i];
+		}
+		else if (arg == "--no-sdl") {
+			options.sdl = false;
+		}
+		else if (arg == "--perf") {
+			options.perf = true;
+		}
+		else {
+			options.roms.push_back(read_rom(arg));
+		}
+	}
+
+	if (options.roms.empty()) {
+		for (auto& synthetic : synthetic_roms()) { options.roms.push_back({synthetic.name + ".gb", std::move(synthetic.rom)}); }
+	}
+	options.repetitions = std::max(options.repetitions, uint32_t{1});
+	options.frames = std::max(options.frames, uint32_t{1});
+	return options;
+}
+
+auto json_string(const std::string& value) -> std::string
+{
+	auto result = std::string{"\""};
+	for (const auto& c : value) {
+		if (c == '"' || c == '\\') {
+			result += '\\';
+		}
+		result += c;
+	}
+	return result + '"';
+}
+
+auto json_samples(const Samples& samples) -> std::string
+{
+	if (samples.values.empty()) {
+		return "null";
+	}
+
+	auto out = std::ostringstream{};
+	out << "{\"median\": " << samples.percentile(0.5) << ", \"p95\": " << samples.percentile(0.95) << "}";
+	return out.str();
+}
+
+auto json_counters(const CounterSamples& samples) -> std::string
+{
+	auto out = std::string{"{"};
+	for (auto i = size_t{0}; i < samples.counters.size(); ++i) {
+		out += (i == 0 ? "\"" : ", \"") + std::string(PerfCounters::NAMES[i]) + "\": " + json_samples(samples.counters[i]);
+	}
+	return out + "}";
+}
+
+auto json_counters(const RunCounters& samples) -> std::string
+{
+	return "{\"per_instruction\": " + json_counters(samples.per_instruction) + ", \"per_frame\": " + json_counters(samples.per_frame)
+	  + "}";
+}
+
+} // namespace
+
+auto main(int argc, char* argv[]) -> int
+{
+	if (argc > 1 && (std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")) {
+		std::cout << "Usage: " << argv[0] << " [--corpus dir] [--repetitions n] [--frames n] [--no-sdl] [--perf] [--output file.json]"
+		          << " [--write-corpus dir] [rom...]\n";
+		return 0;
+	}
+	const auto options = parse_options(argc, argv);
+
+	// Synthetic ROMs as files, e.g. to run them in other emulators
+	if (!options.write_corpus.empty()) {
+		std::filesystem::create_directories(options.write_corpus);
+		for (const auto& synthetic : synthetic_roms()) {
+			auto file = std::ofstream(std::filesystem::path(options.write_corpus) / (synthetic.name + ".gb"), std::ios::binary);
+			file.write(reinterpret_cast<const char*>(synthetic.rom.data()), static_cast<std::streamsize>(synthetic.rom.size()));
+		}
+		return 0;
+	}
+
+	// No window on the screen, SDL still does all the work of presenting
+	::setenv("SDL_VIDEODRIVER", "dummy", 0);
+
+	auto perf_counters = std::optional<PerfCounters>{};
+	if (options.perf) {
+		perf_counters.emplace();
+		if (!perf_counters->error().empty()) {
+			std::cerr << "Some host counters are not available (" << perf_counters->error() << ")\n";
+		}
+	}
+	auto* perf = perf_counters && perf_counters->available() ? &*perf_counters : nullptr;
+
+	auto json = std::ostringstream{};
+	json << "{\n  \"repetitions\": " << options.repetitions << ",\n  \"frames\": " << options.frames << ",\n";
+	if (options.perf) {
+		json << "  \"host_counters_available\": " << (perf != nullptr ? "true" : "false") << ",\n";
+	}
+	json << "  \"roms\": [";
+
+	for (auto rom_index = size_t{0}; rom_index < options.roms.size(); ++rom_index) {
+		const auto& rom = options.roms[rom_index];
+		std::cerr << "Running " << rom.name << '\n';
+
+		auto instructions_per_second = Samples{};
+		auto headless_fps = Samples{};
+		auto headless_ppu_fps = Samples{};
+		auto sdl_fps = Samples{};
+		auto cpu_ms = Samples{};
+		auto timer_ms = Samples{};
+		auto ppu_ms = Samples{};
+		auto present_ms = Samples{};
+		auto instructions_counters = RunCounters{};
+		auto headless_counters = RunCounters{};
+		auto headless_ppu_counters = RunCounters{};
+		auto sdl_counters = RunCounters{};
+
+		// Frames with the PPU don't have a fixed length, SDL runs the same frames as headless with the PPU
+		const auto frames = static_cast<double>(options.frames);
+		const auto headless_instructions = perf != nullptr ? static_cast<double>(count_instructions(rom, false, options.frames)) : 0.0;
+		const auto ppu_instructions = perf != nullptr ? static_cast<double>(count_instructions(rom, true, options.frames)) : 0.0;
+
+		for (auto repetition = uint32_t{0}; repetition < options.repetitions; ++repetition) {
+			auto instructions = uint64_t{};
+			auto cycles = uint64_t{};
+			const auto frame_cycles = uint64_t{70'224 / 4};
+			const auto instructions_run = run_instructions(rom, frame_cycles * options.frames, perf, instructions, cycles);
+			instructions_per_second.values.push_back(static_cast<double>(instructions) / instructions_run.seconds);
+			// Frames of the instruction run are frame lengths of emulated cycles
+			const auto instruction_run_frames = static_cast<double>(cycles) / static_cast<double>(frame_cycles);
+			instructions_counters.add(instructions_run.counts, static_cast<double>(instructions), instruction_run_frames);
+
+			auto headless = Emulator<true>{Cartridge{rom.bytes}};
+			const auto headless_run = run_frames(headless, options.frames, perf);
+			const auto headless_frame = headless_run.seconds / options.frames;
+			headless_fps.values.push_back(1.0 / headless_frame);
+			headless_counters.add(headless_run.counts, headless_instructions, frames);
+
+			auto with_ppu = Emulator<true>{Cartridge{rom.bytes}};
+			with_ppu.set_headless_rendering(true);
+			const auto ppu_run = run_frames(with_ppu, options.frames, perf);
+			const auto ppu_frame = ppu_run.seconds / options.frames;
+			headless_ppu_fps.values.push_back(1.0 / ppu_frame);
+			headless_ppu_counters.add(ppu_run.counts, ppu_instructions, frames);
+
+			const auto cycles_per_update = std::max(uint64_t{1}, cycles / std::max(instructions, uint64_t{1}));
+			const auto timer_frame = run_timer(rom, instructions, cycles_per_update) / options.frames;
+
+			timer_ms.values.push_back(timer_frame * 1000);
+			cpu_ms.values.push_back((headless_frame - timer_frame) * 1000);
+			ppu_ms.values.push_back((ppu_frame - headless_frame) * 1000);
+
+			if (options.sdl) {
+				auto sdl = Emulator<false>{Cartridge{rom.bytes}};
+				sdl.set_turbo_settings(TurboSettings{.speed = 0, .skip_frames = 0, .frames = 1});
+				sdl.set_turbo(true);
+				const auto sdl_run = run_frames(sdl, options.frames, perf);
+				const auto sdl_frame = sdl_run.seconds / options.frames;
+				sdl_fps.values.push_back(1.0 / sdl_frame);
+				sdl_counters.add(sdl_run.counts, ppu_instructions, frames);
+				present_ms.values.push_back((sdl_frame - ppu_frame) * 1000);
+			}
+		}
+
+		json << (rom_index == 0 ? "\n" : ",\n") << "    {\n";
+		json << "      \"rom\": " << json_string(rom.name) << ",\n";
+		json << "      \"instructions_per_second\": " << json_samples(instructions_per_second) << ",\n";
+		json << "      \"headless_fps\": " << json_samples(headless_fps) << ",\n";
+		json << "      \"headless_ppu_fps\": " << json_samples(headless_ppu_fps) << ",\n";
+		if (options.sdl) {
+			json << "      \"sdl_fps\": " << json_samples(sdl_fps) << ",\n";
+		}
+		json << "      \"component_ms\": {\"cpu\": " << json_samples(cpu_ms) << ", \"timer\": " << json_samples(timer_ms)
+		     << ", \"ppu\": " << json_samples(ppu_ms);
+		if (options.sdl) {
+			json << ", \"present\": " << json_samples(present_ms);
+		}
+		json << "}";
+		if (perf != nullptr) {
+			json << ",\n      \"host_counters\": {\n";
+			json << "        \"instructions\": " << json_counters(instructions_counters) << ",\n";
+			json << "        \"headless\": " << json_counters(headless_counters) << ",\n";
+			json << "        \"headless_ppu\": " << json_counters(headless_ppu_counters);
+			if (options.sdl) {
+				json << ",\n        \"sdl\": " << json_counters(sdl_counters);
+			}
+			json << "\n      }";
+		}
+		json << "\n    }";
+	}
+	json << "\n  ]\n}\n";
+
+	if (options.output.empty()) {
+		std::cout << json.str();
+	}
+	else {
+		auto file = std::ofstream{options.output};
+		file << json.str();
+	}
+	return 0;
+}
@@ -0,0 +1,62 @@
+#include "lockstep_batch.h"
+
+#include <chrono>
+#include <iostream>
+
+// Instructions per second of 16 separate interpreters against LockstepBatch with and without AVX2.
+// Both run the CPU only, games waiting for an interupt or LY just spin.
+auto main(int argc, char* argv[]) -> int
+{
+	if (argc < 2) {
+		std::cout << "Usage " << argv[0] << " rom [--steps n]\n";
+		return 1;
+	}
+
+	auto steps = 1'000'000;
+	for (auto i = 2; i + 1 < argc; ++i) {
+		if (std::string(argv[i]) == "--steps") {
+			steps = std::stoi(argv[++i]);
+		}
+	}
+
+	const auto cartridge = Cartridge{argv[1]};
+	const auto initial = RegistersChanger{.AF = 0x01b0, .BC = 0x0013, .DE = 0x00d8, .HL = 0x014d, .PC = 0x0100, .SP = 0xfffe}.get(Registers{});
+	const auto lanes = LockstepBatch::LANES;
+
+	const auto seconds_since = [](const auto& start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	};
+
+	auto cpus = std::vector<Cpu>(lanes, Cpu{initial});
+	auto memories = std::vector<Memory>{};
+	for (auto lane = size_t{0}; lane < lanes; ++lane) { memories.emplace_back(Cartridge{cartridge}); }
+
+	auto start = std::chrono::steady_clock::now();
+	for (auto step = 0; step < steps; ++step) {
+		for (auto lane = size_t{0}; lane < lanes; ++lane) {
+			[[maybe_unused]] const auto cycles = cpus[lane].execute_next(memories[lane]);
+		}
+	}
+	const auto scalar_rate = static_cast<double>(steps) * lanes / seconds_since(start);
+	std::cout << "separate interpreters: " << scalar_rate / 1e6 << " M instructions/s\n";
+
+	for (const auto avx2 : {false, true}) {
+		auto batch = LockstepBatch{cartridge, initial};
+		batch.set_avx2(avx2);
+		if (avx2 && !batch.avx2()) {
+			std::cout << "AVX2 not supported\n";
+			continue;
+		}
+
+		start = std::chrono::steady_clock::now();
+		for (auto step = 0; step < steps; ++step) { batch.step(); }
+		const auto rate = static_cast<double>(steps) * lanes / seconds_since(start);
+
+		const auto vectorized = static_cast<double>(batch.vectorized_instructions());
+		const auto share = vectorized / (vectorized + static_cast<double>(batch.scalar_instructions()));
+		std::cout << "lockstep" << (avx2 ? " avx2" : "") << ": " << rate / 1e6 << " M instructions/s, " << rate / scalar_rate
+		          << "x, " << share * 100 << "% vectorized\n";
+	}
+
+	return 0;
+}
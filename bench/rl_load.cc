@@ -0,0 +1,64 @@
+#include "rl_client.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+
+// Drives a running rl_server with random actions and reports environment steps per second and request latency
+auto main(int argc, char* argv[]) -> int
+{
+	auto socket_path = std::string{"/tmp/grayboy-rl.sock"};
+	auto requests = 2'000;
+
+	for (auto i = 1; i + 1 < argc; ++i) {
+		const auto arg = std::string(argv[i]);
+		if (arg == "--socket") {
+			socket_path = argv[++i];
+		}
+		else if (arg == "--requests") {
+			requests = std::atoi(argv[++i]);
+		}
+	}
+
+	// Percentiles need at least one latency
+	if (requests <= 0) {
+		std::cout << "Usage: " << argv[0] << " [--socket path] [--requests n], n > 0\n";
+		return 1;
+	}
+
+	auto client = RlClient{socket_path};
+	auto actions = std::vector<uint8_t>(client.envs());
+	auto random = std::mt19937{42};
+	auto checksum = uint64_t{0};
+
+	client.reset(std::vector<uint8_t>(client.envs(), 1));
+
+	auto latencies = std::vector<double>{};
+	latencies.reserve(static_cast<size_t>(requests));
+
+	const auto start = std::chrono::steady_clock::now();
+	for (auto request = 0; request < requests; ++request) {
+		for (auto& action : actions) { action = static_cast<uint8_t>(1 << (random() % 8)); }
+
+		const auto sent = std::chrono::steady_clock::now();
+		const auto* observations = client.step(actions);
+		latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sent).count());
+
+		// Touch the observations like a trainer would
+		checksum += observations[request % (160 * 144)];
+	}
+	const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::sort(begin(latencies), end(latencies));
+	const auto percentile = [&](const double& p) { return latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))]; };
+
+	std::cout << client.envs() << " environments, " << requests << " requests\n";
+	std::cout << static_cast<double>(requests) * static_cast<double>(client.envs()) / seconds << " environment steps/s, "
+	          << requests / seconds << " requests/s\n";
+	std::cout << "latency p50 " << percentile(0.5) << " ms, p99 " << percentile(0.99) << " ms, max " << latencies.back() << " ms\n";
+	std::cout << "(checksum " << checksum << ")\n";
+
+	return 0;
+}
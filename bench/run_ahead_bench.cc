@@ -0,0 +1,52 @@
+#include "emulator.h"
+
+#include <chrono>
+#include <iostream>
+
+// How much of the frame budget emulation takes with 0-4 run-ahead frames. Nothing is presented or paced,
+// frames are rendered as they would be (only the last run-ahead one).
+auto main(int argc, char* argv[]) -> int
+{
+	if (argc != 2 && argc != 3) {
+		std::cout << "Usage " << argv[0] << " rom [host_frames]\n";
+		return 1;
+	}
+
+	const auto rom = std::string(argv[1]);
+	const auto host_frames = argc == 3 ? std::stoi(argv[2]) : 600;
+	const auto frame_budget_ms = FramePacer::GAME_BOY_FRAME.count() * 1000.0;
+
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+	auto state_cost_ms = 0.0;
+
+	for (auto run_ahead = uint32_t{0}; run_ahead <= 4; ++run_ahead) {
+		auto emu = Emulator<false>{rom};
+		emu.set_run_ahead(run_ahead);
+
+		// Warm up, games usually spend first frames with LCD off
+		for (auto i = 0; i < 60; ++i) { emu.run_host_frame(); }
+
+		const auto start = std::chrono::steady_clock::now();
+		for (auto i = 0; i < host_frames; ++i) { emu.run_host_frame(); }
+		const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / host_frames;
+
+		if (run_ahead == 0) {
+			auto state = EmulatorState{};
+			const auto state_start = std::chrono::steady_clock::now();
+			for (auto i = 0; i < host_frames; ++i) {
+				emu.save_state(state);
+				emu.load_state(state);
+			}
+			state_cost_ms =
+			  std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - state_start).count() / host_frames;
+		}
+
+		std::cout << "run-ahead " << run_ahead << ": " << ms << " ms per frame, " << ms / frame_budget_ms * 100.0
+		          << " % of the frame budget, " << frame_budget_ms / ms << "x headroom\n";
+	}
+
+	std::cout << "save + load state: " << state_cost_ms * 1000.0 << " us\n";
+
+	return 0;
+}
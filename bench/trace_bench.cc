@@ -0,0 +1,52 @@
+#include "emulator.h"
+#include "synthetic_roms.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+volatile uint64_t sink = 0;
+
+// Nanoseconds per iteration of `body`
+template<typename Body>
+auto time_loop(const uint64_t& iterations, Body&& body) -> double
+{
+	const auto start = std::chrono::steady_clock::now();
+	for (auto i = uint64_t{0}; i < iterations; ++i) { body(i); }
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / static_cast<double>(iterations);
+}
+
+} // namespace
+
+// What tracepoints cost. Built without TRACEPOINTS both numbers must be the same as without any tracepoints in the
+// code: the loop costs nothing extra and frame times match a build from before they were added. With TRACEPOINTS the
+// trace goes to grayboy_trace.json (or $GRAYBOY_TRACE).
+auto main(int argc, char* argv[]) -> int
+{
+	const auto iterations = argc > 1 ? std::stoull(argv[1]) : uint64_t{10'000'000};
+	const auto frames = 600;
+
+	const auto empty_ns = time_loop(iterations, [](const uint64_t& i) { sink = i; });
+	const auto traced_ns = time_loop(iterations, [](const uint64_t& i) {
+		GRAYBOY_TRACE_SCOPE("bench_scope");
+		GRAYBOY_TRACE_INSTANT("bench_instant", i);
+		sink = i;
+	});
+
+	// Frames with every tracepoint kind: scanlines, interupts, DMA, timer and bank switches
+	auto frame_ms = 0.0;
+	for (const auto& synthetic : {synthetic_sprite_scene(), synthetic_scx_raster(), synthetic_timer_storm(), synthetic_mbc_switching()}) {
+		auto emulator = Emulator<true>{Cartridge{synthetic.rom}};
+		emulator.set_headless_rendering(true);
+		const auto start = std::chrono::steady_clock::now();
+		for (auto frame = 0; frame < frames; ++frame) { emulator.run_frame(); }
+		const auto ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+		frame_ms += ms;
+		std::cout << synthetic.name << ": " << ms << " ms per frame\n";
+	}
+
+	std::cout << "tracepoints " << (GRAYBOY_TRACEPOINTS_ENABLED ? "enabled" : "disabled") << ": " << traced_ns - empty_ns
+	          << " ns per scope and instant pair, " << frame_ms << " ms per frame of all ROMs\n";
+	return 0;
+}
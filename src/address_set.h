@@ -0,0 +1,90 @@
+#pragma once
+
+#include "memory.h"
+
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+// Addresses read together every step (rewards, features). Compiled once into copies of consecutive addresses straight
+// from the memory array, gathering skips read() and doesn't allocate.
+//
+// Only addresses backed by the memory array are allowed: no cartridge ROM/RAM, no unusable area and no joypad register
+// (its value is composed on read).
+class AddressSet {
+public:
+	explicit AddressSet(std::vector<uint16_t> addresses) : addresses_{std::move(addresses)}
+	{
+		for (auto i = size_t{0}; i < addresses_.size(); ++i) {
+			const auto address = addresses_[i];
+			if (!is_gatherable(address)) {
+				auto message = std::ostringstream{};
+				message << "Address 0x" << std::hex << address << " can't be gathered from the memory array";
+				throw std::invalid_argument(message.str());
+			}
+
+			needs_ppu_sync_ = needs_ppu_sync_ || Memory::is_ppu_visible(address);
+
+			if (!runs_.empty() && runs_.back().address + runs_.back().length == address) {
+				++runs_.back().length;
+			}
+			else {
+				runs_.push_back({address, 1, static_cast<uint32_t>(i)});
+			}
+		}
+	}
+
+	[[nodiscard]] static auto is_gatherable(const uint16_t& address) -> bool
+	{
+		return address >= 0x8000 && !(address >= 0xa000 && address <= 0xbfff) && !(address >= 0xfea0 && address <= 0xfeff)
+		  && address != 0xff00;
+	}
+
+	// Writes size() bytes, in the order the addresses were given
+	auto gather(const uint8_t* memory, uint8_t* out) const -> void
+	{
+		for (const auto& run : runs_) {
+			if (run.length == 1) {
+				out[run.offset] = memory[run.address];
+			}
+			else {
+				std::memcpy(out + run.offset, memory + run.address, run.length);
+			}
+		}
+	}
+
+	[[nodiscard]] auto size() const -> size_t
+	{
+		return addresses_.size();
+	}
+
+	[[nodiscard]] auto addresses() const -> const std::vector<uint16_t>&
+	{
+		return addresses_;
+	}
+
+	// Number of copies gather() makes
+	[[nodiscard]] auto runs() const -> size_t
+	{
+		return runs_.size();
+	}
+
+	// Some addresses are VRAM, OAM or registers a lazily updated PPU might not have written yet
+	[[nodiscard]] auto needs_ppu_sync() const -> bool
+	{
+		return needs_ppu_sync_;
+	}
+
+private:
+	struct Run {
+		uint32_t address = {};
+		uint32_t length = {};
+		// Where in the output it goes
+		uint32_t offset = {};
+	};
+
+	std::vector<uint16_t> addresses_ = {};
+	std::vector<Run> runs_ = {};
+	bool needs_ppu_sync_ = {};
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "emulator.h"
+#include "thread_pool.h"
+
+#include <memory>
+
+// Owns many headless emulators and steps them in parallel, every call returns once all of them are done
+class BatchRunner {
+public:
+	explicit BatchRunner(const std::vector<std::string>& cartridge_paths, const size_t& threads = std::thread::hardware_concurrency())
+	  : pool_{threads}
+	{
+		emulators_.reserve(cartridge_paths.size());
+		for (const auto& path : cartridge_paths) { emulators_.push_back(std::make_unique<Emulator<true>>(path)); }
+	}
+
+	auto run_frames(const uint64_t& frames) -> void
+	{
+		pool_.run(emulators_.size(), [&](const size_t& index) {
+			for (auto frame = uint64_t{0}; frame < frames; ++frame) { emulators_[index]->run_frame(); }
+		});
+	}
+
+	// Every emulator runs at least `cycles`, instructions are not split so some run a few more
+	auto run_cycles(const uint64_t& cycles) -> void
+	{
+		pool_.run(emulators_.size(), [&](const size_t& index) { emulators_[index]->run_cycles(cycles); });
+	}
+
+	// Headless emulators don't emulate the PPU by default, observations need it
+	auto set_headless_rendering(const bool& enabled) -> void
+	{
+		for (auto& emulator : emulators_) { emulator->set_headless_rendering(enabled); }
+	}
+
+	// Calls task(index, emulator) for every emulator
+	auto run(const std::function<void(size_t, Emulator<true>&)>& task) -> void
+	{
+		pool_.run(emulators_.size(), [&](const size_t& index) { task(index, *emulators_[index]); });
+	}
+
+	// Bytes of the set from every emulator, `addresses.size()` of them per emulator. Runs on the calling thread,
+	// a few dozen bytes each are cheaper to copy than to hand over to the pool.
+	auto gather(const AddressSet& addresses, uint8_t* out) -> void
+	{
+		for (auto i = size_t{0}; i < emulators_.size(); ++i) { emulators_[i]->gather(addresses, out + i * addresses.size()); }
+	}
+
+	[[nodiscard]] auto size() const -> size_t
+	{
+		return emulators_.size();
+	}
+
+	[[nodiscard]] auto emulator(const size_t& index) -> Emulator<true>&
+	{
+		return *emulators_[index];
+	}
+
+	[[nodiscard]] auto threads() const -> size_t
+	{
+		return pool_.size();
+	}
+
+private:
+	// Emulators can't be moved, Memory points back at them
+	std::vector<std::unique_ptr<Emulator<true>>> emulators_ = {};
+	WorkStealingPool pool_;
+};
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -26,14 +30,26 @@ enum class MemoryBanking {
 
 class Cartridge {
 public:
+	// Everything that changes while a game runs, the ROM itself is not part of it
+	struct State {
+		bool rom_banking = true;
+		uint8_t current_rom_bank = 1;
+		bool ram_banking_enabled = {};
+		uint8_t current_ram_bank = {};
+		std::vector<std::array<uint8_t, 0x2000>> ram_banks = {};
+
+		auto operator==(const State&) const -> bool = default;
+	};
+
 	Cartridge() = default;
-	Cartridge(const std::string& filename)
+	Cartridge(const std::string& filename) : Cartridge(read_file(filename)) {}
+
+	// Whole ROM image, the smallest one has two 16 kB banks
+	explicit Cartridge(std::vector<uint8_t> rom) : buffer_{std::move(rom)}
 	{
-		auto file = std::ifstream(filename, std::ios::binary);
-		if (file.fail()) {
-			throw std::invalid_argument(std::string("Can't open file >") + filename + "<");
+		if (buffer_.size() < 0x8000) {
+			throw std::invalid_argument("ROM is smaller than 32 kB");
 		}
-		buffer_ = std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
 
 		const auto mbc = read(0x147);
 		switch (mbc) {
@@ -90,6 +106,7 @@ public:
 					if (current_rom_bank_ == 0) {
 						current_rom_bank_ = 1;
 					}
+					GRAYBOY_TRACE_INSTANT("rom_bank", current_rom_bank_);
 					return;
 				}
 
@@ -99,6 +116,7 @@ public:
 				if (current_rom_bank_ == 0) {
 					current_rom_bank_ = 1;
 				}
+				GRAYBOY_TRACE_INSTANT("rom_bank", current_rom_bank_);
 			}
 		}
 		else if (address >= 0x4000 && address <= 0x5fff) {
@@ -112,6 +130,7 @@ public:
 					if (current_rom_bank_ == 0) {
 						current_rom_bank_ = 1;
 					}
+					GRAYBOY_TRACE_INSTANT("rom_bank", current_rom_bank_);
 				}
 				else {
 					current_ram_bank_ = val & 0x3;
@@ -152,6 +171,36 @@ public:
 		return 0;
 	}
 
+	// Bank mapped at 0x4000-0x7fff
+	[[nodiscard]] auto rom_bank() const -> uint8_t
+	{
+		return current_rom_bank_;
+	}
+
+	[[nodiscard]] auto rom_banks() const -> size_t
+	{
+		return buffer_.size() / 0x4000;
+	}
+
+	// Saving into the same state again doesn't allocate
+	auto save_state(State& state) const -> void
+	{
+		state.rom_banking = rom_banking_;
+		state.current_rom_bank = current_rom_bank_;
+		state.ram_banking_enabled = ram_banking_enabled_;
+		state.current_ram_bank = current_ram_bank_;
+		state.ram_banks = ram_banks_;
+	}
+
+	auto load_state(const State& state) -> void
+	{
+		rom_banking_ = state.rom_banking;
+		current_rom_bank_ = state.current_rom_bank;
+		ram_banking_enabled_ = state.ram_banking_enabled;
+		current_ram_bank_ = state.current_ram_bank;
+		ram_banks_ = state.ram_banks;
+	}
+
 	static inline std::map<const char*, std::pair<std::uint16_t, std::uint16_t>> addreses = {
 	  {"nintendo_logo", {0x104, 0x134}},
 	  {"title", {0x134, 0x13f}},
@@ -202,6 +251,15 @@ public:
 	}
 
 private:
+	static auto read_file(const std::string& filename) -> std::vector<uint8_t>
+	{
+		auto file = std::ifstream(filename, std::ios::binary);
+		if (file.fail()) {
+			throw std::invalid_argument(std::string("Can't open file >") + filename + "<");
+		}
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+	}
+
 	void print_as_hex(const std::pair<uint16_t, uint16_t>& range)
 	{
 		const auto [start, end] = range;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Command line parsing shared by the executables
+
+// Removes "--name value" from args and returns the value
+inline auto take_option(std::vector<std::string>& args, const std::string& name) -> std::optional<std::string>
+{
+	const auto it = std::find(begin(args), end(args), name);
+	if (it == end(args) || it + 1 == end(args)) {
+		return std::nullopt;
+	}
+
+	auto value = *(it + 1);
+	args.erase(it, it + 2);
+	return value;
+}
+
+// Whole value has to be a number from `min` to `max`, in any base std::stoul takes with base 0. No sign or spaces,
+// std::stoul would take "-1" as the largest number.
+inline auto parse_number(const std::string& option, const std::string& value, const unsigned long& min, const unsigned long& max)
+  -> unsigned long
+{
+	auto parsed = size_t{0};
+	auto number = 0UL;
+	try {
+		if (!value.empty() && std::isdigit(static_cast<unsigned char>(value[0]))) {
+			number = std::stoul(value, &parsed, 0);
+		}
+	}
+	catch (const std::logic_error&) {
+		parsed = 0;
+	}
+
+	if (parsed == 0 || parsed != value.size() || number < min || number > max) {
+		throw std::invalid_argument(option + " takes a number from " + std::to_string(min) + " to " + std::to_string(max)
+		                            + ", not >" + value + "<");
+	}
+	return number;
+}
+
+// Same for a real number that is at least `min`, no "inf" or "nan" either
+inline auto parse_real(const std::string& option, const std::string& value, const double& min) -> double
+{
+	auto parsed = size_t{0};
+	auto number = 0.0;
+	try {
+		if (!value.empty() && (std::isdigit(static_cast<unsigned char>(value[0])) || value[0] == '.')) {
+			number = std::stod(value, &parsed);
+		}
+	}
+	catch (const std::logic_error&) {
+		parsed = 0;
+	}
+
+	if (parsed == 0 || parsed != value.size() || !std::isfinite(number) || number < min) {
+		auto message = std::ostringstream{};
+		message << option << " takes a number from " << min << " up, not >" << value << "<";
+		throw std::invalid_argument(message.str());
+	}
+	return number;
+}
@@ -5,6 +5,10 @@
 #include "memory.h"
 #include "registers.h"
 
+#if defined(GRAYBOY_PROFILE_OPCODES)
+#include "opcode_profiler.h"
+#endif
+
 #include <vector>
 
 struct DisassemblyInfo {
@@ -30,7 +34,14 @@ public:
 		const auto opcode = get_opcode(PC, memory);
 		const auto instruction = find_by_opcode(opcode);
 
+#if defined(GRAYBOY_PROFILE_OPCODES)
+		auto& profiler = thread_opcode_profiler();
+		const auto started = profiler.start();
+#endif
 		const auto cycles = execute_opcode(instruction.opcode, PC, regs_, memory);
+#if defined(GRAYBOY_PROFILE_OPCODES)
+		profiler.record(instruction.opcode, cycles, started);
+#endif
 		regs_.write("PC", regs_.read("PC") + instruction.size);
 
 		return cycles;
@@ -42,6 +53,8 @@ public:
 	{
 		auto regs = regs_;
 		auto memory2 = memory;
+		// The copy is thrown away, it must not drive the real PPU
+		memory2.set_ppu_sync(nullptr);
 		regs.write("PC", starting_address);
 		const auto opcode = get_opcode(starting_address, memory2);
 
@@ -57,6 +70,13 @@ public:
 		return DisassemblyInfo{starting_address, regs.read("PC"), instruction, memory_representation};
 	}
 
+	// Instruction at `address` without executing it, unlike disassemble_next() nothing is copied
+	[[nodiscard]] auto instruction_at(const uint16_t& address, const Memory& memory) const -> const Instruction&
+	{
+		const auto opcode = get_opcode(address, memory);
+		return instructions_[opcode <= 0xff ? opcode : (opcode & 0xff) + 0x100];
+	}
+
 	[[nodiscard]] auto registers() -> auto&
 	{
 		return regs_;
@@ -76,9 +96,9 @@ private:
 
 	[[nodiscard]] static auto get_opcode(const uint16_t& starting_address, const Memory& memory) -> uint16_t
 	{
-		const auto first_byte = static_cast<uint16_t>(memory.read(starting_address));
+		const auto first_byte = static_cast<uint16_t>(memory.peek(starting_address));
 		if (first_byte == 0xcb) {
-			const auto second_byte = memory.read(starting_address + 1);
+			const auto second_byte = memory.peek(starting_address + 1);
 			return static_cast<uint16_t>((first_byte << 8) + second_byte);
 		}
 		return first_byte;
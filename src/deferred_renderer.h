@@ -0,0 +1,212 @@
+#pragma once
+
+#include "memory.h"
+#include "scanline_renderer.h"
+
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// VRAM followed by OAM, laid out as Memory numbers its video memory blocks
+using VideoMemoryImage = std::array<uint8_t, Memory::VIDEO_MEMORY_BLOCKS * Memory::VIDEO_MEMORY_BLOCK_SIZE>;
+
+struct VideoMemoryBlock {
+	uint8_t index = {};
+	std::array<uint8_t, Memory::VIDEO_MEMORY_BLOCK_SIZE> data = {};
+};
+
+// Everything needed to draw one scanline later: LCD registers (0xff40 - 0xff4b) at the time the line
+// would have been drawn and how many of the frame's changed blocks were written before it
+struct ScanlineState {
+	bool recorded = {};
+	uint32_t blocks = {};
+	std::array<uint8_t, 12> registers = {};
+};
+
+struct FrameLog {
+	std::array<ScanlineState, 144> lines = {};
+	std::vector<VideoMemoryBlock> blocks = {};
+
+	auto clear() -> void
+	{
+		for (auto& line : lines) { line.recorded = false; }
+		// Keeps the capacity, blocks are not reallocated every frame
+		blocks.clear();
+	}
+};
+
+// Memory-like view of a recorded scanline for ScanlineRenderer
+class RecordedScanline {
+public:
+	RecordedScanline(const VideoMemoryImage& image, const ScanlineState& state) : image_{image}, state_{state} {}
+
+	[[nodiscard]] auto direct_read(const uint16_t address) const -> uint8_t
+	{
+		if (address >= 0xff40) {
+			return state_.registers[address - 0xff40];
+		}
+		if (address >= 0xfe00) {
+			return image_[0x2000 + address - 0xfe00];
+		}
+		return image_[address - 0x8000];
+	}
+
+private:
+	const VideoMemoryImage& image_;
+	const ScanlineState& state_;
+};
+
+// Records per-scanline PPU inputs on the emulation thread and renders whole frames on a worker thread,
+// so emulation of the next frame overlaps rendering of the previous one.
+// Registers are captured for every line, VRAM/OAM only by the blocks that changed, so mid-frame raster effects stay
+// intact. The worker applies the blocks to its own copy of video memory in the order they were recorded.
+class DeferredRenderer {
+public:
+	DeferredRenderer()
+	{
+		// Nothing is on the worker's side yet, the first line records all of video memory
+		block_versions_.fill(std::numeric_limits<uint64_t>::max());
+	}
+	DeferredRenderer(const DeferredRenderer&) = delete;
+	auto operator=(const DeferredRenderer&) -> DeferredRenderer& = delete;
+
+	~DeferredRenderer()
+	{
+		{
+			const auto lock = std::scoped_lock{mutex_};
+			quit_ = true;
+		}
+		work_ready_.notify_all();
+		worker_.join();
+	}
+
+	auto record_scanline(const Memory& mem) -> void
+	{
+		const auto scanline = mem.direct_read(0xff44);
+		if (scanline >= 0x90) {
+			return;
+		}
+
+		if (mem.video_memory_version() != video_memory_version_) {
+			for (auto block = size_t{0}; block < block_versions_.size(); ++block) {
+				const auto version = mem.video_memory_block_version(block);
+				if (version != block_versions_[block]) {
+					auto& recorded = recording_.blocks.emplace_back();
+					recorded.index = static_cast<uint8_t>(block);
+					const auto source = mem.data() + Memory::video_memory_block_address(block);
+					std::copy(source, source + Memory::VIDEO_MEMORY_BLOCK_SIZE, begin(recorded.data));
+					block_versions_[block] = version;
+				}
+			}
+			video_memory_version_ = mem.video_memory_version();
+		}
+
+		auto& line = recording_.lines[scanline];
+		line.recorded = true;
+		line.blocks = static_cast<uint32_t>(recording_.blocks.size());
+		std::copy(mem.data() + 0xff40, mem.data() + 0xff4c, begin(line.registers));
+	}
+
+	// Hands the recorded frame to the worker, waits only if the worker hasn't picked up the previous one yet
+	auto submit_frame() -> void
+	{
+		{
+			auto lock = std::unique_lock{mutex_};
+			work_taken_.wait(lock, [this] { return !pending_ready_; });
+			std::swap(recording_, pending_);
+			pending_ready_ = true;
+			++submitted_frames_;
+		}
+		work_ready_.notify_one();
+
+		recording_.clear();
+	}
+
+	// Blocks until every submitted frame is rendered
+	auto finish() -> void
+	{
+		auto lock = std::unique_lock{mutex_};
+		frame_done_.wait(lock, [this] { return completed_frames_ == submitted_frames_; });
+	}
+
+	auto copy_frame(std::array<uint8_t, 160 * 144>& target) -> void
+	{
+		const auto lock = std::scoped_lock{mutex_};
+		target = completed_;
+	}
+
+private:
+	auto work() -> void
+	{
+		while (true) {
+			{
+				auto lock = std::unique_lock{mutex_};
+				work_ready_.wait(lock, [this] { return pending_ready_ || quit_; });
+				if (quit_) {
+					return;
+				}
+				std::swap(pending_, rendering_);
+				pending_ready_ = false;
+			}
+			work_taken_.notify_one();
+
+			// Lines which weren't recorded (LCD was off) keep the previous content
+			auto applied = size_t{0};
+			for (auto y = size_t{0}; y < rendering_.lines.size(); ++y) {
+				const auto& line = rendering_.lines[y];
+				if (line.recorded) {
+					applied = apply_blocks(applied, line.blocks);
+					const auto src = RecordedScanline{video_memory_, line};
+					renderer_.render(src, static_cast<uint8_t>(y), framebuffer_.data() + y * 160);
+				}
+			}
+			apply_blocks(applied, rendering_.blocks.size());
+
+			{
+				const auto lock = std::scoped_lock{mutex_};
+				completed_ = framebuffer_;
+				++completed_frames_;
+			}
+			frame_done_.notify_all();
+		}
+	}
+
+	// Returns index of the first block not applied yet
+	auto apply_blocks(const size_t& from, const size_t& to) -> size_t
+	{
+		for (auto i = from; i < to; ++i) {
+			const auto& block = rendering_.blocks[i];
+			std::copy(begin(block.data), end(block.data), begin(video_memory_) + block.index * Memory::VIDEO_MEMORY_BLOCK_SIZE);
+		}
+		return to;
+	}
+
+	// Emulation thread only
+	FrameLog recording_ = {};
+	uint64_t video_memory_version_ = std::numeric_limits<uint64_t>::max();
+	std::array<uint64_t, Memory::VIDEO_MEMORY_BLOCKS> block_versions_ = {};
+
+	// Worker thread only
+	FrameLog rendering_ = {};
+	VideoMemoryImage video_memory_ = {};
+	ScanlineRenderer renderer_ = {};
+	std::array<uint8_t, 160 * 144> framebuffer_ = {};
+
+	// Guarded by mutex_
+	FrameLog pending_ = {};
+	bool pending_ready_ = {};
+	bool quit_ = {};
+	uint64_t submitted_frames_ = {};
+	uint64_t completed_frames_ = {};
+	std::array<uint8_t, 160 * 144> completed_ = {};
+
+	std::mutex mutex_ = {};
+	std::condition_variable work_ready_ = {};
+	std::condition_variable work_taken_ = {};
+	std::condition_variable frame_done_ = {};
+
+	// Started last, after everything it touches is constructed
+	std::thread worker_ = std::thread{[this] { work(); }};
+};
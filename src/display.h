@@ -1,54 +1,100 @@
 #pragma once
-#include "memory.h"
+#include "frame_metrics.h"
+#include "frame_pacer.h"
+#include "ppu.h"
+#include "upscale.h"
 
 #include <SDL2/SDL.h>
-
-struct SpritePixel {
-	uint8_t render_color = {};
-	uint8_t raw_color = {};
-	bool render_over_bg = {};
-};
-
-struct BackgroundPixel {
-	uint8_t render_color = {};
-	uint8_t raw_color = {};
-};
-
-struct WindowPixel {
-	bool active = {};
-	uint8_t render_color = {};
-	uint8_t raw_color = {};
-};
-
-struct Sprite {
-	uint8_t tile_number = {};
-	bool render_priority = {};
-	bool y_flip = {};
-	bool x_flip = {};
-	std::array<uint8_t, 4> colors = {};
-
-	int16_t pos_x = {};
-	int16_t pos_y = {};
-};
-
-struct ScanlineInfo {
-	uint64_t cycles = {};
-	bool sprites_updated = {};
-	bool tiles_updated = {};
-	bool hblank_issued = {};
+#include <limits>
+#include <memory>
+
+// Fast-forward, emulation stays the same, only rendering and presentation are skipped
+struct TurboSettings {
+	// Multiple of the normal speed, 0 means as fast as possible
+	double speed = 0;
+	// `skip_frames` out of every `frames` frames are neither rendered nor presented
+	uint32_t skip_frames = 3;
+	uint32_t frames = 4;
 };
 
-// Dummy Deiplay for headless run (tests)
+// Headless run (tests, batches, embedding) doesn't emulate the PPU unless it's enabled, LY stays 0 and no frames are
+// rendered then
 template<bool headless>
 class Display {
 public:
 	Display() = default;
 
-	auto update([[maybe_unused]] Memory& mem, [[maybe_unused]] const uint16_t& cycles) -> void {}
+	auto update(Memory& mem, const uint16_t& cycles) -> void
+	{
+		if (ppu_) {
+			ppu_->update(mem, cycles);
+		}
+	}
+	auto catch_up(Memory& mem, const uint64_t& cycles, const uint64_t& last_step = 0) -> void
+	{
+		if (ppu_) {
+			ppu_->catch_up(mem, cycles, last_step);
+		}
+	}
+	[[nodiscard]] auto cycles_to_interupt(const Memory& mem) const -> uint64_t
+	{
+		return ppu_ ? ppu_->cycles_to_interupt(mem) : std::numeric_limits<uint64_t>::max();
+	}
 	auto render() -> bool
 	{
 		return true;
 	}
+	[[nodiscard]] auto frame_count() const -> uint64_t
+	{
+		return ppu_ ? ppu_->frame_count() : 0;
+	}
+	[[nodiscard]] auto mode_after(const Memory& mem, const uint64_t& cycles, const uint64_t& last_step) const -> uint8_t
+	{
+		return ppu_ ? ppu_->mode_after(mem, cycles, last_step) : mem.direct_read(0xff41) & 0x3;
+	}
+	auto save_state(DisplayState& state) const -> void
+	{
+		if (ppu_) {
+			ppu_->save_state(state);
+		}
+	}
+	auto load_state(const DisplayState& state) -> void
+	{
+		if (ppu_) {
+			ppu_->load_state(state);
+		}
+	}
+	auto set_frame_hidden(const bool& hidden) -> void
+	{
+		if (ppu_) {
+			ppu_->set_frame_hidden(hidden);
+		}
+	}
+
+	auto set_ppu_enabled(const bool& enabled) -> void
+	{
+		if (enabled && !ppu_) {
+			ppu_ = std::make_unique<Ppu>();
+		}
+		else if (!enabled) {
+			ppu_.reset();
+		}
+	}
+
+	[[nodiscard]] auto emulates_ppu() const -> bool
+	{
+		return static_cast<bool>(ppu_);
+	}
+
+	// Blank without the PPU
+	[[nodiscard]] auto framebuffer() const -> const std::array<uint8_t, 160 * 144>&
+	{
+		static const auto blank = std::array<uint8_t, 160 * 144>{};
+		return ppu_ ? ppu_->framebuffer() : blank;
+	}
+
+private:
+	std::unique_ptr<Ppu> ppu_ = {};
 };
 
 // Useful sources:
@@ -56,15 +102,12 @@ public:
 // - http://emudev.de/gameboy-emulator/%e2%af%88-ppu-rgb-arrays-and-sdl/
 // - http://www.codeslinger.co.uk/pages/projects/gameboy.html
 template<>
-class Display<false> {
+class Display<false> : public Ppu {
 public:
 	const int32_t WIDTH = 160;
 	const int32_t HEIGHT = 144;
 	const int32_t PIXEL_SCALE = 4;
 
-	const uint64_t CYCLES_PER_FRAME = 70'224;
-	const uint64_t CYCLES_PER_SCANLINE = 456 / 4;
-
 	Display()
 	{
 		if (!SDL_WasInit(SDL_INIT_VIDEO)) {
@@ -76,401 +119,231 @@ public:
 
 		window_.reset(window);
 
-		window_surface_ = SDL_GetWindowSurface(window_.get());
-		surface_.reset(SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32, 0, 0, 0, 0));
-
-		frame_start_ = SDL_GetTicks();
-	}
-
-	auto update(Memory& mem, const uint16_t& cycles) -> void
-	{
-		lcd_enabled_ = static_cast<bool>(mem.direct_read(0xff40) & (1 << 7));
+		// Scaling is done by the GPU, SDL's software renderer would only add a copy to our own upscaling
+		if (!create_texture(SDL_RENDERER_ACCELERATED, false)) {
+			window_surface_ = SDL_GetWindowSurface(window_.get());
 
-		frame_cycles_ += cycles;
-		if (lcd_enabled_) {
-			if (frame_cycles_ >= CYCLES_PER_FRAME) {
-				frame_cycles_ -= CYCLES_PER_FRAME;
+			if (window_surface_ == nullptr || window_surface_->format->BytesPerPixel != 4) {
+				window_surface_ = nullptr;
+				create_texture(SDL_RENDERER_SOFTWARE, false);
 			}
 		}
 
-		else {
-			scanline_info_ = {};
-			mem.direct_write(0xff44, 0);
-			const auto stat = mem.direct_read(0xff41);
-			mem.direct_write(0xff41, stat & (~0x3));
-
-			return;
+		const auto* format = window_surface_ != nullptr ? window_surface_->format : nullptr;
+		for (auto i = size_t{0}; i < PALETTE.size(); ++i) {
+			const auto& [r, g, b] = PALETTE[i];
+			palette_[i] = format != nullptr ? SDL_MapRGBA(format, r, g, b, 0xff) : Uint32{0xff000000} | r << 16 | g << 8 | b;
 		}
+	}
 
-		scanline_info_.cycles += cycles;
-
-		const auto stat = mem.direct_read(0xff41);
-		const auto scanline = mem.direct_read(0xff44);
-
-		auto request_interupt = false;
-		const auto orig_status = stat & 0x3;
-		auto new_status = 0;
-
-		if (scanline_info_.cycles < 80 / 4) {
-			new_status = 2;
-			request_interupt = static_cast<bool>(stat & (1 << 5));
-			if (!scanline_info_.sprites_updated) {
-				update_sprites(mem);
-				scanline_info_.sprites_updated = true;
-			}
-		}
-		else if (scanline_info_.cycles <= (80 + 172) / 4) {
-			new_status = 3;
-			if (!scanline_info_.tiles_updated) {
-				update_tiles_scanline(mem);
-				update_window(mem);
-				scanline_info_.tiles_updated = true;
-			}
+	// Streaming texture is updated once per frame and scaled by the renderer.
+	// Without a hardware renderer the frame is upscaled straight into the window surface.
+	auto present() -> void
+	{
+		GRAYBOY_TRACE_SCOPE("present");
+		const auto started = FrameMetrics::Clock::now();
+		if (deferred_renderer_) {
+			deferred_renderer_->copy_frame(framebuffer_);
 		}
 
-		else {
-			new_status = 0;
-			if (!scanline_info_.hblank_issued) {
-				request_interupt = static_cast<bool>(stat & (1 << 3));
-				scanline_info_.hblank_issued = true;
+		if (texture_) {
+			void* pixels = {};
+			auto pitch = 0;
+			if (SDL_LockTexture(texture_.get(), nullptr, &pixels, &pitch) == 0) {
+				for (auto y = 0; y < HEIGHT; ++y) { to_pixels(y, reinterpret_cast<Uint32*>(static_cast<Uint8*>(pixels) + y * pitch)); }
+				SDL_UnlockTexture(texture_.get());
 			}
-		}
+			const auto composed = add_time(FrameMetrics::compose, started);
 
-		if (new_status != orig_status && request_interupt) {
-			// Request interupt
-			mem.direct_write(0xff0f, mem.direct_read(0xff0f) | 0x2);
+			SDL_RenderClear(sdl_renderer_.get());
+			SDL_RenderCopy(sdl_renderer_.get(), texture_.get(), nullptr, nullptr);
+			SDL_RenderPresent(sdl_renderer_.get());
+			add_time(FrameMetrics::present, composed);
+			return;
 		}
 
-		mem.direct_write(0xff41, (stat & ~0x3) | new_status);
-
-		if (scanline_info_.cycles >= CYCLES_PER_SCANLINE) {
-			scanline_info_.cycles -= CYCLES_PER_SCANLINE;
-			scanline_info_.tiles_updated = scanline_info_.sprites_updated = scanline_info_.hblank_issued = vblank_issued_ = false;
-
-			if (scanline == 0x90 && !vblank_issued_) {
-				mem.direct_write(0xff0f, mem.direct_read(0xff0f) | 0x1);
-				vblank_issued_ = true;
-			}
-
-			if (scanline + 1 >= 0x9a) {
-				mem.direct_write(0xff44, 0);
-			}
-			else {
-				mem.direct_write(0xff44, scanline + 1);
-			}
-			check_lyc(mem);
+		if (window_surface_ == nullptr) {
+			return;
 		}
-	}
 
-	auto update_surface() -> void
-	{
-		// https://www.deviantart.com/thewolfbunny/art/Game-Boy-Palette-Grand-Ivory-881455013
-		const auto colors = std::array<std::array<uint8_t, 4>, 4>{
-		  {{0xd9, 0xd6, 0xbe, 0xff}, {0xa5, 0xa3, 0x91, 0xff}, {0x66, 0x64, 0x59, 0xff}, {0x26, 0x25, 0x21, 0xff}}};
-
-		const auto sdl_colors = std::array<Uint32, 4>{
-		  SDL_MapRGBA(surface_->format, colors[0][0], colors[0][1], colors[0][2], 0xff),
-		  SDL_MapRGBA(surface_->format, colors[1][0], colors[1][1], colors[1][2], 0xff),
-		  SDL_MapRGBA(surface_->format, colors[2][0], colors[2][1], colors[2][2], 0xff),
-		  SDL_MapRGBA(surface_->format, colors[3][0], colors[3][1], colors[3][2], 0xff),
-		};
-
-		SDL_LockSurface(surface_.get());
-
-		for (auto y = 0; y < 144; ++y) {
-			for (auto x = 0; x < 160; ++x) {
-				const auto background_pixel = bg_buffer_[y][x];
-				auto pixel = background_pixel.render_color;
-
-				const auto sprite_pixel = sprites_buffer_[y][x];
-
-				if (window_buffer_[y][x].active) {
-					pixel = window_buffer_[y][x].render_color;
-				}
-				else if (sprite_pixel.raw_color != 0) {
-					// Sprite is under background
-					if (sprite_pixel.render_over_bg) {
-						pixel = sprite_pixel.render_color;
-					}
-					else if (background_pixel.raw_color == 0) {
-						pixel = sprite_pixel.render_color;
-					}
-				}
-				auto * target_pixel = (Uint32*)((Uint8*)surface_->pixels + y * surface_->pitch + x * surface_->format->BytesPerPixel);
-				*target_pixel = sdl_colors[pixel];
-			}
-		}
+		for (auto y = 0; y < HEIGHT; ++y) { to_pixels(y, pixels_.data() + y * WIDTH); }
 
-		SDL_UnlockSurface(surface_.get());
-	}
+		const auto scale = std::max(1, std::min(window_surface_->w / WIDTH, window_surface_->h / HEIGHT));
+		const auto pitch = window_surface_->pitch / 4;
+		const auto offset_x = (window_surface_->w - WIDTH * scale) / 2;
+		const auto offset_y = (window_surface_->h - HEIGHT * scale) / 2;
 
-	static auto check_lyc(Memory& mem) -> void
-	{
-		const auto stat = mem.direct_read(0xff41);
-		auto new_status = stat & 0x3;
-
-		// LY == LYC
-		if (mem.direct_read(0xff44) == mem.direct_read(0xff45)) {
-			new_status |= 1 << 2;
-			if (stat & (1 << 6)) {
-				// Request interupt
-				mem.direct_write(0xff0f, mem.direct_read(0xff0f) | 0x2);
-			}
-		}
-		else {
-			new_status &= ~(1 << 2);
-		}
+		SDL_LockSurface(window_surface_);
+		auto* target = static_cast<Uint32*>(window_surface_->pixels) + offset_y * pitch + offset_x;
+		upscale_nearest(pixels_.data(), WIDTH, HEIGHT, WIDTH, target, pitch, scale);
+		SDL_UnlockSurface(window_surface_);
+		const auto composed = add_time(FrameMetrics::compose, started);
 
-		mem.direct_write(0xff41, (stat & ~0x3) | new_status);
+		SDL_UpdateWindowSurface(window_.get());
+		add_time(FrameMetrics::present, composed);
 	}
 
 	auto render() -> void
 	{
-
-		update_surface();
-		SDL_BlitScaled(surface_.get(), nullptr, window_surface_, nullptr);
-		SDL_UpdateWindowSurface(window_.get());
-
-		// Use 17 ms per frame, this is close to the actuall hardware
-		const auto frame_should_take = 17;
-		const auto frame_time = SDL_GetTicks() - frame_start_;
-
-		if (frame_time < frame_should_take) {
-			SDL_Delay(frame_should_take - frame_time);
+		if (last_frame_rendered_) {
+			present();
 		}
 
-		frame_start_ = SDL_GetTicks();
-	}
-
-private:
-	auto update_tiles_scanline(const Memory& mem) -> void
-	{
-		const auto scanline = mem.direct_read(0xff44);
-		if (scanline >= 0x90) {
+		if (turbo_ && turbo_settings_.speed <= 0) {
+			pacer_.reset();
 			return;
 		}
 
-		if (!(mem.direct_read(0xff40) & 0x1)) {
-			for (auto x = size_t{0}; x < size_t{160}; ++x) { bg_buffer_[scanline][x] = {uint8_t{0}, uint8_t{0}}; }
+		// Presenting already waited for the display, frames that weren't presented are still paced
+		if (vsync_ && last_frame_rendered_ && !turbo_) {
+			pacer_.frame_presented();
 			return;
 		}
 
-		const auto palette = mem.direct_read(0xff47);
-		const auto colors = std::array{palette & 0x3, (palette & 0xc) >> 2, (palette & 0x30) >> 4, (palette & 0xc0) >> 6};
-
-		const auto SCY = mem.direct_read(0xff42);
-		const auto SCX = mem.direct_read(0xff43);
-
-		const auto tile_data = ((mem.direct_read(0xff40) >> 4) & 1) ? 0x8000 : 0x8800;
-		const auto tile_map = (((mem.direct_read(0xff40) >> 3) & 1) == 1) ? 0x9c00 : 0x9800;
-
-		const auto pos_y = (scanline + SCY) % 256;
+		pacer_.set_period(turbo_ ? frame_period() / turbo_settings_.speed : frame_period());
+		const auto started = FrameMetrics::Clock::now();
+		pacer_.wait_next_frame();
+		add_time(FrameMetrics::sleep, started);
+	}
 
-		for (auto x = 0; x < 160; ++x) {
-			const auto pos_x = (x + SCX) % 256;
-			const auto tile_index = tile_map + pos_y / 8 * 32 + pos_x / 8;
-			const auto tile_id = mem.direct_read(tile_index);
-			const auto tile_address = tile_data == 0x8000
-			  ? (0x8000 + tile_id * 0x10)
-			  : ((tile_id < 128 ? 0x9000 + tile_id * 0x10 : 0x8800 + (tile_id - 128) * 0x10));
+	// Compose, present and sleep times go there, nullptr stops it
+	auto set_frame_metrics(FrameMetrics* metrics) -> void
+	{
+		frame_metrics_ = metrics;
+	}
 
-			const auto first_byte = mem.direct_read(tile_address + (pos_y % 8) * 2 + 1);
-			const auto second_byte = mem.direct_read(tile_address + (pos_y % 8) * 2 + 0);
+	// Runs at the refresh rate of the display the window is on (e.g. 60 Hz instead of 59.73 Hz), so no frame is shown
+	// twice or dropped periodically. Emulation runs that much faster. The renderer is recreated with vsync and presenting
+	// waits for the display, the pacer keeps the refresh period when the renderer can't do vsync or there's none.
+	// Ignored when the refresh rate is unknown or too far from the hardware one.
+	auto set_sync_to_display_refresh(const bool& enabled) -> void
+	{
+		display_refresh_period_ = {};
 
-			const auto first_bit = static_cast<bool>(first_byte & (1 << (7 - pos_x % 8)));
-			const auto second_bit = static_cast<bool>(second_byte & (1 << (7 - pos_x % 8)));
+		auto mode = SDL_DisplayMode{};
+		if (enabled && SDL_GetWindowDisplayMode(window_.get(), &mode) == 0 && mode.refresh_rate >= 55 && mode.refresh_rate <= 65) {
+			display_refresh_period_ = FramePacer::Duration{1.0 / mode.refresh_rate};
+		}
 
-			const auto pixel = (static_cast<uint8_t>(first_bit) << 1) + second_bit;
-			bg_buffer_[scanline][x] = {static_cast<uint8_t>(colors[pixel]), static_cast<uint8_t>(pixel)};
+		const auto vsync = display_refresh_period_.count() > 0;
+		if (texture_ && vsync != vsync_ && !create_texture(renderer_flags_, vsync)) {
+			create_texture(renderer_flags_, false);
 		}
 	}
 
-	auto update_window(const Memory& mem) -> void
+	// Whether presenting waits for the display's refresh
+	[[nodiscard]] auto vsync() const -> bool
 	{
-		const auto scanline = mem.direct_read(0xff44);
-		if (scanline >= 0x90) {
-			return;
-		}
-
-		const auto palette = mem.direct_read(0xff47);
-		const auto colors = std::array{palette & 0x3, (palette & 0xc) >> 2, (palette & 0x30) >> 4, (palette & 0xc0) >> 6};
-
-		const auto window_y = mem.direct_read(0xff4A);
-		const auto window_x = mem.direct_read(0xff4B) - 0x7;
-
-		const auto using_window = (mem.direct_read(0xff40) & (1 << 5)) && window_y <= scanline;
-		if (!using_window) {
-			for (auto x = size_t{0}; x < 160; ++x) { window_buffer_[scanline][x] = {}; }
-			return;
-		}
+		return vsync_;
+	}
 
-		const auto tile_data = ((mem.direct_read(0xff40) >> 4) & 1) ? 0x8000 : 0x8800;
-		const auto tile_map = ((mem.direct_read(0xff40) >> 6 & 1) == 1) ? 0x9c00 : 9800;
+	[[nodiscard]] auto frame_time_stats() const -> FrameTimeStats
+	{
+		return pacer_.stats();
+	}
 
-		const auto pos_y = scanline - window_y;
+	auto set_turbo(const bool& enabled) -> void
+	{
+		turbo_ = enabled;
+		set_frame_skip(turbo_ ? turbo_settings_.skip_frames : 0, turbo_settings_.frames);
+	}
 
-		for (auto x = std::max(0, window_x); x < 160; ++x) {
-			const auto pos_x = x - window_x;
-			const auto tile_index = tile_map + pos_y / 8 * 32 + pos_x / 8;
-			const auto tile_id = mem.direct_read(tile_index);
-			const auto tile_address = tile_data == 0x8000
-			  ? (0x8000 + tile_id * 0x10)
-			  : ((tile_id < 128 ? 0x9000 + tile_id * 0x10 : 0x8800 + (tile_id - 128) * 0x10));
+	[[nodiscard]] auto turbo() const -> bool
+	{
+		return turbo_;
+	}
 
-			const auto first_byte = mem.direct_read(tile_address + (pos_y % 8) * 2 + 1);
-			const auto second_byte = mem.direct_read(tile_address + (pos_y % 8) * 2 + 0);
+	auto set_turbo_settings(const TurboSettings& settings) -> void
+	{
+		turbo_settings_ = settings;
+		turbo_settings_.frames = std::max(turbo_settings_.frames, uint32_t{1});
+		turbo_settings_.skip_frames = std::min(turbo_settings_.skip_frames, turbo_settings_.frames - 1);
+		set_turbo(turbo_);
+	}
 
-			const auto first_bit = static_cast<bool>(first_byte & (1 << (7 - pos_x % 8)));
-			const auto second_bit = static_cast<bool>(second_byte & (1 << (7 - pos_x % 8)));
+	[[nodiscard]] auto emulates_ppu() const -> bool
+	{
+		return true;
+	}
 
-			const auto pixel = (static_cast<uint8_t>(first_bit) << 1) + second_bit;
-			window_buffer_[scanline][x] = {true, static_cast<uint8_t>(colors[pixel]), static_cast<uint8_t>(pixel)};
-		}
+	[[nodiscard]] auto window() const -> SDL_Window*
+	{
+		return window_.get();
 	}
 
-	auto update_sprites(const Memory& mem) -> void
+private:
+	auto create_texture(const Uint32& flags, const bool& vsync) -> bool
 	{
-		const auto scanline = mem.direct_read(0xff44);
-		if (scanline >= 0x90) {
-			return;
+		// The texture goes with the renderer it was made for
+		texture_.reset();
+		vsync_ = false;
+		sdl_renderer_.reset(SDL_CreateRenderer(window_.get(), -1, vsync ? flags | SDL_RENDERER_PRESENTVSYNC : flags));
+
+		auto info = SDL_RendererInfo{};
+		if (!sdl_renderer_ || SDL_GetRendererInfo(sdl_renderer_.get(), &info) != 0 || (info.flags & flags) == 0
+		    || (vsync && (info.flags & SDL_RENDERER_PRESENTVSYNC) == 0)) {
+			sdl_renderer_.reset();
+			return false;
 		}
+		renderer_flags_ = flags;
+		vsync_ = vsync;
 
-		for (auto x = size_t{0}; x < 160; ++x) { sprites_buffer_[scanline][x] = {}; }
+		SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+		SDL_RenderSetLogicalSize(sdl_renderer_.get(), WIDTH, HEIGHT);
+		SDL_RenderSetIntegerScale(sdl_renderer_.get(), SDL_TRUE);
 
-		// Objects disabled
-		if (!(mem.direct_read(0xff40) & (1 << 1))) {
-			return;
+		texture_.reset(SDL_CreateTexture(sdl_renderer_.get(), SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, WIDTH, HEIGHT));
+		if (!texture_) {
+			sdl_renderer_.reset();
 		}
-
-		const auto sprites = get_filtered_sprites(get_all_sprites(mem), scanline);
-
-		std::for_each(cbegin(sprites), cend(sprites), [&mem, this, scanline](const auto& s) {
-			auto tile = load_tile(mem, 0x8000 + s.tile_number * 0x10, s.x_flip, s.y_flip);
-
-			const auto pixel_y = scanline - s.pos_y;
-			for (auto x = std::max(int16_t{0}, s.pos_x); x < std::min(s.pos_x + 8, 160); ++x) {
-				const auto pixel_x = x - s.pos_x;
-				const auto pixel_val = tile[pixel_x + 8 * pixel_y];
-				if (pixel_val != 0) {
-					sprites_buffer_[scanline][x] = {s.colors[pixel_val], pixel_val, !s.render_priority};
-				}
-			}
-		});
+		return static_cast<bool>(texture_);
 	}
 
-	static auto get_all_sprites(const Memory& mem) -> std::vector<Sprite>
+	// Adds the time since `since` to the phase, returns now
+	auto add_time(const FrameMetrics::Phase& phase, const FrameMetrics::Clock::time_point& since) -> FrameMetrics::Clock::time_point
 	{
-		auto all_sprites = std::vector<Sprite>{};
-		all_sprites.reserve(40);
-
-		const auto large_sprites = mem.direct_read(0xff40) & (1 << 2);
-
-		for (auto sprite = 0; sprite < 40; ++sprite) {
-			const auto index = sprite * 4;
-			const auto x_pos = static_cast<int16_t>(mem.direct_read(0xfe00 + index + 1) - 0x8);
-			const auto y_pos = static_cast<int16_t>(mem.direct_read(0xfe00 + index) - 0x10);
-			const auto tile_number = mem.direct_read(0xfe00 + index + 2);
-
-			const auto attrs_raw = mem.direct_read(0xfe00 + index + 3);
-			const auto palette_address = (attrs_raw & (1 << 4)) ? 0xff49 : 0xff48;
-			const auto palette = mem.direct_read(palette_address);
-
-			const auto s = Sprite{
-			  .tile_number = tile_number,
-			  .render_priority = static_cast<bool>(attrs_raw & (1 << 7)),
-			  .y_flip = static_cast<bool>(attrs_raw & (1 << 6)),
-			  .x_flip = static_cast<bool>(attrs_raw & (1 << 5)),
-			  .colors =
-			    {
-			      static_cast<uint8_t>(palette & 0x3),
-			      static_cast<uint8_t>((palette & 0xc) >> 2),
-			      static_cast<uint8_t>((palette & 0x30) >> 4),
-			      static_cast<uint8_t>((palette & 0xc0) >> 6),
-			    },
-			  .pos_x = x_pos,
-			  .pos_y = y_pos,
-
-			};
-			all_sprites.push_back(s);
-			if (large_sprites) {
-				auto sprite2 = s;
-				++sprite2.tile_number;
-				sprite2.pos_y += 8;
-				all_sprites.push_back(sprite2);
-			}
+		const auto now = FrameMetrics::Clock::now();
+		if (frame_metrics_ != nullptr) {
+			frame_metrics_->add(phase, now - since);
 		}
-
-		return all_sprites;
+		return now;
 	}
 
-	[[nodiscard]] static auto get_filtered_sprites(std::vector<Sprite> sprites, const uint8_t& scanline) -> std::vector<Sprite>
+	auto to_pixels(const int& y, Uint32* target) const -> void
 	{
-		sprites.erase(
-		  std::remove_if(
-		    begin(sprites),
-		    end(sprites),
-		    [scanline](const auto& s) {
-			    return !(s.pos_x + 7 >= 0 && s.pos_x < 160 && s.pos_y + 7 >= scanline && s.pos_y <= scanline);
-		    }),
-		  end(sprites));
-
-		// Get first 10 based on lowest x, then sort them in reverse
-		std::stable_sort(begin(sprites), end(sprites), [](const auto& a, const auto& b) { return a.pos_x < b.pos_x; });
-
-		const auto last = sprites.size() >= 10 ? cbegin(sprites) + 10 : cend(sprites);
-		sprites.erase(last, cend(sprites));
-		std::stable_sort(begin(sprites), end(sprites), [](const auto& a, const auto& b) { return a.pos_x >= b.pos_x; });
-
-		return sprites;
+		const auto* shades = framebuffer_.data() + y * WIDTH;
+		for (auto x = 0; x < WIDTH; ++x) { target[x] = palette_[shades[x]]; }
 	}
 
-	static auto load_tile(const Memory& mem, const uint16_t& addr, const bool& x_flip, const bool& y_flip) -> std::array<uint8_t, 64>
+	[[nodiscard]] auto frame_period() const -> FramePacer::Duration
 	{
-		auto tile = std::array<uint8_t, 64>{};
-
-		for (auto row = 0; row < 8; ++row) {
-			const auto first_byte = mem.direct_read(addr + row * 2 + 1);
-			const auto second_byte = mem.direct_read(addr + row * 2 + 0);
-			tile[8 * row + 0] = ((first_byte & 0x80) >> 6) + ((second_byte & 0x80) >> 7);
-			tile[8 * row + 1] = ((first_byte & 0x40) >> 5) + ((second_byte & 0x40) >> 6);
-			tile[8 * row + 2] = ((first_byte & 0x20) >> 4) + ((second_byte & 0x20) >> 5);
-			tile[8 * row + 3] = ((first_byte & 0x10) >> 3) + ((second_byte & 0x10) >> 4);
-			tile[8 * row + 4] = ((first_byte & 0x08) >> 2) + ((second_byte & 0x08) >> 3);
-			tile[8 * row + 5] = ((first_byte & 0x04) >> 1) + ((second_byte & 0x04) >> 2);
-			tile[8 * row + 6] = ((first_byte & 0x02) >> 0) + ((second_byte & 0x02) >> 1);
-			tile[8 * row + 7] = ((first_byte & 0x01) << 1) + ((second_byte & 0x01) >> 0);
-		}
-
-		if (x_flip) {
-			for (auto y = size_t{0}; y < 8; ++y) {
-				for (auto x = size_t{0}; x < 4; ++x) { std::swap(tile[x + 8 * y], tile[7 - x + 8 * y]); }
-			}
-		}
-
-		if (y_flip) {
-			for (auto y = size_t{0}; y < 4; ++y) {
-				for (auto x = size_t{0}; x < 8; ++x) { std::swap(tile[x + 8 * y], tile[x + 8 * (7 - y)]); }
-			}
-		}
-
-		return tile;
+		return display_refresh_period_.count() > 0 ? display_refresh_period_ : FramePacer::GAME_BOY_FRAME;
 	}
 
+	// https://www.deviantart.com/thewolfbunny/art/Game-Boy-Palette-Grand-Ivory-881455013
+	static constexpr auto PALETTE =
+	  std::array<std::array<uint8_t, 3>, 4>{{{0xd9, 0xd6, 0xbe}, {0xa5, 0xa3, 0x91}, {0x66, 0x64, 0x59}, {0x26, 0x25, 0x21}}};
+
+	// Declared in the reverse order of destruction, the texture belongs to the renderer and the renderer to the window
 	std::unique_ptr<SDL_Window, decltype(&SDL_DestroyWindow)> window_ = {nullptr, SDL_DestroyWindow};
-	// This is part of the window and it's destroyed with the window, do not free it manually
-	SDL_Surface * window_surface_ = {};
-	std::unique_ptr<SDL_Surface, decltype(&SDL_FreeSurface)> surface_ = {nullptr, SDL_FreeSurface};
+	std::unique_ptr<SDL_Renderer, decltype(&SDL_DestroyRenderer)> sdl_renderer_ = {nullptr, SDL_DestroyRenderer};
+	std::unique_ptr<SDL_Texture, decltype(&SDL_DestroyTexture)> texture_ = {nullptr, SDL_DestroyTexture};
+	// Only used without a renderer. This is part of the window and it's destroyed with the window, do not free it manually
+	SDL_Surface* window_surface_ = {};
+
+	// Renderer type create_texture() succeeded with, and whether it presents with vsync
+	Uint32 renderer_flags_ = {};
+	bool vsync_ = {};
 
-	std::array<std::array<WindowPixel, 160>, 144> window_buffer_;
-	std::array<std::array<BackgroundPixel, 160>, 144> bg_buffer_;
-	std::array<std::array<SpritePixel, 160>, 144> sprites_buffer_;
+	std::array<Uint32, 4> palette_ = {};
+	std::array<Uint32, 160 * 144> pixels_ = {};
 
-	uint64_t frame_cycles_ = {};
-	Uint32 frame_start_ = {};
-	bool lcd_enabled_ = true;
-	bool vblank_issued_ = {};
+	bool turbo_ = {};
+	TurboSettings turbo_settings_ = {};
 
-	ScanlineInfo scanline_info_ = {};
+	FramePacer pacer_ = {};
+	FramePacer::Duration display_refresh_period_ = {};
+	FrameMetrics* frame_metrics_ = {};
 };
 
 /*
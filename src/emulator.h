@@ -1,37 +1,104 @@
 #pragma once
 
+#include "address_set.h"
 #include "cartridge.h"
 #include "cpu.h"
 #include "display.h"
-#include "fps.h"
+#include "frame_metrics.h"
+#include "generator.h"
+#include "guest_profiler.h"
+#include "instruction_trace.h"
 #include "joypad.h"
+#include "predicate.h"
 #include "timer.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// Whole emulated machine. Saving into the same object again reuses its buffers.
+struct EmulatorState {
+	Registers registers = {};
+	Memory::State memory = {};
+	Timer::State timer = {};
+	DisplayState display = {};
+	uint64_t total_cycles = {};
+	uint64_t frames = {};
+	// Cycles run in the frame not completed yet
+	uint64_t frame_cycles = {};
+	// Serial bytes written since power on, get_serial_link() keeps only the last ones
+	uint64_t serial_bytes = {};
+
+	auto operator==(const EmulatorState&) const -> bool = default;
+};
+
+enum class StopEvent { vblank, serial_byte, breakpoint, cycle_budget };
 
-inline auto format(const int& value, const uint32_t& width) -> std::string
-{
-	auto s = std::stringstream{};
-	s << std::setfill('0') << std::setw(width) << std::hex << value;
-	auto result = s.str();
+// What Emulator::stepper yields at
+struct StopConditions {
+	bool vblank = true;
+	bool serial_byte = false;
+	// Stops before the instruction at any of these addresses is executed
+	std::vector<uint16_t> breakpoints = {};
+	// Stops once this many cycles ran since the last stop, 0 disables it
+	uint64_t cycle_budget = {};
+};
 
-	return result;
-}
+// When Emulator checks its stop condition
+enum class StopCheck {
+	// Once a frame is complete
+	frame_end,
+	// After instructions that wrote an address the condition reads, and once a frame is complete
+	watched_write,
+	// After every instruction, for conditions over registers
+	instruction,
+};
+
+struct Stop {
+	StopEvent event = {};
+	// Cycles since the previous stop
+	uint64_t cycles = {};
+	uint16_t PC = {};
+	// Only set for StopEvent::serial_byte
+	char serial_byte = {};
+};
 
 template<bool headless>
-class Emulator {
+class Emulator final : public PpuSync {
 public:
 	const uint64_t CPU_FREQUENCY = 4'194'304 / 4;
-	const uint64_t CYCLES_PER_FRAME = CPU_FREQUENCY / 60;
+	// One PPU frame, 70224 clocks. Frames end at VBlank, this is only used when there is none (LCD off, no PPU).
+	const uint64_t CYCLES_PER_FRAME = 70'224 / 4;
+	static constexpr uint32_t MAX_RUN_AHEAD_FRAMES = 4;
+	// Serial output kept, the older half is dropped when it's full so a game writing forever doesn't allocate
+	static constexpr size_t SERIAL_LINK_CAPACITY = 4096;
+
+	Emulator(const std::string& cartridge_path) : Emulator(Cartridge{cartridge_path}) {}
 
-	Emulator(const std::string& cartridge_path)
+	explicit Emulator(Cartridge&& cartridge)
 	{
-		memory_ = Memory{Cartridge{cartridge_path}};
+		memory_ = Memory{std::move(cartridge)};
 
 		const auto regs =
 		  RegistersChanger{.AF = 0x01b0, .BC = 0x0013, .DE = 0x00d8, .HL = 0x014d, .PC = 0x0100, .SP = 0xfffe}.get(Registers{});
 
 		cpu_ = Cpu{regs};
+		serial_link_.reserve(SERIAL_LINK_CAPACITY);
+
+		if constexpr (!headless) {
+			memory_.set_ppu_sync(this);
+		}
 	}
 
+	// Memory keeps a pointer back to the emulator
+	Emulator(const Emulator&) = delete;
+	Emulator(Emulator&&) = delete;
+	auto operator=(const Emulator&) -> Emulator& = delete;
+	auto operator=(Emulator&&) -> Emulator& = delete;
+
 	~Emulator()
 	{
 		if constexpr (!headless) {
@@ -41,40 +108,245 @@ public:
 
 	auto run() -> void
 	{
-		auto frame_cycles = uint64_t{0};
-
 		while (true) {
-			const auto cycles = execute_next();
-			display_.update(memory_, cycles);
+			run_host_frame();
+			present_frame();
+			if (frame_metrics_ != nullptr) {
+				frame_metrics_->end_frame();
+			}
+
+			const auto joypad_update = joypad_.update(memory_.read(0xff00));
+			if (joypad_update.quit) {
+				break;
+			}
+
+			if (joypad_update.request_interupt) {
+				memory_.direct_write(0xff0f, memory_.direct_read(0xff0f) | 0x16);
+			}
+
+			memory_.update_joypad(joypad_update.state);
+
+			if (joypad_update.toggle_turbo) {
+				set_turbo(!turbo());
+			}
+		}
+	}
+
+	// Shows the last frame and waits for the time of the next one (unless in turbo), nothing to do headless
+	auto present_frame() -> void
+	{
+		display_.render();
+	}
+
+	// Runs until the PPU enters VBlank - exactly one emulated frame, so the frame can be presented and input sampled
+	// right after it's complete. Returns number of cycles run.
+	// With a stop condition it returns early once the condition holds, see stopped_by_condition().
+	auto run_frame() -> uint64_t
+	{
+		GRAYBOY_TRACE_SCOPE("frame");
+		const auto frame = frames_;
+		auto cycles = uint64_t{0};
+		stopped_by_condition_ = false;
+		const auto started = FrameTiming{frame_metrics_};
+
+		while (frames_ == frame) {
+			cycles += step_tracking_frames();
+			if (stop_condition_ && stop_condition_met(false)) {
+				catch_up_display();
+				add_cpu_time(started);
+				return cycles;
+			}
+		}
+
+		catch_up_display();
+		if (stop_condition_) {
+			stop_condition_met(true);
+		}
+		add_cpu_time(started);
+		return cycles;
+	}
+
+	// Condition run_frame() and execute_instructions() stop at, std::nullopt removes it
+	auto set_stop_condition(std::optional<Predicate> condition, const StopCheck& check = StopCheck::watched_write) -> void
+	{
+		stop_condition_ = std::move(condition);
+		stop_check_ = check;
+		stopped_by_condition_ = false;
+
+		memory_.watch(stop_condition_ && check == StopCheck::watched_write ? stop_condition_->watched_addresses() : std::vector<uint16_t>{});
+		if (stop_condition_) {
+			stop_condition_->arm(memory_.data());
+		}
+	}
+
+	// Whether the last run_frame() or execute_instructions() returned because the stop condition holds
+	[[nodiscard]] auto stopped_by_condition() const -> bool
+	{
+		return stopped_by_condition_;
+	}
 
-			frame_cycles += cycles;
+	// Frames completed so far, whatever ran them, part of the state
+	[[nodiscard]] auto frames() const -> uint64_t
+	{
+		return frames_;
+	}
 
-			if (frame_cycles >= CYCLES_PER_FRAME) {
-				frame_cycles -= CYCLES_PER_FRAME;
-				display_.render();
-				fps_.next_frame();
+	// Runs the emulator as a coroutine, every next() continues until one of the conditions is met. Nothing runs between
+	// the calls, so a host can drive the emulator from its own loop and one thread can interleave many emulators.
+	// The emulator has to outlive the generator.
+	auto stepper(StopConditions conditions) -> Generator<Stop>
+	{
+		auto cycles = uint64_t{0};
+		auto serial_bytes = serial_bytes_;
+		// Resuming from a breakpoint runs the instruction there before breakpoints are checked again
+		auto resuming = false;
+
+		const auto stop = [&](const StopEvent& event, const char& serial_byte = {}) {
+			catch_up_display();
+			const auto result = Stop{event, cycles, cpu_.registers().read("PC"), serial_byte};
+			cycles = 0;
+			return result;
+		};
 
-				const auto joypad_update = joypad_.update(memory_.read(0xff00));
-				if (joypad_update.quit) {
-					break;
+		while (true) {
+			if (!resuming) {
+				const auto PC = cpu_.registers().read("PC");
+				if (std::find(begin(conditions.breakpoints), end(conditions.breakpoints), PC) != end(conditions.breakpoints)) {
+					resuming = true;
+					co_yield stop(StopEvent::breakpoint);
+					continue;
 				}
+			}
+			resuming = false;
+
+			const auto frame = frames_;
+			cycles += step_tracking_frames();
 
-				if (joypad_update.request_interupt) {
-					memory_.direct_write(0xff0f, memory_.direct_read(0xff0f) | 0x16);
+			// Before the other stops, they start counting the budget over
+			if (conditions.cycle_budget > 0 && cycles >= conditions.cycle_budget) {
+				co_yield stop(StopEvent::cycle_budget);
+			}
+
+			if (serial_bytes_ != serial_bytes) {
+				serial_bytes = serial_bytes_;
+				if (conditions.serial_byte) {
+					co_yield stop(StopEvent::serial_byte, serial_link_.back());
 				}
+			}
+
+			if (frames_ != frame && conditions.vblank) {
+				co_yield stop(StopEvent::vblank);
+			}
+		}
+	}
 
-				memory_.update_joypad(joypad_update.state);
+	// Returns number of cycles run, at least `cycles`
+	auto run_cycles(const uint64_t& cycles) -> uint64_t
+	{
+		auto total = uint64_t{0};
+		while (total < cycles) {
+			total += step_tracking_frames();
+		}
+
+		catch_up_display();
+		return total;
+	}
+
+	// One frame as the player sees it. With run-ahead the real frame is followed by more frames with the same input,
+	// the last of them is shown and the emulator is rolled back to the end of the real frame. Game's own input lag
+	// of up to that many frames is hidden this way.
+	auto run_host_frame() -> void
+	{
+		if (run_ahead_frames_ == 0) {
+			run_frame();
+			return;
+		}
+
+		display_.set_frame_hidden(true);
+		run_frame();
+		save_state(run_ahead_state_);
+
+		// Frames which are rolled back don't echo serial output or reach the profilers and the instruction trace, so
+		// those see every frame once. Tracepoints stay, inside a run_ahead span, as the time is really spent.
+		const auto serial_echo = std::exchange(serial_echo_, false);
+		auto* const guest_profiler = std::exchange(guest_profiler_, nullptr);
+		auto* const instruction_trace = std::exchange(instruction_trace_, nullptr);
+#if defined(GRAYBOY_PROFILE_OPCODES)
+		const auto opcode_profiler = thread_opcode_profiler();
+#endif
+		{
+			GRAYBOY_TRACE_SCOPE("run_ahead");
+			for (auto frame = uint32_t{1}; frame <= run_ahead_frames_; ++frame) {
+				display_.set_frame_hidden(frame < run_ahead_frames_);
+				run_frame();
 			}
 		}
+
+		load_state(run_ahead_state_);
+		display_.set_frame_hidden(false);
+
+		serial_echo_ = serial_echo;
+		guest_profiler_ = guest_profiler;
+		instruction_trace_ = instruction_trace;
+#if defined(GRAYBOY_PROFILE_OPCODES)
+		thread_opcode_profiler() = opcode_profiler;
+#endif
+	}
+
+	// 0 disables run-ahead
+	auto set_run_ahead(const uint32_t& frames) -> void
+	{
+		if (frames > MAX_RUN_AHEAD_FRAMES) {
+			throw std::invalid_argument("Can't run more than " + std::to_string(MAX_RUN_AHEAD_FRAMES) + " frames ahead");
+		}
+		run_ahead_frames_ = frames;
+	}
+
+	auto save_state(EmulatorState& state) -> void
+	{
+		catch_up_display();
+
+		state.registers = cpu_.registers();
+		memory_.save_state(state.memory);
+		timer_.save_state(state.timer);
+		display_.save_state(state.display);
+		state.total_cycles = total_cycles_;
+		state.frames = frames_;
+		state.frame_cycles = frame_cycles_;
+		state.serial_bytes = serial_bytes_;
+	}
+
+	auto load_state(const EmulatorState& state) -> void
+	{
+		// Cycles not caught up yet belong to the abandoned timeline
+		pending_display_cycles_ = 0;
+		display_interupt_stale_ = true;
+
+		cpu_.registers() = state.registers;
+		memory_.load_state(state.memory);
+		timer_.load_state(state.timer);
+		display_.load_state(state.display);
+		total_cycles_ = state.total_cycles;
+		frames_ = state.frames;
+		frame_cycles_ = state.frame_cycles;
+		frame_start_ = display_.frame_count();
+		// Bytes written after the state was saved are dropped, as far as they are still kept
+		const auto serial_bytes = std::min(serial_bytes_, state.serial_bytes);
+		const auto dropped = std::min<uint64_t>(serial_link_.size(), serial_bytes_ - serial_bytes);
+		serial_link_.resize(serial_link_.size() - static_cast<size_t>(dropped));
+		serial_bytes_ = serial_bytes;
 	}
 
 	auto execute_next() -> uint64_t
 	{
-		// save_debug();
+		if (instruction_trace_ != nullptr) {
+			instruction_trace_->record(instruction_record());
+		}
 
 		auto cycles = 0;
 
 		if (cpu_.registers().read_halt()) {
+			const auto PC = cpu_.registers().read("PC");
 			const auto interupt = check_interupts();
 			if (interupt > 0) {
 				cpu_.registers().set_halt(false);
@@ -86,6 +358,10 @@ public:
 			else {
 				cycles = 1;
 			}
+
+			if (guest_profiler_ != nullptr) {
+				guest_profiler_->advance(memory_.cartridge().rom_bank(), PC, cycles);
+			}
 		}
 		else {
 			// Interupts
@@ -93,14 +369,20 @@ public:
 				check_handle_interupts();
 			}
 
-			cycles = cpu_.execute_next(memory_);
+			cycles = guest_profiler_ != nullptr ? execute_profiled() : cpu_.execute_next(memory_);
 
 			const auto ff02 = memory_.read(0xff02);
 
 			if (ff02 == 0x81) {
 				const auto c = static_cast<char>(memory_.read(0xff01));
-				std::cout << c;
+				if (serial_echo_) {
+					std::cout << c;
+				}
+				if (serial_link_.size() == SERIAL_LINK_CAPACITY) {
+					serial_link_.erase(0, SERIAL_LINK_CAPACITY / 2);
+				}
 				serial_link_ += c;
+				++serial_bytes_;
 				memory_.write(0xff02, 0x80);
 			}
 		}
@@ -110,17 +392,321 @@ public:
 		return cycles;
 	}
 
-	auto execute_instructions(const uint64_t& count)
+	// One instruction with the display kept in step, as run_frame() runs them
+	auto step() -> uint64_t
+	{
+		return step_tracking_frames();
+	}
+
+	// Returns number of instructions executed, fewer than `count` if the stop condition was met
+	auto execute_instructions(const uint64_t& count) -> uint64_t
 	{
-		for (auto i = static_cast<uint64_t>(0); i < count; ++i) { execute_next(); }
+		stopped_by_condition_ = false;
+		for (auto i = static_cast<uint64_t>(0); i < count; ++i) {
+			execute_next();
+			if (stop_condition_ && stop_condition_met(false)) {
+				return i + 1;
+			}
+		}
+		return count;
 	}
 
+	// Last serial bytes, at most SERIAL_LINK_CAPACITY
 	auto get_serial_link() const -> const std::string&
 	{
 		return serial_link_;
 	}
 
+	// Serial output is always collected, this also prints it to stdout
+	auto set_serial_echo(const bool& enabled) -> void
+	{
+		serial_echo_ = enabled;
+	}
+
+	auto set_deferred_rendering([[maybe_unused]] const bool& enabled) -> void
+	{
+		if constexpr (!headless) {
+			display_.set_deferred_rendering(enabled);
+		}
+	}
+
+	// Fast-forward, headless run is never throttled
+	auto set_turbo([[maybe_unused]] const bool& enabled) -> void
+	{
+		if constexpr (!headless) {
+			display_.set_turbo(enabled);
+		}
+	}
+
+	[[nodiscard]] auto turbo() const -> bool
+	{
+		if constexpr (!headless) {
+			return display_.turbo();
+		}
+		return true;
+	}
+
+	auto set_turbo_settings([[maybe_unused]] const TurboSettings& settings) -> void
+	{
+		if constexpr (!headless) {
+			display_.set_turbo_settings(settings);
+		}
+	}
+
+	auto set_sync_to_display_refresh([[maybe_unused]] const bool& enabled) -> void
+	{
+		if constexpr (!headless) {
+			display_.set_sync_to_display_refresh(enabled);
+		}
+	}
+
+	[[nodiscard]] auto frame_time_stats() const -> FrameTimeStats
+	{
+		if constexpr (!headless) {
+			return display_.frame_time_stats();
+		}
+		return {};
+	}
+
+	// When enabled (default) the display isn't updated after every instruction, it catches up only when
+	// CPU accesses PPU memory/registers, when it may have requested an interupt or before the frame is rendered
+	auto set_lazy_display(const bool& enabled) -> void
+	{
+		catch_up_display();
+		lazy_display_ = enabled;
+
+		memory_.set_ppu_sync(enabled && display_.emulates_ppu() ? this : nullptr);
+	}
+
+	// Headless run skips the PPU by default, enabling it gives frames ending at VBlank and a framebuffer (embedding).
+	// Always on with a window.
+	auto set_headless_rendering([[maybe_unused]] const bool& enabled) -> void
+	{
+		if constexpr (headless) {
+			catch_up_display();
+			display_.set_ppu_enabled(enabled);
+			frame_start_ = display_.frame_count();
+			memory_.set_ppu_sync(lazy_display_ && display_.emulates_ppu() ? this : nullptr);
+		}
+	}
+
+	// Shade (0-3) of every pixel of the last rendered frame, row by row
+	[[nodiscard]] auto framebuffer() const -> const std::array<uint8_t, 160 * 144>&
+	{
+		return display_.framebuffer();
+	}
+
+	// Bits from the lowest: right, left, up, down, A, B, select, start. Set bit means pressed.
+	auto set_joypad(const uint8_t& state) -> void
+	{
+		const auto newly_pressed = static_cast<uint8_t>(state & ~memory_.joypad_state());
+		// Select bits as the game wrote them, read() would give the keys
+		const auto joyp = memory_.direct_read(0xff00);
+		const auto directions_selected = !(joyp & (1 << 4));
+		const auto buttons_selected = !(joyp & (1 << 5));
+
+		if ((directions_selected && (newly_pressed & 0x0f)) || (buttons_selected && (newly_pressed & 0xf0))) {
+			memory_.direct_write(0xff0f, memory_.direct_read(0xff0f) | 0x16);
+		}
+
+		memory_.update_joypad(state);
+	}
+
+	// Records frame times into `metrics` from now on, nullptr stops it. The metrics have to outlive the emulator or be
+	// removed first. PPU time is measured when the lazy display catches up, without it the PPU counts as CPU time.
+	auto set_frame_metrics(FrameMetrics* metrics) -> void
+	{
+		frame_metrics_ = metrics;
+		if constexpr (!headless) {
+			display_.set_frame_metrics(metrics);
+		}
+	}
+
+	// Samples guest PCs and call stacks from now on, nullptr stops it. The profiler has to outlive the emulator or be
+	// removed first.
+	auto set_guest_profiler(GuestProfiler* profiler) -> void
+	{
+		guest_profiler_ = profiler;
+		if (guest_profiler_ != nullptr) {
+			guest_profiler_->set_rom_banks(memory_.cartridge().rom_banks());
+		}
+	}
+
+	// Records the state before every instruction from now on, nullptr stops it. The writer has to outlive the emulator
+	// or be removed first.
+	auto set_instruction_trace(InstructionTraceWriter* trace) -> void
+	{
+		instruction_trace_ = trace;
+	}
+
+	// State before the next instruction as the binary trace records it
+	[[nodiscard]] auto instruction_record() const -> InstructionRecord
+	{
+		const auto& regs = cpu_.registers();
+		const auto PC = regs.read("PC");
+		const auto& instruction = cpu_.instruction_at(PC, memory_);
+
+		auto record = InstructionRecord{};
+		record.cycles = total_cycles_;
+		// Registers are stored F A C B E D L H
+		const auto dump = regs.dump();
+		record.registers = {dump[1], dump[0], dump[3], dump[2], dump[5], dump[4], dump[7], dump[6]};
+		record.PC = PC;
+		record.SP = regs.read("SP");
+		record.size = instruction.size;
+		for (auto i = uint16_t{0}; i < instruction.size; ++i) { record.bytes[i] = memory_.peek(static_cast<uint16_t>(PC + i)); }
+		record.bank = memory_.cartridge().rom_bank();
+		// Without catching up the lazy display, that would cost more than the whole record
+		record.ppu_mode = display_.mode_after(memory_, pending_display_cycles_, last_display_step_);
+		return record;
+	}
+
+	// Same as the CPU would read or write it
+	[[nodiscard]] auto read_memory(const uint16_t& address) -> uint8_t
+	{
+		return memory_.read(address);
+	}
+
+	auto write_memory(const uint16_t& address, const uint8_t& value) -> void
+	{
+		memory_.write(address, value);
+	}
+
+	// Same values as read_memory() of every address of the set, written into `out`
+	auto gather(const AddressSet& addresses, uint8_t* out) -> void
+	{
+		if (addresses.needs_ppu_sync() && lazy_display_) {
+			catch_up_display();
+		}
+		addresses.gather(memory_.data(), out);
+	}
+
+	auto sync_ppu(const uint16_t& address) -> void override
+	{
+		// Interupt flags are only outdated if the PPU could have requested an interupt since the last catch-up
+		if (address == 0xff0f && pending_display_cycles_ < display_interupt_cycles_) {
+			return;
+		}
+
+		catch_up_display();
+	}
+
 private:
+	auto update_display(const uint64_t& cycles) -> void
+	{
+		if (!lazy_display_) {
+			display_.update(memory_, cycles);
+			return;
+		}
+
+		pending_display_cycles_ += cycles;
+		last_display_step_ = cycles;
+
+		// PPU registers might have changed, it can request an interupt at a different time now
+		if (display_interupt_stale_) {
+			display_interupt_cycles_ = display_.cycles_to_interupt(memory_);
+			display_interupt_stale_ = false;
+		}
+	}
+
+	// One instruction, the lazy display is kept up to date enough to notice the end of a frame. Counts the frame if
+	// the instruction ended it.
+	auto step_tracking_frames() -> uint64_t
+	{
+		const auto cycles = execute_next();
+		update_display(cycles);
+
+		// VBlank is one of the interupts the lazy display is caught up for
+		if (lazy_display_ && pending_display_cycles_ >= display_interupt_cycles_) {
+			catch_up_display();
+		}
+
+		frame_cycles_ += cycles;
+		if (frame_ended()) {
+			++frames_;
+			frame_start_ = display_.frame_count();
+			frame_cycles_ = 0;
+		}
+		return cycles;
+	}
+
+	// PPU entered VBlank, or a frame worth of cycles ran without the PPU or with the LCD off
+	[[nodiscard]] auto frame_ended() const -> bool
+	{
+		if (display_.frame_count() != frame_start_) {
+			return true;
+		}
+
+		const auto lcd_enabled = static_cast<bool>(memory_.direct_read(0xff40) & (1 << 7));
+		return frame_cycles_ >= CYCLES_PER_FRAME && (!display_.emulates_ppu() || !lcd_enabled);
+	}
+
+	auto stop_condition_met(const bool& frame_end) -> bool
+	{
+		// Watched writes are taken even at frame end, so they don't trigger another evaluation right after it
+		const auto written = stop_check_ == StopCheck::watched_write && memory_.take_watched_write();
+		if (!frame_end && !written && stop_check_ != StopCheck::instruction) {
+			return false;
+		}
+
+		if (lazy_display_ && stop_condition_->needs_ppu_sync()) {
+			catch_up_display();
+		}
+		stopped_by_condition_ = stop_condition_->evaluate(memory_.data(), cpu_.registers(), frames_);
+		return stopped_by_condition_;
+	}
+
+	// Start of run_frame() for its CPU time, nothing is measured without metrics
+	struct FrameTiming {
+		explicit FrameTiming(const FrameMetrics* metrics)
+		{
+			if (metrics != nullptr) {
+				start = FrameMetrics::Clock::now();
+				ppu = metrics->current(FrameMetrics::ppu);
+			}
+		}
+
+		FrameMetrics::Clock::time_point start = {};
+		FrameMetrics::Clock::duration ppu = {};
+	};
+
+	// Time since `started` not spent in the PPU
+	auto add_cpu_time(const FrameTiming& started) -> void
+	{
+		if (frame_metrics_ != nullptr && started.start != FrameMetrics::Clock::time_point{}) {
+			const auto ppu = frame_metrics_->current(FrameMetrics::ppu) - started.ppu;
+			frame_metrics_->add(FrameMetrics::cpu, FrameMetrics::Clock::now() - started.start - ppu);
+		}
+	}
+
+	auto catch_up_display() -> void
+	{
+		if (frame_metrics_ != nullptr && pending_display_cycles_ > 0) {
+			const auto started = FrameMetrics::Clock::now();
+			display_.catch_up(memory_, pending_display_cycles_, last_display_step_);
+			frame_metrics_->add(FrameMetrics::ppu, FrameMetrics::Clock::now() - started);
+		}
+		else {
+			display_.catch_up(memory_, pending_display_cycles_, last_display_step_);
+		}
+		pending_display_cycles_ = 0;
+		display_interupt_stale_ = true;
+	}
+
+	// One instruction with its PC and stack changes reported to the guest profiler
+	auto execute_profiled() -> uint64_t
+	{
+		const auto& regs = cpu_.registers();
+		const auto bank = memory_.cartridge().rom_bank();
+		const auto PC = regs.read("PC");
+		const auto SP = regs.read("SP");
+		const auto opcode = memory_.read(PC);
+
+		const auto cycles = cpu_.execute_next(memory_);
+		guest_profiler_->instruction(bank, PC, opcode, SP, regs, cycles);
+		return cycles;
+	}
+
 	auto check_handle_interupts() -> void
 	{
 		const auto interupt = check_interupts();
@@ -160,6 +746,7 @@ private:
 
 	auto handle_interupt(const uint8_t& bit) -> uint64_t
 	{
+		GRAYBOY_TRACE_INSTANT("interupt", bit);
 		memory_.write(0xff0f, memory_.read(0xff0f) ^ bit);
 
 		auto& regs = cpu_.registers();
@@ -192,45 +779,11 @@ private:
 				break;
 		}
 
-		return 5;
-	}
-
-	// binjbg format
-	auto save_debug() -> void
-	{
-		debug_log << std::hex;
-		const auto PC = cpu_.registers().read("PC");
-		debug_log << "A:" << format(cpu_.registers().read("A"), 2) << ' ';
-		debug_log << "F:";
-		debug_log << (cpu_.registers().read_flag("Z") ? 'Z' : '-');
-		debug_log << (cpu_.registers().read_flag("N") ? 'N' : '-');
-		debug_log << (cpu_.registers().read_flag("H") ? 'H' : '-');
-		debug_log << (cpu_.registers().read_flag("C") ? 'C' : '-');
-		debug_log << ' ';
-		debug_log << "BC:" << format(cpu_.registers().read("B"), 2) << format(cpu_.registers().read("C"), 2) << ' ';
-		debug_log << "DE:" << format(cpu_.registers().read("D"), 2) << format(cpu_.registers().read("E"), 2) << ' ';
-		debug_log << "HL:" << format(cpu_.registers().read("H"), 2) << format(cpu_.registers().read("L"), 2) << ' ';
-		debug_log << "SP:" << format(cpu_.registers().read("SP"), 4) << ' ';
-		debug_log << "PC:" << format(PC, 4) << ' ';
-		debug_log << "(cy: " << std::dec << total_cycles_ * 4 << ") " << std::hex;
-		debug_log << "ppu:+" << (memory_.read(0xff41) & 0x3);
-		debug_log << "|[00]0x" << format(PC, 4) << ": ";
-
-		const auto info = cpu_.disassemble_next(PC, memory_);
-
-		for (auto i = size_t{0}; i < info.memory_representation.size(); ++i) {
-			debug_log << format(info.memory_representation[i], 2) << ' ';
+		if (guest_profiler_ != nullptr) {
+			guest_profiler_->interupt(memory_.cartridge().rom_bank(), PC, regs.read("PC"), static_cast<uint16_t>(SP - 2));
 		}
 
-		debug_log << "\t\t" << info.instruction.mnemonic << ' ';
-
-		// const auto mem = cpu_.get_memory();
-
-		// debug_log << " | 0xff04 [DIV]: " << format(mem.read(0xff04), 2);
-		// debug_log << " 0xff05 [TIMA]: " << format(mem.read(0xff05), 2);
-		// debug_log << " 0xff06 [TMA]: " << format(mem.read(0xff06), 2);
-		// debug_log << " 0xff07 [TAC]: " << format(mem.read(0xff07), 2);
-		debug_log << '\n';
+		return 5;
 	}
 
 	Cpu cpu_ = {};
@@ -238,9 +791,33 @@ private:
 	Joypad joypad_ = {};
 	Display<headless> display_ = {};
 	std::string serial_link_ = {};
+	uint64_t serial_bytes_ = {};
+	bool serial_echo_ = {};
 	Timer timer_ = {};
-	Fps fps_ = {};
 
 	uint64_t total_cycles_ = {};
-	std::ofstream debug_log = std::ofstream("debug_log");
+	uint64_t frames_ = {};
+	// Display's frame count when the frame in progress started
+	uint64_t frame_start_ = {};
+	uint64_t frame_cycles_ = {};
+
+	std::optional<Predicate> stop_condition_ = {};
+	StopCheck stop_check_ = StopCheck::watched_write;
+	bool stopped_by_condition_ = {};
+
+	GuestProfiler* guest_profiler_ = {};
+	FrameMetrics* frame_metrics_ = {};
+
+	bool lazy_display_ = true;
+	uint64_t pending_display_cycles_ = {};
+	// Cycles of the last instruction, the lazy display catches up with it in one step like the eager one
+	uint64_t last_display_step_ = {};
+	// Counted from the last catch-up
+	uint64_t display_interupt_cycles_ = {};
+	bool display_interupt_stale_ = true;
+
+	uint32_t run_ahead_frames_ = {};
+	EmulatorState run_ahead_state_ = {};
+
+	InstructionTraceWriter* instruction_trace_ = {};
 };
@@ -0,0 +1,282 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+struct DurationStats {
+	uint64_t count = {};
+	double mean_ms = {};
+	double p50_ms = {};
+	double p99_ms = {};
+	double max_ms = {};
+};
+
+// Durations in nanoseconds, 16 buckets per power of two so percentiles are within 6.25 %. One thread records, any
+// thread can read at the same time, nothing is locked.
+class DurationHistogram {
+public:
+	static constexpr size_t SUB_BUCKETS = 16;
+	// Values below 16 have a bucket each, then 16 for every bit position from 4 to 63
+	static constexpr size_t BUCKETS = 61 * SUB_BUCKETS;
+
+	// Only from the thread that owns the histogram, a plain load and store are cheaper than atomic increments
+	auto record(const uint64_t& nanoseconds) -> void
+	{
+		auto& bucket = buckets_[bucket_index(nanoseconds)];
+		bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		sum_.store(sum_.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+		if (nanoseconds > max_.load(std::memory_order_relaxed)) {
+			max_.store(nanoseconds, std::memory_order_relaxed);
+		}
+		count_.store(count_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+	[[nodiscard]] auto count() const -> uint64_t
+	{
+		return count_.load(std::memory_order_acquire);
+	}
+
+	[[nodiscard]] auto max() const -> uint64_t
+	{
+		return max_.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] auto mean() const -> double
+	{
+		const auto count = this->count();
+		return count == 0 ? 0.0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / static_cast<double>(count);
+	}
+
+	// Upper bound of the bucket the percentile falls into, `fraction` from 0 to 1
+	[[nodiscard]] auto percentile(const double& fraction) const -> uint64_t
+	{
+		auto counts = std::array<uint64_t, BUCKETS>{};
+		auto total = uint64_t{0};
+		for (auto i = size_t{0}; i < BUCKETS; ++i) {
+			counts[i] = buckets_[i].load(std::memory_order_relaxed);
+			total += counts[i];
+		}
+		if (total == 0) {
+			return 0;
+		}
+
+		const auto target = std::max(uint64_t{1}, static_cast<uint64_t>(fraction * static_cast<double>(total) + 0.5));
+		auto seen = uint64_t{0};
+		for (auto i = size_t{0}; i < BUCKETS; ++i) {
+			seen += counts[i];
+			if (seen >= target) {
+				return std::min(bucket_lower_bound(i + 1) - 1, max());
+			}
+		}
+		return max();
+	}
+
+	[[nodiscard]] auto stats() const -> DurationStats
+	{
+		const auto to_ms = 1e-6;
+		return {
+		  .count = count(),
+		  .mean_ms = mean() * to_ms,
+		  .p50_ms = static_cast<double>(percentile(0.5)) * to_ms,
+		  .p99_ms = static_cast<double>(percentile(0.99)) * to_ms,
+		  .max_ms = static_cast<double>(max()) * to_ms,
+		};
+	}
+
+	[[nodiscard]] static auto bucket_index(const uint64_t& value) -> size_t
+	{
+		if (value < SUB_BUCKETS) {
+			return value;
+		}
+		const auto msb = static_cast<size_t>(std::bit_width(value) - 1);
+		return (msb - 3) * SUB_BUCKETS + ((value >> (msb - 4)) & (SUB_BUCKETS - 1));
+	}
+
+	[[nodiscard]] static auto bucket_lower_bound(const size_t& index) -> uint64_t
+	{
+		if (index < SUB_BUCKETS) {
+			return index;
+		}
+		if (index >= BUCKETS) {
+			return UINT64_MAX;
+		}
+		const auto msb = index / SUB_BUCKETS + 3;
+		return (SUB_BUCKETS + index % SUB_BUCKETS) << (msb - 4);
+	}
+
+private:
+	std::array<std::atomic<uint64_t>, BUCKETS> buckets_ = {};
+	std::atomic<uint64_t> count_ = {};
+	std::atomic<uint64_t> sum_ = {};
+	std::atomic<uint64_t> max_ = {};
+};
+
+// Wall time of every frame and where it went: emulating the CPU (with timer and interupts), catching up the PPU,
+// composing the picture, presenting it and sleeping until the next frame. Phases add up during a frame and are
+// recorded by end_frame(), which Emulator::run() calls after presenting; hosts driving run_frame() call it themselves.
+// Attach it with Emulator::set_frame_metrics(). Readable from other threads while the emulator runs.
+class FrameMetrics {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	enum Phase { frame, cpu, ppu, compose, present, sleep, PHASES };
+
+	static constexpr std::array<const char*, PHASES> NAMES = {"frame", "cpu", "ppu", "compose", "present", "sleep"};
+
+	auto add(const Phase& phase, const Clock::duration& time) -> void
+	{
+		current_[phase] += time;
+	}
+
+	// Time added to the phase in the current frame
+	[[nodiscard]] auto current(const Phase& phase) const -> Clock::duration
+	{
+		return current_[phase];
+	}
+
+	// Records the phases, the frame phase is the time since the previous end_frame()
+	auto end_frame() -> void
+	{
+		const auto now = Clock::now();
+		if (last_frame_end_ != Clock::time_point{}) {
+			current_[frame] = now - last_frame_end_;
+		}
+		last_frame_end_ = now;
+
+		for (auto phase = size_t{0}; phase < PHASES; ++phase) {
+			if (phase != frame || current_[frame] != Clock::duration{}) {
+				histograms_[phase].record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(current_[phase]).count()));
+			}
+		}
+		current_ = {};
+		frames_.store(frames_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+
+	// Frames ended so far
+	[[nodiscard]] auto frames() const -> uint64_t
+	{
+		return frames_.load(std::memory_order_relaxed);
+	}
+
+	[[nodiscard]] auto histogram(const Phase& phase) const -> const DurationHistogram&
+	{
+		return histograms_[phase];
+	}
+
+	[[nodiscard]] auto stats(const Phase& phase) const -> DurationStats
+	{
+		return histograms_[phase].stats();
+	}
+
+	[[nodiscard]] auto json() const -> std::string
+	{
+		auto out = std::ostringstream{};
+		out << std::setprecision(4) << "{\"frames\": " << frames();
+		for (auto phase = size_t{0}; phase < PHASES; ++phase) {
+			const auto stats = histograms_[phase].stats();
+			out << ", \"" << NAMES[phase] << "\": {\"count\": " << stats.count << ", \"mean_ms\": " << stats.mean_ms;
+			out << ", \"p50_ms\": " << stats.p50_ms << ", \"p99_ms\": " << stats.p99_ms << ", \"max_ms\": " << stats.max_ms << '}';
+		}
+		out << "}\n";
+		return out.str();
+	}
+
+private:
+	std::array<Clock::duration, PHASES> current_ = {};
+	Clock::time_point last_frame_end_ = {};
+	std::array<DurationHistogram, PHASES> histograms_ = {};
+	std::atomic<uint64_t> frames_ = {};
+};
+
+// Every `interval` writes the metrics as JSON to `path` (replaced at once, readers never see half a file) and/or
+// prints frame rate and frame times to stdout, on its own thread so the emulator doesn't wait for either
+class FrameMetricsReporter {
+public:
+	FrameMetricsReporter(const FrameMetrics& metrics, const std::chrono::milliseconds& interval, std::string path, const bool& print)
+	  : metrics_{metrics}, interval_{interval}, path_{std::move(path)}, print_{print}
+	{
+		thread_ = std::thread{[this] { report_periodically(); }};
+	}
+
+	FrameMetricsReporter(const FrameMetricsReporter&) = delete;
+	auto operator=(const FrameMetricsReporter&) -> FrameMetricsReporter& = delete;
+
+	~FrameMetricsReporter()
+	{
+		{
+			const auto lock = std::scoped_lock{mutex_};
+			quit_ = true;
+		}
+		wake_.notify_all();
+		thread_.join();
+	}
+
+private:
+	auto report_periodically() -> void
+	{
+		auto frames = metrics_.frames();
+		auto last = FrameMetrics::Clock::now();
+		auto lock = std::unique_lock{mutex_};
+
+		while (true) {
+			const auto quit = wake_.wait_for(lock, interval_, [this] { return quit_; });
+
+			const auto now = FrameMetrics::Clock::now();
+			const auto new_frames = metrics_.frames();
+			const auto seconds = std::chrono::duration<double>(now - last).count();
+			if (print_ && !quit && seconds > 0) {
+				const auto stats = metrics_.stats(FrameMetrics::frame);
+				auto line = std::ostringstream{};
+				line << std::fixed << std::setprecision(2) << "FPS: " << static_cast<double>(new_frames - frames) / seconds;
+				line << ", frame p50 " << stats.p50_ms << " ms, p99 " << stats.p99_ms << " ms, max " << stats.max_ms << " ms\n";
+				std::cout << line.str() << std::flush;
+			}
+			frames = new_frames;
+			last = now;
+
+			if (!path_.empty()) {
+				write();
+			}
+			if (quit) {
+				return;
+			}
+		}
+	}
+
+	auto write() const -> void
+	{
+		const auto temporary = path_ + ".tmp";
+		{
+			auto file = std::ofstream(temporary);
+			file << metrics_.json();
+			if (!file) {
+				return;
+			}
+		}
+		auto error = std::error_code{};
+		std::filesystem::rename(temporary, path_, error);
+	}
+
+	const FrameMetrics& metrics_;
+	std::chrono::milliseconds interval_ = {};
+	std::string path_ = {};
+	bool print_ = {};
+
+	std::mutex mutex_ = {};
+	std::condition_variable wake_ = {};
+	bool quit_ = {};
+	std::thread thread_ = {};
+};
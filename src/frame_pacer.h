@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+
+struct FrameTimeStats {
+	uint64_t frames = {};
+	double mean_ms = {};
+	// Standard deviation of the frame time
+	double jitter_ms = {};
+	// Largest difference between a frame time and the target period
+	double max_error_ms = {};
+};
+
+// Time source of the pacer, tests use one they control
+struct SteadySleepClock : std::chrono::steady_clock {
+	static auto sleep_until(const time_point& time) -> void
+	{
+		std::this_thread::sleep_until(time);
+	}
+};
+
+// Paces frames to an exact period. Deadlines are computed from a fixed point in time so rounding errors don't add up.
+// OS sleep overshoots by a varying amount, so the pacer sleeps until a bit before the deadline and spins the rest.
+template<typename TClock = SteadySleepClock>
+class BasicFramePacer {
+public:
+	using Clock = TClock;
+	using Duration = std::chrono::duration<double>;
+
+	// 70224 cycles of the 4.194304 MHz clock, ~16.74 ms
+	static constexpr auto GAME_BOY_FRAME = Duration{70'224.0 / 4'194'304.0};
+
+	BasicFramePacer() = default;
+	explicit BasicFramePacer(const Duration& period) : period_{period} {}
+
+	auto set_period(const Duration& period) -> void
+	{
+		if (period != period_) {
+			period_ = period;
+			rebase(deadline_);
+		}
+	}
+
+	[[nodiscard]] auto period() const -> Duration
+	{
+		return period_;
+	}
+
+	// Blocks until the next frame should start
+	auto wait_next_frame() -> void
+	{
+		++frames_since_base_;
+		deadline_ = base_ + std::chrono::duration_cast<typename Clock::duration>(period_ * frames_since_base_);
+
+		auto now = Clock::now();
+
+		// Way too late (stall, debugger, unthrottled run), start over instead of rushing frames to catch up
+		if (now - deadline_ > period_ * MAX_LAG_FRAMES) {
+			rebase(now);
+			record_frame(now);
+			return;
+		}
+
+		if (deadline_ - now > spin_margin_) {
+			const auto wake_up = deadline_ - std::chrono::duration_cast<typename Clock::duration>(spin_margin_);
+			Clock::sleep_until(wake_up);
+
+			// Margin follows the overshoot seen recently and slowly decays when sleeps get precise
+			const auto overshoot = Duration{Clock::now() - wake_up};
+			spin_margin_ = std::clamp(std::max(overshoot * 2, spin_margin_ * 0.95), MIN_SPIN_MARGIN, MAX_SPIN_MARGIN);
+		}
+
+		while (now < deadline_) { now = Clock::now(); }
+
+		record_frame(now);
+	}
+
+	// Counts a frame something else already waited for (vsync), the next one is paced from now if it isn't
+	auto frame_presented() -> void
+	{
+		const auto now = Clock::now();
+		rebase(now);
+		record_frame(now);
+	}
+
+	// Starts pacing from now, e.g. after running unthrottled
+	auto reset() -> void
+	{
+		rebase(Clock::now());
+		last_frame_ = {};
+	}
+
+	[[nodiscard]] auto stats() const -> FrameTimeStats
+	{
+		const auto to_ms = 1000.0;
+		return {
+		  .frames = measured_frames_,
+		  .mean_ms = mean_ * to_ms,
+		  .jitter_ms = measured_frames_ > 0 ? std::sqrt(m2_ / static_cast<double>(measured_frames_)) * to_ms : 0.0,
+		  .max_error_ms = max_error_ * to_ms,
+		};
+	}
+
+	auto reset_stats() -> void
+	{
+		measured_frames_ = {};
+		mean_ = m2_ = max_error_ = {};
+	}
+
+private:
+	static constexpr auto MAX_LAG_FRAMES = 4;
+	static constexpr auto MIN_SPIN_MARGIN = Duration{0.000'2};
+	static constexpr auto MAX_SPIN_MARGIN = Duration{0.004};
+
+	auto rebase(const typename Clock::time_point& base) -> void
+	{
+		base_ = deadline_ = base;
+		frames_since_base_ = 0;
+	}
+
+	auto record_frame(const typename Clock::time_point& now) -> void
+	{
+		if (last_frame_ != typename Clock::time_point{}) {
+			const auto frame_time = Duration{now - last_frame_}.count();
+
+			// Welford's running mean and variance
+			++measured_frames_;
+			const auto delta = frame_time - mean_;
+			mean_ += delta / static_cast<double>(measured_frames_);
+			m2_ += delta * (frame_time - mean_);
+			max_error_ = std::max(max_error_, std::abs(frame_time - period_.count()));
+		}
+		last_frame_ = now;
+	}
+
+	Duration period_ = GAME_BOY_FRAME;
+	Duration spin_margin_ = Duration{0.001};
+
+	typename Clock::time_point base_ = Clock::now();
+	typename Clock::time_point deadline_ = base_;
+	uint64_t frames_since_base_ = {};
+
+	typename Clock::time_point last_frame_ = {};
+	uint64_t measured_frames_ = {};
+	double mean_ = {};
+	double m2_ = {};
+	double max_error_ = {};
+};
+
+using FramePacer = BasicFramePacer<>;
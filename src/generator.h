@@ -0,0 +1,100 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// Minimal lazy generator (std::generator is C++23). Nothing runs until the first next(), every next() runs the
+// coroutine up to its following co_yield and returns the yielded value, or nullopt once it has returned.
+template<typename T>
+class Generator {
+public:
+	struct promise_type {
+		std::optional<T> value = {};
+		std::exception_ptr error = {};
+
+		auto get_return_object() -> Generator
+		{
+			return Generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+		}
+
+		auto initial_suspend() noexcept -> std::suspend_always
+		{
+			return {};
+		}
+
+		auto final_suspend() noexcept -> std::suspend_always
+		{
+			return {};
+		}
+
+		auto yield_value(T yielded) -> std::suspend_always
+		{
+			value = std::move(yielded);
+			return {};
+		}
+
+		auto return_void() -> void {}
+
+		auto unhandled_exception() -> void
+		{
+			error = std::current_exception();
+		}
+	};
+
+	Generator() = default;
+
+	Generator(const Generator&) = delete;
+	auto operator=(const Generator&) -> Generator& = delete;
+
+	Generator(Generator&& other) noexcept : handle_{std::exchange(other.handle_, {})} {}
+
+	auto operator=(Generator&& other) noexcept -> Generator&
+	{
+		if (this != &other) {
+			destroy();
+			handle_ = std::exchange(other.handle_, {});
+		}
+		return *this;
+	}
+
+	~Generator()
+	{
+		destroy();
+	}
+
+	// Exceptions thrown by the coroutine are rethrown here
+	auto next() -> std::optional<T>
+	{
+		if (!handle_ || handle_.done()) {
+			return std::nullopt;
+		}
+
+		auto& promise = handle_.promise();
+		promise.value.reset();
+		handle_.resume();
+
+		if (promise.error) {
+			std::rethrow_exception(std::exchange(promise.error, {}));
+		}
+		return std::move(promise.value);
+	}
+
+	[[nodiscard]] auto done() const -> bool
+	{
+		return !handle_ || handle_.done();
+	}
+
+private:
+	explicit Generator(const std::coroutine_handle<promise_type>& handle) : handle_{handle} {}
+
+	auto destroy() -> void
+	{
+		if (handle_) {
+			handle_.destroy();
+		}
+	}
+
+	std::coroutine_handle<promise_type> handle_ = {};
+};
@@ -0,0 +1,191 @@
+#include "grayboy.h"
+
+#include "emulator.h"
+
+#include <exception>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// FNV-1a, tells ROMs apart well enough to catch a state loaded into the wrong emulator
+auto identify_rom(const std::vector<uint8_t>& rom) -> uint64_t
+{
+	auto id = uint64_t{0xcbf29ce484222325};
+	for (const auto byte : rom) { id = (id ^ byte) * 0x100000001b3; }
+	return id;
+}
+
+} // namespace
+
+struct grayboy {
+	explicit grayboy(std::vector<uint8_t> rom) : rom_id{identify_rom(rom)}, rom_size{rom.size()}, emulator{Cartridge{std::move(rom)}}
+	{
+		emulator.set_headless_rendering(true);
+		emulator.save_state(power_on);
+	}
+
+	uint64_t rom_id;
+	size_t rom_size;
+	Emulator<true> emulator;
+	EmulatorState power_on = {};
+	std::string error = {};
+};
+
+// ROM it was saved from, a state never saved has size 0
+struct grayboy_state {
+	uint64_t rom_id = {};
+	size_t rom_size = {};
+	EmulatorState state = {};
+};
+
+namespace {
+
+// Exceptions must not cross the C boundary, they end up as the last error and `on_error` is returned
+template<typename Result, typename Function>
+auto guarded(grayboy* gb, const Result& on_error, const Function& function) -> Result
+{
+	if (gb == nullptr) {
+		return on_error;
+	}
+
+	try {
+		gb->error.clear();
+		return function(*gb);
+	}
+	catch (const std::exception& e) {
+		gb->error = e.what();
+	}
+	catch (...) {
+		gb->error = "Unknown error";
+	}
+	return on_error;
+}
+
+} // namespace
+
+extern "C" {
+
+int grayboy_api_version(void)
+{
+	return GRAYBOY_API_VERSION;
+}
+
+grayboy* grayboy_create(const uint8_t* rom, size_t size)
+{
+	if (rom == nullptr) {
+		return nullptr;
+	}
+
+	try {
+		return new grayboy(std::vector<uint8_t>(rom, rom + size));
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void grayboy_destroy(grayboy* gb)
+{
+	delete gb;
+}
+
+int grayboy_reset(grayboy* gb)
+{
+	return guarded(gb, int{GRAYBOY_ERROR}, [](grayboy& gb) {
+		gb.emulator.load_state(gb.power_on);
+		return int{GRAYBOY_OK};
+	});
+}
+
+uint64_t grayboy_step_frames(grayboy* gb, uint32_t frames)
+{
+	return guarded(gb, uint64_t{0}, [frames](grayboy& gb) {
+		auto cycles = uint64_t{0};
+		for (auto frame = uint32_t{0}; frame < frames; ++frame) { cycles += gb.emulator.run_frame(); }
+		return cycles;
+	});
+}
+
+uint64_t grayboy_step_cycles(grayboy* gb, uint64_t cycles)
+{
+	return guarded(gb, uint64_t{0}, [cycles](grayboy& gb) { return gb.emulator.run_cycles(cycles); });
+}
+
+void grayboy_set_joypad(grayboy* gb, uint8_t buttons)
+{
+	guarded(gb, 0, [buttons](grayboy& gb) {
+		gb.emulator.set_joypad(buttons);
+		return 0;
+	});
+}
+
+const uint8_t* grayboy_framebuffer(const grayboy* gb)
+{
+	return gb != nullptr ? gb->emulator.framebuffer().data() : nullptr;
+}
+
+uint8_t grayboy_read(grayboy* gb, uint16_t address)
+{
+	return guarded(gb, uint8_t{0xff}, [address](grayboy& gb) { return gb.emulator.read_memory(address); });
+}
+
+void grayboy_write(grayboy* gb, uint16_t address, uint8_t value)
+{
+	guarded(gb, 0, [address, value](grayboy& gb) {
+		gb.emulator.write_memory(address, value);
+		return 0;
+	});
+}
+
+grayboy_state* grayboy_state_create(void)
+{
+	try {
+		return new grayboy_state{};
+	}
+	catch (...) {
+		return nullptr;
+	}
+}
+
+void grayboy_state_destroy(grayboy_state* state)
+{
+	delete state;
+}
+
+int grayboy_save_state(grayboy* gb, grayboy_state* state)
+{
+	return guarded(gb, int{GRAYBOY_ERROR}, [state](grayboy& gb) {
+		if (state == nullptr) {
+			throw std::invalid_argument("state is null");
+		}
+		gb.emulator.save_state(state->state);
+		state->rom_id = gb.rom_id;
+		state->rom_size = gb.rom_size;
+		return int{GRAYBOY_OK};
+	});
+}
+
+int grayboy_load_state(grayboy* gb, const grayboy_state* state)
+{
+	return guarded(gb, int{GRAYBOY_ERROR}, [state](grayboy& gb) {
+		if (state == nullptr) {
+			throw std::invalid_argument("state is null");
+		}
+		if (state->rom_size == 0) {
+			throw std::invalid_argument("State was never saved");
+		}
+		if (state->rom_id != gb.rom_id || state->rom_size != gb.rom_size) {
+			throw std::invalid_argument("State was saved from another ROM");
+		}
+
+		gb.emulator.load_state(state->state);
+		return int{GRAYBOY_OK};
+	});
+}
+
+const char* grayboy_last_error(const grayboy* gb)
+{
+	return gb != nullptr ? gb->error.c_str() : "";
+}
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+// C interface of the emulator for embedding. Emulators are headless with the PPU enabled, nothing is shown and
+// nothing is paced. Functions never throw, failures are reported by the return value and grayboy_last_error().
+// One emulator must not be used from more threads at once, different emulators are independent.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#define GRAYBOY_API __declspec(dllexport)
+#else
+#define GRAYBOY_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Incremented on every incompatible change of this header
+#define GRAYBOY_API_VERSION 1
+
+#define GRAYBOY_WIDTH 160
+#define GRAYBOY_HEIGHT 144
+
+enum {
+	GRAYBOY_OK = 0,
+	GRAYBOY_ERROR = -1,
+};
+
+// Joypad bits, set bit means pressed
+enum {
+	GRAYBOY_RIGHT = 1 << 0,
+	GRAYBOY_LEFT = 1 << 1,
+	GRAYBOY_UP = 1 << 2,
+	GRAYBOY_DOWN = 1 << 3,
+	GRAYBOY_A = 1 << 4,
+	GRAYBOY_B = 1 << 5,
+	GRAYBOY_SELECT = 1 << 6,
+	GRAYBOY_START = 1 << 7,
+};
+
+typedef struct grayboy grayboy;
+typedef struct grayboy_state grayboy_state;
+
+GRAYBOY_API int grayboy_api_version(void);
+
+// The ROM is copied, returns NULL if it can't be loaded
+GRAYBOY_API grayboy* grayboy_create(const uint8_t* rom, size_t size);
+GRAYBOY_API void grayboy_destroy(grayboy* gb);
+
+// Back to the state right after grayboy_create()
+GRAYBOY_API int grayboy_reset(grayboy* gb);
+
+// Frames end at VBlank. Both return the number of cycles (1.048576 MHz) run, 0 on error.
+GRAYBOY_API uint64_t grayboy_step_frames(grayboy* gb, uint32_t frames);
+// Stops at the first instruction boundary at or after `cycles`
+GRAYBOY_API uint64_t grayboy_step_cycles(grayboy* gb, uint64_t cycles);
+
+// GRAYBOY_* joypad bits, stays until the next call
+GRAYBOY_API void grayboy_set_joypad(grayboy* gb, uint8_t buttons);
+
+// GRAYBOY_WIDTH * GRAYBOY_HEIGHT shades (0 lightest - 3 darkest), row by row. Valid until the emulator is destroyed,
+// the content changes while stepping.
+GRAYBOY_API const uint8_t* grayboy_framebuffer(const grayboy* gb);
+
+// Reads and writes go through the memory map as CPU accesses do (ROM writes switch banks)
+GRAYBOY_API uint8_t grayboy_read(grayboy* gb, uint16_t address);
+GRAYBOY_API void grayboy_write(grayboy* gb, uint16_t address, uint8_t value);
+
+// Snapshot of a whole emulator. Saving into the same state again doesn't allocate.
+GRAYBOY_API grayboy_state* grayboy_state_create(void);
+GRAYBOY_API void grayboy_state_destroy(grayboy_state* state);
+GRAYBOY_API int grayboy_save_state(grayboy* gb, grayboy_state* state);
+// Only states saved from an emulator of the same ROM can be loaded
+GRAYBOY_API int grayboy_load_state(grayboy* gb, const grayboy_state* state);
+
+// Message of the last failed call on this emulator, empty if there was none
+GRAYBOY_API const char* grayboy_last_error(const grayboy* gb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,312 @@
+#pragma once
+
+#include "registers.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Samples where the guest spends its cycles: every `period` cycles the PC (with its ROM bank) goes into a histogram
+// and the call stack into a table of stacks. Stacks are followed through CALL, RST and interupts, a frame ends once
+// SP is above its return address again (RET, RETI or popping it). Attach it with Emulator::set_guest_profiler().
+//
+// Names come from an RGBDS .sym file when loaded, otherwise locations are written as bank:address.
+class GuestProfiler {
+public:
+	static constexpr size_t MAX_DEPTH = 64;
+
+	// ROM bank and address, bank is 0 outside of 0x4000-0x7fff
+	using Location = uint32_t;
+
+	struct HotSpot {
+		Location location = {};
+		uint64_t samples = {};
+	};
+
+	explicit GuestProfiler(const uint64_t& period = 1024) : period_{period}
+	{
+		if (period == 0) {
+			throw std::invalid_argument("Sampling period has to be at least one cycle");
+		}
+	}
+
+	[[nodiscard]] static auto location(const uint8_t& bank, const uint16_t& address) -> Location
+	{
+		return address >= 0x4000 && address <= 0x7fff ? static_cast<Location>(bank) << 16 | address : address;
+	}
+
+	// Sizes the histogram for the cartridge, clears the profile if it changes
+	auto set_rom_banks(const size_t& banks) -> void
+	{
+		if (banks != rom_banks_) {
+			rom_banks_ = banks;
+			histogram_.assign(rom_banks_ * 0x4000 + 0x8000, 0);
+			stacks_.clear();
+			samples_ = 0;
+		}
+	}
+
+	// Lines of "bank:address name", as rgblink -n writes them. Local labels (with a dot) are skipped, samples in them
+	// belong to their function.
+	auto load_symbols(const std::string& path) -> void
+	{
+		auto file = std::ifstream(path);
+		if (!file) {
+			throw std::runtime_error("Can't open " + path);
+		}
+
+		auto line = std::string{};
+		while (std::getline(file, line)) {
+			line = line.substr(0, line.find(';'));
+			auto fields = std::istringstream{line};
+			auto position = std::string{};
+			auto name = std::string{};
+			if (!(fields >> position >> name) || name.find('.') != std::string::npos) {
+				continue;
+			}
+
+			const auto colon = position.find(':');
+			if (colon == std::string::npos) {
+				continue;
+			}
+			try {
+				const auto bank = std::stoul(position.substr(0, colon), nullptr, 16);
+				const auto address = std::stoul(position.substr(colon + 1), nullptr, 16);
+				if (bank <= 0xff && address <= 0xffff) {
+					add_symbol(static_cast<uint8_t>(bank), static_cast<uint16_t>(address), name);
+				}
+			}
+			catch (const std::logic_error&) {
+				continue;
+			}
+		}
+	}
+
+	auto add_symbol(const uint8_t& bank, const uint16_t& address, const std::string& name) -> void
+	{
+		symbols_[location(bank, address)] = name;
+	}
+
+	// Interupt dispatched while at `PC`, jumping to `vector` with the return address pushed to `SP`
+	auto interupt(const uint8_t& bank, const uint16_t& PC, const uint16_t& vector, const uint16_t& SP) -> void
+	{
+		push({location(bank, PC), location(bank, vector), SP});
+	}
+
+	// Instruction `opcode` at `PC` ran for `cycles`, `SP` is from before it and `registers` after
+	auto instruction(const uint8_t& bank, const uint16_t& PC, const uint8_t& opcode, const uint16_t& SP, const Registers& registers, const uint64_t& cycles) -> void
+	{
+		advance(bank, PC, cycles);
+
+		const auto next_SP = registers.read("SP");
+		while (!frames_.empty() && next_SP > frames_.back().stack_pointer) { frames_.pop_back(); }
+
+		// Conditional calls that aren't taken don't push
+		if (is_call(opcode) && next_SP == static_cast<uint16_t>(SP - 2)) {
+			push({location(bank, PC), location(bank, registers.read("PC")), next_SP});
+		}
+	}
+
+	// `cycles` spent at `PC` without an instruction, e.g. in HALT
+	auto advance(const uint8_t& bank, const uint16_t& PC, const uint64_t& cycles) -> void
+	{
+		elapsed_ += cycles;
+		while (elapsed_ >= period_) {
+			elapsed_ -= period_;
+			sample(location(bank, PC));
+		}
+	}
+
+	auto reset() -> void
+	{
+		std::fill(begin(histogram_), end(histogram_), 0);
+		stacks_.clear();
+		frames_.clear();
+		samples_ = 0;
+		elapsed_ = 0;
+	}
+
+	[[nodiscard]] auto samples() const -> uint64_t
+	{
+		return samples_;
+	}
+
+	// Samples at exactly this location
+	[[nodiscard]] auto samples_at(const uint8_t& bank, const uint16_t& address) const -> uint64_t
+	{
+		const auto index = histogram_index(location(bank, address));
+		return index < histogram_.size() ? histogram_[index] : 0;
+	}
+
+	// Current call stack depth
+	[[nodiscard]] auto depth() const -> size_t
+	{
+		return frames_.size();
+	}
+
+	// Most sampled locations, most samples first
+	[[nodiscard]] auto hot_spots(const size_t& count) const -> std::vector<HotSpot>
+	{
+		auto spots = std::vector<HotSpot>{};
+		for (auto index = size_t{0}; index < histogram_.size(); ++index) {
+			if (histogram_[index] > 0) {
+				spots.push_back({histogram_location(index), histogram_[index]});
+			}
+		}
+		std::stable_sort(begin(spots), end(spots), [](const auto& a, const auto& b) { return a.samples > b.samples; });
+		spots.resize(std::min(count, spots.size()));
+		return spots;
+	}
+
+	// Symbol containing the location plus offset, or bank:address
+	[[nodiscard]] auto name(const Location& location) const -> std::string
+	{
+		auto out = std::ostringstream{};
+		out << std::hex << std::setfill('0');
+
+		const auto symbol = find_symbol(location);
+		if (symbol == end(symbols_)) {
+			out << std::setw(2) << (location >> 16) << ':' << std::setw(4) << (location & 0xffff);
+			return out.str();
+		}
+
+		out << symbol->second;
+		if (symbol->first != location) {
+			out << "+0x" << location - symbol->first;
+		}
+		return out.str();
+	}
+
+	// One "caller;...;callee samples" line per stack, the input of flamegraph.pl and speedscope. Frames are named by the
+	// function called, the outermost by the function it's called from ("root" without symbols).
+	[[nodiscard]] auto collapsed() const -> std::string
+	{
+		auto lines = std::map<std::string, uint64_t>{};
+		for (const auto& [stack, count] : stacks_) {
+			auto line = symbols_.empty() ? std::string{"root"} : function_name(stack.front());
+			for (auto frame = begin(stack) + 1; frame != end(stack); ++frame) { line += ';' + function_name(*frame); }
+			lines[line] += count;
+		}
+
+		auto out = std::ostringstream{};
+		for (const auto& [line, count] : lines) { out << line << ' ' << count << '\n'; }
+		return out.str();
+	}
+
+	auto write_collapsed(const std::string& path) const -> void
+	{
+		auto file = std::ofstream(path);
+		file << collapsed();
+		if (!file) {
+			throw std::runtime_error("Can't write " + path);
+		}
+	}
+
+	// Hot spots as a table, for a quick look without a flame graph
+	[[nodiscard]] auto report(const size_t& count = 20) const -> std::string
+	{
+		auto out = std::ostringstream{};
+		out << std::fixed << std::setprecision(2);
+		out << "samples        %  location\n";
+		for (const auto& spot : hot_spots(count)) {
+			out << std::setw(7) << spot.samples << std::setw(9) << 100.0 * static_cast<double>(spot.samples) / static_cast<double>(samples_);
+			out << "  " << name(spot.location) << '\n';
+		}
+		return out.str();
+	}
+
+private:
+	struct Frame {
+		Location call_site = {};
+		Location target = {};
+		// Where the return address is
+		uint16_t stack_pointer = {};
+	};
+
+	[[nodiscard]] static auto is_call(const uint8_t& opcode) -> bool
+	{
+		// call, call cc and rst
+		return opcode == 0xcd || (opcode & 0xe7) == 0xc4 || (opcode & 0xc7) == 0xc7;
+	}
+
+	auto push(const Frame& frame) -> void
+	{
+		// Code that never returns (e.g. jumps out of subroutines) mustn't grow the stack forever
+		if (frames_.size() == MAX_DEPTH) {
+			frames_.erase(begin(frames_));
+		}
+		frames_.push_back(frame);
+	}
+
+	auto sample(const Location& location) -> void
+	{
+		++samples_;
+		const auto index = histogram_index(location);
+		if (index < histogram_.size()) {
+			++histogram_[index];
+		}
+
+		// The outermost caller, then every function called
+		auto stack = std::vector<Location>{frames_.empty() ? location : frames_.front().call_site};
+		for (const auto& frame : frames_) { stack.push_back(frame.target); }
+		++stacks_[stack];
+	}
+
+	// ROM by offset in the file, the rest of the address space after it
+	[[nodiscard]] auto histogram_index(const Location& location) const -> size_t
+	{
+		const auto address = location & 0xffff;
+		if (address < 0x4000) {
+			return address;
+		}
+		if (address < 0x8000) {
+			return (location >> 16) * 0x4000 + address - 0x4000;
+		}
+		return rom_banks_ * 0x4000 + address - 0x8000;
+	}
+
+	[[nodiscard]] auto histogram_location(const size_t& index) const -> Location
+	{
+		if (index < 0x4000) {
+			return static_cast<Location>(index);
+		}
+		if (index < rom_banks_ * 0x4000) {
+			return location(static_cast<uint8_t>(index / 0x4000), static_cast<uint16_t>(0x4000 + index % 0x4000));
+		}
+		return static_cast<Location>(index - rom_banks_ * 0x4000 + 0x8000);
+	}
+
+	// Closest symbol at or before the location in the same bank
+	[[nodiscard]] auto find_symbol(const Location& location) const -> std::map<Location, std::string>::const_iterator
+	{
+		auto it = symbols_.upper_bound(location);
+		if (it == begin(symbols_)) {
+			return end(symbols_);
+		}
+		--it;
+		return it->first >> 16 == location >> 16 ? it : end(symbols_);
+	}
+
+	[[nodiscard]] auto function_name(const Location& location) const -> std::string
+	{
+		const auto symbol = find_symbol(location);
+		return symbol == end(symbols_) ? name(location) : symbol->second;
+	}
+
+	uint64_t period_ = {};
+	uint64_t elapsed_ = {};
+	uint64_t samples_ = {};
+
+	size_t rom_banks_ = 2;
+	std::vector<uint64_t> histogram_ = std::vector<uint64_t>(2 * 0x4000 + 0x8000);
+	std::map<std::vector<Location>, uint64_t> stacks_ = {};
+	std::vector<Frame> frames_ = {};
+
+	std::map<Location, std::string> symbols_ = {};
+};
@@ -0,0 +1,291 @@
+#pragma once
+
+#include "instruction_utils.h"
+
+#include <array>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Binary trace of executed instructions: the state before every instruction in fixed 32 byte records, written by a
+// background thread so the emulator only copies a record per instruction. trace2text renders a trace as the binjgb
+// text log.
+
+struct InstructionRecord {
+	// Machine cycles before the instruction, binjgb counts clock cycles (4 times as many)
+	uint64_t cycles = {};
+	// A F B C D E H L
+	std::array<uint8_t, 8> registers = {};
+	uint16_t PC = {};
+	uint16_t SP = {};
+	// Only the first `size` are the instruction's
+	std::array<uint8_t, 3> bytes = {};
+	uint8_t size = {};
+	uint8_t bank = {};
+	uint8_t ppu_mode = {};
+	std::array<uint8_t, 6> reserved = {};
+
+	auto operator==(const InstructionRecord&) const -> bool = default;
+};
+
+static_assert(sizeof(InstructionRecord) == 32 && std::is_trivially_copyable_v<InstructionRecord>);
+
+struct InstructionTraceHeader {
+	std::array<char, 8> magic = {'G', 'B', 'I', 'T', 'R', 'A', 'C', 'E'};
+	uint32_t version = 1;
+	uint32_t record_size = sizeof(InstructionRecord);
+};
+
+// Writes records in chunks through a ring of CHUNKS buffers. Nothing is dropped: when the writer falls behind the
+// emulator waits for a free buffer, a trace with holes would be useless for comparing against another emulator.
+// A failed write is reported by the next record() that hands over a chunk, or by finish().
+class InstructionTraceWriter {
+public:
+	// 1 MiB each
+	static constexpr size_t CHUNK_RECORDS = 1 << 15;
+	static constexpr size_t CHUNKS = 8;
+
+	explicit InstructionTraceWriter(const std::string& path) : path_{path}, file_{std::fopen(path.c_str(), "wb")}
+	{
+		if (file_ == nullptr) {
+			throw std::runtime_error("Can't open instruction trace " + path);
+		}
+		const auto header = InstructionTraceHeader{};
+		if (std::fwrite(&header, sizeof(header), 1, file_) != 1) {
+			std::fclose(file_);
+			throw std::runtime_error("Can't write instruction trace " + path + ": " + std::strerror(errno));
+		}
+
+		for (auto& chunk : chunks_) { chunk.resize(CHUNK_RECORDS); }
+		writer_ = std::thread{[this] { write_chunks(); }};
+	}
+
+	InstructionTraceWriter(const InstructionTraceWriter&) = delete;
+	auto operator=(const InstructionTraceWriter&) -> InstructionTraceWriter& = delete;
+
+	// Errors can't be reported from here, call finish() to know the whole trace was written
+	~InstructionTraceWriter()
+	{
+		try {
+			finish();
+		}
+		catch (const std::runtime_error&) {
+		}
+	}
+
+	// Writes the rest and closes the file, throws if any of the trace couldn't be written. Ends the trace, nothing can be
+	// recorded after it.
+	auto finish() -> void
+	{
+		if (file_ == nullptr) {
+			return;
+		}
+
+		submit();
+		{
+			const auto lock = std::scoped_lock{mutex_};
+			quit_ = true;
+		}
+		wake_writer_.notify_all();
+		writer_.join();
+
+		const auto closed = std::fclose(file_) == 0;
+		file_ = nullptr;
+		if (!error_.empty()) {
+			throw std::runtime_error(error_);
+		}
+		if (!closed) {
+			throw std::runtime_error("Can't write instruction trace " + path_ + ": " + std::strerror(errno));
+		}
+	}
+
+	auto record(const InstructionRecord& record) -> void
+	{
+		chunks_[head_ % CHUNKS][size_] = record;
+		if (++size_ == CHUNK_RECORDS) {
+			submit();
+			const auto lock = std::scoped_lock{mutex_};
+			if (!error_.empty()) {
+				throw std::runtime_error(error_);
+			}
+		}
+	}
+
+	// Recorded so far, not necessarily written yet
+	[[nodiscard]] auto records() const -> uint64_t
+	{
+		return head_ * CHUNK_RECORDS + size_;
+	}
+
+private:
+	// Hands the current chunk to the writer and waits until the next one is free
+	auto submit() -> void
+	{
+		if (size_ == 0) {
+			return;
+		}
+		auto lock = std::unique_lock{mutex_};
+		sizes_[head_ % CHUNKS] = size_;
+		++head_;
+		size_ = 0;
+		wake_writer_.notify_one();
+		chunk_written_.wait(lock, [this] { return head_ - tail_ < CHUNKS; });
+	}
+
+	auto write_chunks() -> void
+	{
+		auto lock = std::unique_lock{mutex_};
+		while (true) {
+			wake_writer_.wait(lock, [this] { return tail_ != head_ || quit_; });
+			if (tail_ == head_) {
+				return;
+			}
+
+			// The producer doesn't touch submitted chunks. After a failed write the rest is dropped, the producer still
+			// gets its buffers back.
+			const auto index = tail_ % CHUNKS;
+			const auto failed = !error_.empty();
+			lock.unlock();
+			auto written = true;
+			auto error = 0;
+			if (!failed) {
+				written = std::fwrite(chunks_[index].data(), sizeof(InstructionRecord), sizes_[index], file_) == sizes_[index];
+				error = errno;
+			}
+			lock.lock();
+
+			if (!written) {
+				error_ = "Can't write instruction trace " + path_ + ": " + std::strerror(error);
+			}
+
+			++tail_;
+			chunk_written_.notify_one();
+		}
+	}
+
+	std::string path_ = {};
+	std::FILE* file_ = {};
+	std::array<std::vector<InstructionRecord>, CHUNKS> chunks_ = {};
+	std::array<size_t, CHUNKS> sizes_ = {};
+	// Records in the chunk being filled, owned by the producer
+	size_t size_ = {};
+
+	std::mutex mutex_ = {};
+	std::condition_variable wake_writer_ = {};
+	std::condition_variable chunk_written_ = {};
+	// Chunks submitted and written, both only grow
+	uint64_t head_ = {};
+	uint64_t tail_ = {};
+	bool quit_ = {};
+	// First failed write, set by the writer
+	std::string error_ = {};
+	std::thread writer_ = {};
+};
+
+class InstructionTraceReader {
+public:
+	static constexpr size_t BUFFER_RECORDS = 4096;
+
+	explicit InstructionTraceReader(const std::string& path) : file_{std::fopen(path.c_str(), "rb")}
+	{
+		if (file_ == nullptr) {
+			throw std::runtime_error("Can't open instruction trace " + path);
+		}
+		auto header = InstructionTraceHeader{};
+		const auto expected = InstructionTraceHeader{};
+		if (std::fread(&header, sizeof(header), 1, file_) != 1 || header.magic != expected.magic || header.version != expected.version
+		    || header.record_size != expected.record_size) {
+			std::fclose(file_);
+			throw std::runtime_error("Not an instruction trace: " + path);
+		}
+		buffer_.resize(BUFFER_RECORDS);
+	}
+
+	InstructionTraceReader(const InstructionTraceReader&) = delete;
+	auto operator=(const InstructionTraceReader&) -> InstructionTraceReader& = delete;
+
+	~InstructionTraceReader()
+	{
+		std::fclose(file_);
+	}
+
+	// False at the end of the trace
+	auto next(InstructionRecord& record) -> bool
+	{
+		if (position_ == size_) {
+			size_ = std::fread(buffer_.data(), sizeof(InstructionRecord), buffer_.size(), file_);
+			position_ = 0;
+			if (size_ == 0) {
+				return false;
+			}
+		}
+		record = buffer_[position_++];
+		return true;
+	}
+
+private:
+	std::FILE* file_ = {};
+	std::vector<InstructionRecord> buffer_ = {};
+	size_t position_ = {};
+	size_t size_ = {};
+};
+
+// `instructions` as from get_all_instructions()
+[[nodiscard]] inline auto instruction_record_mnemonic(const InstructionRecord& record, const std::vector<Instruction>& instructions)
+  -> const std::string&
+{
+	const auto index = record.bytes[0] == 0xcb ? 0x100 + record.bytes[1] : record.bytes[0];
+	return instructions[static_cast<size_t>(index)].mnemonic;
+}
+
+inline auto append_hex(std::string& out, const uint32_t& value, const int& digits) -> void
+{
+	constexpr auto HEX = std::string_view{"0123456789abcdef"};
+	for (auto shift = (digits - 1) * 4; shift >= 0; shift -= 4) { out += HEX[(value >> shift) & 0xf]; }
+}
+
+// One line of the binjgb log. The bank is printed as [00] like the logs we compare against, the record has the real one.
+inline auto append_binjgb_line(std::string& out, const InstructionRecord& record, const std::string& mnemonic) -> void
+{
+	const auto& r = record.registers;
+	out += "A:";
+	append_hex(out, r[0], 2);
+	out += " F:";
+	out += (r[1] & 0x80) != 0 ? 'Z' : '-';
+	out += (r[1] & 0x40) != 0 ? 'N' : '-';
+	out += (r[1] & 0x20) != 0 ? 'H' : '-';
+	out += (r[1] & 0x10) != 0 ? 'C' : '-';
+	out += " BC:";
+	append_hex(out, static_cast<uint32_t>(r[2] << 8 | r[3]), 4);
+	out += " DE:";
+	append_hex(out, static_cast<uint32_t>(r[4] << 8 | r[5]), 4);
+	out += " HL:";
+	append_hex(out, static_cast<uint32_t>(r[6] << 8 | r[7]), 4);
+	out += " SP:";
+	append_hex(out, record.SP, 4);
+	out += " PC:";
+	append_hex(out, record.PC, 4);
+	out += " (cy: ";
+	out += std::to_string(record.cycles * 4);
+	out += ") ppu:+";
+	out += static_cast<char>('0' + (record.ppu_mode & 0x3));
+	out += "|[00]0x";
+	append_hex(out, record.PC, 4);
+	out += ": ";
+	for (auto i = size_t{0}; i < record.size && i < record.bytes.size(); ++i) {
+		append_hex(out, record.bytes[i], 2);
+		out += ' ';
+	}
+	out += "\t\t";
+	out += mnemonic;
+	out += " \n";
+}
@@ -6,6 +6,7 @@ struct JoypadUpdate {
 	bool quit = {};
 	bool request_interupt = {};
 	uint8_t state = {};
+	bool toggle_turbo = {};
 };
 
 class Joypad {
@@ -15,11 +16,15 @@ public:
 	auto update(const uint8_t& joyp) -> JoypadUpdate
 	{
 		SDL_Event event;
+		auto toggle_turbo = false;
 
 		while (SDL_PollEvent(&event) != 0) {
 			if (event.type == SDL_QUIT) {
 				return {.quit = true};
 			}
+			if (event.type == SDL_KEYDOWN && event.key.keysym.scancode == SDL_SCANCODE_TAB && event.key.repeat == 0) {
+				toggle_turbo = !toggle_turbo;
+			}
 		}
 
 		auto request_interupt = false;
@@ -81,7 +86,7 @@ public:
 			released_key(7);
 		}
 
-		return {.quit = false, .request_interupt = request_interupt, .state = joypad_state_};
+		return {.quit = false, .request_interupt = request_interupt, .state = joypad_state_, .toggle_turbo = toggle_turbo};
 	}
 
 private:
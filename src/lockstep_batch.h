@@ -0,0 +1,509 @@
+#pragma once
+
+#include "cpu.h"
+
+#include <array>
+#include <bit>
+#include <memory>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define GRAYBOY_LOCKSTEP_AVX2 1
+#endif
+
+enum class LockstepOperation : uint8_t { unsupported, nop, load, add, adc, sub, sbc, op_and, op_xor, op_or, cp, inc, dec };
+
+// Register operands as indices into the Registers array
+struct LockstepDecoded {
+	LockstepOperation operation = LockstepOperation::unsupported;
+	uint8_t dst = {};
+	uint8_t src = {};
+};
+
+constexpr auto decode_lockstep_opcodes() -> std::array<LockstepDecoded, 256>
+{
+	// Opcode register encoding (B, C, D, E, H, L, (HL), A) to the Registers layout, (HL) goes through memory
+	constexpr auto registers = std::array<uint8_t, 8>{3, 2, 5, 4, 7, 6, 0xff, 1};
+	constexpr auto A = uint8_t{1};
+
+	auto decoded = std::array<LockstepDecoded, 256>{};
+	decoded[0x00] = {LockstepOperation::nop};
+
+	for (auto r = 0; r < 8; ++r) {
+		if (registers[r] == 0xff) {
+			continue;
+		}
+		decoded[0x04 | r << 3] = {LockstepOperation::inc, registers[r], registers[r]};
+		decoded[0x05 | r << 3] = {LockstepOperation::dec, registers[r], registers[r]};
+	}
+
+	for (auto opcode = 0x40; opcode <= 0xbf; ++opcode) {
+		const auto dst = registers[(opcode >> 3) & 0x7];
+		const auto src = registers[opcode & 0x7];
+		if (src == 0xff) {
+			continue;
+		}
+
+		if (opcode < 0x80) {
+			if (dst != 0xff) {
+				decoded[opcode] = {LockstepOperation::load, dst, src};
+			}
+			continue;
+		}
+
+		constexpr auto alu = std::array<LockstepOperation, 8>{LockstepOperation::add,
+		  LockstepOperation::adc,
+		  LockstepOperation::sub,
+		  LockstepOperation::sbc,
+		  LockstepOperation::op_and,
+		  LockstepOperation::op_xor,
+		  LockstepOperation::op_or,
+		  LockstepOperation::cp};
+		decoded[opcode] = {alu[(opcode >> 3) & 0x7], A, src};
+	}
+
+	return decoded;
+}
+
+// Experimental interpreter stepping 16 instances of one ROM at once, CPU only - no interupts, timer or PPU.
+// Registers are stored as structure of arrays, one row of 16 lanes for every byte of Registers. Every step lanes are
+// grouped by opcode, register-only loads and ALU operations run for the whole group at once (AVX2 if the CPU has it),
+// everything else runs lane by lane through Cpu::execute_opcode. A lane which left the rows for that keeps its
+// Registers until it joins a vectorized group again, so runs of scalar instructions don't convert every time.
+class LockstepBatch {
+public:
+	static constexpr size_t LANES = 16;
+	using LaneMask = uint16_t;
+
+	LockstepBatch(const Cartridge& cartridge, const Registers& regs)
+	{
+		for (auto lane = size_t{0}; lane < LANES; ++lane) {
+			memories_[lane] = Memory{Cartridge{cartridge}};
+			set_registers(lane, regs);
+		}
+
+		for (const auto& instruction : get_all_instructions()) {
+			sizes_[instruction_index(instruction.opcode)] = instruction.size;
+		}
+	}
+
+	// Executes one instruction on every lane which isn't halted
+	auto step() -> void
+	{
+		auto opcodes = std::array<uint16_t, LANES>{};
+		auto remaining = LaneMask{};
+
+		for (auto lane = size_t{0}; lane < LANES; ++lane) {
+			if (halt_[lane]) {
+				++cycles_[lane];
+				continue;
+			}
+
+			const auto PC = scalar_ & (1 << lane) ? scalar_regs_[lane].read("PC") : pc(lane);
+			const auto first_byte = memories_[lane].read(PC);
+			opcodes[lane] = first_byte == 0xcb ? static_cast<uint16_t>(0xcb00 | memories_[lane].read(PC + 1)) : first_byte;
+			remaining |= static_cast<LaneMask>(1 << lane);
+		}
+
+		while (remaining != 0) {
+			const auto opcode = opcodes[std::countr_zero(remaining)];
+
+			auto group = LaneMask{};
+			for (auto lane = size_t{0}; lane < LANES; ++lane) {
+				if ((remaining & (1 << lane)) && opcodes[lane] == opcode) {
+					group |= static_cast<LaneMask>(1 << lane);
+				}
+			}
+			remaining &= static_cast<LaneMask>(~group);
+
+			if (supports(opcode)) {
+				gather(group);
+				execute_vectorized(DECODED[opcode], group);
+				vectorized_instructions_ += std::popcount(group);
+			}
+			else {
+				for (auto lane = size_t{0}; lane < LANES; ++lane) {
+					if (group & (1 << lane)) {
+						execute_scalar(opcode, lane);
+					}
+				}
+				scalar_instructions_ += std::popcount(group);
+			}
+		}
+	}
+
+	// Opcodes executed for all lanes at once
+	[[nodiscard]] static auto supports(const uint16_t& opcode) -> bool
+	{
+		return opcode <= 0xff && DECODED[opcode].operation != LockstepOperation::unsupported;
+	}
+
+	[[nodiscard]] auto registers(const size_t& lane) const -> Registers
+	{
+		if (scalar_ & (1 << lane)) {
+			return scalar_regs_[lane];
+		}
+
+		auto array = Registers::ArrayType{};
+		for (auto i = size_t{0}; i < array.size(); ++i) { array[i] = regs_[i][lane]; }
+
+		auto regs = Registers{array};
+		regs.set_IME(ime_[lane]);
+		regs.set_halt(halt_[lane]);
+		return regs;
+	}
+
+	auto set_registers(const size_t& lane, const Registers& regs) -> void
+	{
+		const auto array = regs.dump();
+		for (auto i = size_t{0}; i < array.size(); ++i) { regs_[i][lane] = array[i]; }
+		ime_[lane] = regs.read_IME();
+		halt_[lane] = regs.read_halt();
+		scalar_ &= static_cast<LaneMask>(~(1 << lane));
+	}
+
+	[[nodiscard]] auto memory(const size_t& lane) -> Memory&
+	{
+		return memories_[lane];
+	}
+
+	[[nodiscard]] auto cycles(const size_t& lane) const -> uint64_t
+	{
+		return cycles_[lane];
+	}
+
+	// Vectorized groups use AVX2 only if the CPU supports it, disabling it leaves a plain loop over the lanes
+	auto set_avx2(const bool& enabled) -> void
+	{
+		avx2_ = enabled && cpu_has_avx2();
+	}
+
+	[[nodiscard]] auto avx2() const -> bool
+	{
+		return avx2_;
+	}
+
+	[[nodiscard]] auto vectorized_instructions() const -> uint64_t
+	{
+		return vectorized_instructions_;
+	}
+
+	[[nodiscard]] auto scalar_instructions() const -> uint64_t
+	{
+		return scalar_instructions_;
+	}
+
+private:
+	static constexpr auto DECODED = decode_lockstep_opcodes();
+
+	static constexpr size_t ROW_F = 0;
+	static constexpr size_t ROW_A = 1;
+	static constexpr size_t ROW_PC = 8;
+
+	[[nodiscard]] static auto instruction_index(const uint16_t& opcode) -> size_t
+	{
+		return opcode <= 0xff ? opcode : (opcode & 0xff) + 0x100;
+	}
+
+	[[nodiscard]] static auto cpu_has_avx2() -> bool
+	{
+#if defined(GRAYBOY_LOCKSTEP_AVX2)
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+
+	[[nodiscard]] auto pc(const size_t& lane) const -> uint16_t
+	{
+		return static_cast<uint16_t>(regs_[ROW_PC][lane] | regs_[ROW_PC + 1][lane] << 8);
+	}
+
+	auto set_pc(const size_t& lane, const uint16_t& value) -> void
+	{
+		regs_[ROW_PC][lane] = static_cast<uint8_t>(value);
+		regs_[ROW_PC + 1][lane] = static_cast<uint8_t>(value >> 8);
+	}
+
+	auto execute_scalar(const uint16_t& opcode, const size_t& lane) -> void
+	{
+		if (!(scalar_ & (1 << lane))) {
+			scalar_regs_[lane] = registers(lane);
+			scalar_ |= static_cast<LaneMask>(1 << lane);
+		}
+
+		auto& regs = scalar_regs_[lane];
+		const auto PC = regs.read("PC");
+
+		cycles_[lane] += Cpu::execute_opcode(opcode, PC, regs, memories_[lane]);
+		regs.write("PC", regs.read("PC") + sizes_[instruction_index(opcode)]);
+		halt_[lane] = regs.read_halt();
+	}
+
+	// Lanes of the group which ran scalar instructions go back into the rows
+	auto gather(const LaneMask& group) -> void
+	{
+		auto lanes = static_cast<LaneMask>(group & scalar_);
+		while (lanes != 0) {
+			const auto lane = static_cast<size_t>(std::countr_zero(lanes));
+			set_registers(lane, scalar_regs_[lane]);
+			lanes &= static_cast<LaneMask>(lanes - 1);
+		}
+	}
+
+	// All supported instructions are one byte long and take one cycle
+	auto execute_vectorized(const LockstepDecoded& decoded, const LaneMask& group) -> void
+	{
+		if (decoded.operation != LockstepOperation::nop) {
+#if defined(GRAYBOY_LOCKSTEP_AVX2)
+			if (avx2_) {
+				execute_avx2(decoded, group);
+			}
+			else
+#endif
+			{
+				execute_lanes(decoded, group);
+			}
+		}
+
+		for (auto lane = size_t{0}; lane < LANES; ++lane) {
+			if (group & (1 << lane)) {
+				set_pc(lane, pc(lane) + 1);
+				++cycles_[lane];
+			}
+		}
+	}
+
+	// Same flag rules as instruction_utils.h
+	auto execute_lanes(const LockstepDecoded& decoded, const LaneMask& group) -> void
+	{
+		for (auto lane = size_t{0}; lane < LANES; ++lane) {
+			if (!(group & (1 << lane))) {
+				continue;
+			}
+
+			const auto a = int{regs_[decoded.dst][lane]};
+			const auto b = int{regs_[decoded.src][lane]};
+			const auto f = int{regs_[ROW_F][lane]};
+			const auto carry_in = (f >> 4) & 1;
+
+			auto result = a;
+			auto flags = f;
+			const auto set_flags = [&](const int& value, const bool& n, const bool& h, const bool& c) {
+				flags = ((value & 0xff) == 0) << 7 | n << 6 | h << 5 | c << 4 | (f & 0xf);
+			};
+
+			switch (decoded.operation) {
+				case LockstepOperation::load:
+					result = b;
+					break;
+				case LockstepOperation::add:
+					result = a + b;
+					set_flags(result, false, ((a & 0xf) + (b & 0xf)) & 0x10, result & 0x100);
+					break;
+				case LockstepOperation::adc: {
+					const auto value = (b + carry_in) & 0xff;
+					result = a + value;
+					set_flags(result,
+					  false,
+					  (((b & 0xf) + carry_in) | ((a & 0xf) + (value & 0xf))) & 0x10,
+					  ((b + carry_in) | (a + value)) & 0x100);
+					break;
+				}
+				case LockstepOperation::sub:
+				case LockstepOperation::cp:
+					result = a - b;
+					set_flags(result, true, (a & 0xf) < (b & 0xf), a < b);
+					if (decoded.operation == LockstepOperation::cp) {
+						result = a;
+					}
+					break;
+				case LockstepOperation::sbc: {
+					const auto a_minus_carry = (a - carry_in) & 0xff;
+					result = a_minus_carry - b;
+					set_flags(result,
+					  true,
+					  (a & 0xf) < carry_in || (a_minus_carry & 0xf) < (b & 0xf),
+					  a < carry_in || a_minus_carry < b);
+					break;
+				}
+				case LockstepOperation::op_and:
+					result = a & b;
+					set_flags(result, false, true, false);
+					break;
+				case LockstepOperation::op_xor:
+					result = a ^ b;
+					set_flags(result, false, false, false);
+					break;
+				case LockstepOperation::op_or:
+					result = a | b;
+					set_flags(result, false, false, false);
+					break;
+				case LockstepOperation::inc:
+					result = a + 1;
+					set_flags(result, false, (a & 0xf) == 0xf, carry_in);
+					break;
+				case LockstepOperation::dec:
+					result = a - 1;
+					set_flags(result, true, (a & 0xf) == 0, carry_in);
+					break;
+				case LockstepOperation::nop:
+				case LockstepOperation::unsupported:
+					break;
+			}
+
+			regs_[decoded.dst][lane] = static_cast<uint8_t>(result);
+			regs_[ROW_F][lane] = static_cast<uint8_t>(flags);
+		}
+	}
+
+#if defined(GRAYBOY_LOCKSTEP_AVX2)
+	// Lanes are widened to 16 bits, carries out of bit 3 and bit 7 are then plain bits of the result
+	__attribute__((target("avx2"))) auto load(const size_t& row) const -> __m256i
+	{
+		return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(regs_[row].data())));
+	}
+
+	__attribute__((target("avx2"))) auto store(const size_t& row, const __m256i& value) -> void
+	{
+		const auto bytes = bit(value, 0xff);
+		const auto packed = _mm_packus_epi16(_mm256_castsi256_si128(bytes), _mm256_extracti128_si256(bytes, 1));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(regs_[row].data()), packed);
+	}
+
+	__attribute__((target("avx2"))) static auto constant(const int& value) -> __m256i
+	{
+		return _mm256_set1_epi16(static_cast<int16_t>(value));
+	}
+
+	__attribute__((target("avx2"))) static auto bit(const __m256i& value, const int& mask) -> __m256i
+	{
+		return _mm256_and_si256(value, constant(mask));
+	}
+
+	__attribute__((target("avx2"))) static auto low_nibble(const __m256i& value) -> __m256i
+	{
+		return bit(value, 0xf);
+	}
+
+	// 0x10 where the value went negative
+	__attribute__((target("avx2"))) static auto borrow(const __m256i& value) -> __m256i
+	{
+		return _mm256_slli_epi16(_mm256_srli_epi16(value, 15), 4);
+	}
+
+	__attribute__((target("avx2"))) static auto zero(const __m256i& value) -> __m256i
+	{
+		return bit(_mm256_cmpeq_epi16(bit(value, 0xff), _mm256_setzero_si256()), 0x80);
+	}
+
+	__attribute__((target("avx2"))) auto execute_avx2(const LockstepDecoded& decoded, const LaneMask& group) -> void
+	{
+		const auto a = load(decoded.dst);
+		const auto b = load(decoded.src);
+		const auto f = load(ROW_F);
+		const auto carry_in = _mm256_srli_epi16(bit(f, 0x10), 4);
+
+		auto result = a;
+		// Z, N, H and C in their F positions
+		auto z = _mm256_setzero_si256();
+		auto n = _mm256_setzero_si256();
+		auto h = _mm256_setzero_si256();
+		auto c = _mm256_setzero_si256();
+
+		switch (decoded.operation) {
+			case LockstepOperation::load:
+				result = b;
+				break;
+			case LockstepOperation::add:
+				result = _mm256_add_epi16(a, b);
+				h = _mm256_slli_epi16(bit(_mm256_add_epi16(low_nibble(a), low_nibble(b)), 0x10), 1);
+				c = _mm256_srli_epi16(bit(result, 0x100), 4);
+				break;
+			case LockstepOperation::adc: {
+				const auto b_with_carry = _mm256_add_epi16(b, carry_in);
+				const auto value = bit(b_with_carry, 0xff);
+				result = _mm256_add_epi16(a, value);
+				h = _mm256_or_si256(_mm256_add_epi16(low_nibble(b), carry_in), _mm256_add_epi16(low_nibble(a), low_nibble(value)));
+				h = _mm256_slli_epi16(bit(h, 0x10), 1);
+				c = _mm256_srli_epi16(bit(_mm256_or_si256(b_with_carry, result), 0x100), 4);
+				break;
+			}
+			case LockstepOperation::sub:
+			case LockstepOperation::cp:
+				result = _mm256_sub_epi16(a, b);
+				n = constant(0x40);
+				h = _mm256_slli_epi16(borrow(_mm256_sub_epi16(low_nibble(a), low_nibble(b))), 1);
+				c = borrow(result);
+				break;
+			case LockstepOperation::sbc: {
+				const auto a_minus_carry_wide = _mm256_sub_epi16(a, carry_in);
+				const auto a_minus_carry = bit(a_minus_carry_wide, 0xff);
+				result = _mm256_sub_epi16(a_minus_carry, b);
+				n = constant(0x40);
+				h = _mm256_or_si256(_mm256_sub_epi16(low_nibble(a), carry_in), _mm256_sub_epi16(low_nibble(a_minus_carry), low_nibble(b)));
+				h = _mm256_slli_epi16(borrow(h), 1);
+				c = _mm256_or_si256(borrow(a_minus_carry_wide), borrow(result));
+				break;
+			}
+			case LockstepOperation::op_and:
+				result = _mm256_and_si256(a, b);
+				h = constant(0x20);
+				break;
+			case LockstepOperation::op_xor:
+				result = _mm256_xor_si256(a, b);
+				break;
+			case LockstepOperation::op_or:
+				result = _mm256_or_si256(a, b);
+				break;
+			case LockstepOperation::inc:
+				result = _mm256_add_epi16(a, constant(1));
+				h = bit(_mm256_cmpeq_epi16(low_nibble(a), constant(0xf)), 0x20);
+				c = bit(f, 0x10);
+				break;
+			case LockstepOperation::dec:
+				result = _mm256_sub_epi16(a, constant(1));
+				n = constant(0x40);
+				h = bit(_mm256_cmpeq_epi16(low_nibble(a), _mm256_setzero_si256()), 0x20);
+				c = bit(f, 0x10);
+				break;
+			case LockstepOperation::nop:
+			case LockstepOperation::unsupported:
+				return;
+		}
+
+		// Lanes outside of the group keep their values
+		const auto lane_bits = _mm256_setr_epi16(
+		  0x1, 0x2, 0x4, 0x8, 0x10, 0x20, 0x40, 0x80, 0x100, 0x200, 0x400, 0x800, 0x1000, 0x2000, 0x4000, static_cast<int16_t>(0x8000));
+		const auto in_group = _mm256_cmpeq_epi16(_mm256_and_si256(constant(group), lane_bits), lane_bits);
+
+		if (decoded.operation != LockstepOperation::load) {
+			z = zero(result);
+			const auto flags = _mm256_or_si256(_mm256_or_si256(z, n), _mm256_or_si256(_mm256_or_si256(h, c), low_nibble(f)));
+			store(ROW_F, _mm256_blendv_epi8(f, flags, in_group));
+		}
+		if (decoded.operation != LockstepOperation::cp) {
+			store(decoded.dst, _mm256_blendv_epi8(a, result, in_group));
+		}
+	}
+#endif
+
+	alignas(32) std::array<std::array<uint8_t, LANES>, Registers::ArrayElementCount> regs_ = {};
+	std::array<bool, LANES> ime_ = {};
+	std::array<bool, LANES> halt_ = {};
+	std::array<uint64_t, LANES> cycles_ = {};
+
+	// Lanes whose registers are in scalar_regs_ instead of the rows
+	LaneMask scalar_ = {};
+	std::array<Registers, LANES> scalar_regs_ = {};
+
+	// 64 kB each
+	std::unique_ptr<std::array<Memory, LANES>> memories_storage_ = std::make_unique<std::array<Memory, LANES>>();
+	std::array<Memory, LANES>& memories_ = *memories_storage_;
+
+	std::array<uint8_t, 512> sizes_ = {};
+	bool avx2_ = cpu_has_avx2();
+
+	uint64_t vectorized_instructions_ = {};
+	uint64_t scalar_instructions_ = {};
+};
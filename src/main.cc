@@ -1,20 +1,114 @@
+#include "cli_options.h"
 #include "display.h"
 #include "emulator.h"
 
+#include <algorithm>
 #include <array>
 #include <iostream>
+#include <optional>
+#include <string>
 #include <thread>
 #include <vector>
 
 auto main(int argc, const char** argv) -> int
 {
-	if (argc != 2) {
-		std::cout << "Usage: " << argv[0] << " cartridge_filename\n";
+	auto args = std::vector<std::string>(argv + 1, argv + argc);
+	const auto deferred_rendering = std::erase(args, "--deferred-rendering") > 0;
+	const auto turbo = std::erase(args, "--turbo") > 0;
+	const auto turbo_speed = take_option(args, "--turbo-speed");
+	const auto sync_to_display = std::erase(args, "--sync-to-display") > 0;
+	const auto run_ahead = take_option(args, "--run-ahead");
+	const auto profile = take_option(args, "--profile");
+	const auto symbols = take_option(args, "--symbols");
+	const auto metrics_path = take_option(args, "--metrics");
+	const auto print_fps = std::erase(args, "--print-fps") > 0;
+	const auto trace_path = take_option(args, "--trace-instructions");
+
+	const auto usage = [&] {
+		std::cout << "Usage: " << argv[0] << " [--deferred-rendering] [--turbo] [--turbo-speed multiplier] [--sync-to-display]"
+		          << " [--run-ahead frames] [--profile stacks.folded [--symbols game.sym]] [--metrics metrics.json] [--print-fps]"
+		          << " [--trace-instructions trace.bin] cartridge_filename\n";
 		return 1;
+	};
+
+	// Symbols only name the profile's functions
+	if (symbols && !profile) {
+		std::cout << "--symbols needs --profile\n";
+	}
+	if (args.size() != 1 || (symbols && !profile)) {
+		return usage();
+	}
+
+	auto turbo_settings = TurboSettings{};
+	auto run_ahead_frames = uint32_t{0};
+	try {
+		turbo_settings.speed = turbo_speed ? parse_real("--turbo-speed", *turbo_speed, 0) : turbo_settings.speed;
+		if (run_ahead) {
+			run_ahead_frames =
+			  static_cast<uint32_t>(parse_number("--run-ahead", *run_ahead, 1, Emulator<false>::MAX_RUN_AHEAD_FRAMES));
+		}
+	}
+	catch (const std::invalid_argument& e) {
+		std::cout << e.what() << '\n';
+		return usage();
 	}
 
-	auto emu = Emulator<false>{argv[1]};
-	emu.run();
+	// Cartridge, symbols, trace and profile files can all fail
+	try {
+		auto emu = Emulator<false>{args[0]};
+		emu.set_serial_echo(true);
+		emu.set_deferred_rendering(deferred_rendering);
+
+		emu.set_turbo_settings(turbo_settings);
+		emu.set_turbo(turbo);
+		emu.set_sync_to_display_refresh(sync_to_display);
+		emu.set_run_ahead(run_ahead_frames);
+
+		auto profiler = GuestProfiler{};
+		if (profile) {
+			if (symbols) {
+				profiler.load_symbols(*symbols);
+			}
+			emu.set_guest_profiler(&profiler);
+		}
 
-	return 0;
+		auto metrics = FrameMetrics{};
+		auto reporter = std::optional<FrameMetricsReporter>{};
+		if (metrics_path || print_fps) {
+			emu.set_frame_metrics(&metrics);
+			reporter.emplace(metrics, std::chrono::seconds{1}, metrics_path.value_or(""), print_fps);
+		}
+
+		auto trace = std::optional<InstructionTraceWriter>{};
+		if (trace_path) {
+			trace.emplace(*trace_path);
+			emu.set_instruction_trace(&*trace);
+		}
+
+		emu.run();
+		emu.set_frame_metrics(nullptr);
+		reporter.reset();
+		emu.set_instruction_trace(nullptr);
+		if (trace) {
+			trace->finish();
+		}
+
+		if (print_fps) {
+			const auto stats = emu.frame_time_stats();
+			std::cout << "Frame time: " << stats.mean_ms << " ms mean, " << stats.jitter_ms << " ms jitter, " << stats.max_error_ms
+			          << " ms max error (" << stats.frames << " frames)\n";
+		}
+
+		if (profile) {
+			emu.set_guest_profiler(nullptr);
+			profiler.write_collapsed(*profile);
+			std::cout << profiler.report();
+		}
+
+		return 0;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
 }
@@ -1,8 +1,11 @@
 #pragma once
 
 #include "cartridge.h"
+#include "trace.h"
 
 #include <array>
+#include <utility>
+#include <vector>
 
 template<typename T>
 auto raw_dump(const T& container, const std::string& filename)
@@ -11,12 +14,38 @@ auto raw_dump(const T& container, const std::string& filename)
 	file.write(reinterpret_cast<const char*>(container.data()), container.size() * sizeof(typename T::value_type));
 }
 
+// Implemented by whoever updates the PPU lazily, it's called before CPU touches memory the PPU owns
+// or reads interupt flags the PPU might have changed in the meantime
+class PpuSync {
+public:
+	virtual auto sync_ppu(const uint16_t& address) -> void = 0;
+
+protected:
+	PpuSync() = default;
+	PpuSync(const PpuSync&) = default;
+	PpuSync(PpuSync&&) = default;
+	auto operator=(const PpuSync&) -> PpuSync& = default;
+	auto operator=(PpuSync&&) -> PpuSync& = default;
+	~PpuSync() = default;
+};
+
 class Memory {
 public:
 	static const size_t ArrayElements = 1 << 16;
+	// VRAM and OAM changes are tracked in blocks of this size, OAM blocks follow the VRAM ones
+	static constexpr size_t VIDEO_MEMORY_BLOCK_SIZE = 64;
+	static constexpr size_t VIDEO_MEMORY_BLOCKS = (0x2000 + 0xa0 + VIDEO_MEMORY_BLOCK_SIZE - 1) / VIDEO_MEMORY_BLOCK_SIZE;
 	using ArrayType = std::array<uint8_t, ArrayElements>;
 	using AddressType = uint16_t;
 
+	struct State {
+		ArrayType array = {};
+		Cartridge::State cartridge = {};
+		uint8_t joypad_state = {};
+
+		auto operator==(const State&) const -> bool = default;
+	};
+
 	Memory() = default;
 
 	Memory(Cartridge&& cartridge)
@@ -44,7 +73,17 @@ public:
 		return array_[address];
 	}
 
-	[[nodiscard]] auto read(const uint16_t address) const -> uint8_t
+	// What the CPU reads, a lazily updated PPU is caught up first if it owns the address
+	[[nodiscard]] auto read(const uint16_t address) -> uint8_t
+	{
+		if (ppu_sync_ != nullptr && is_ppu_visible(address)) {
+			ppu_sync_->sync_ppu(address);
+		}
+		return peek(address);
+	}
+
+	// Same as read() without catching up the PPU, LCD registers and interupt flags may be behind
+	[[nodiscard]] auto peek(const uint16_t address) const -> uint8_t
 	{
 		if (address <= 0x7fff) {
 			return cartridge_.read(address);
@@ -68,6 +107,14 @@ public:
 
 	void write(const uint16_t address, const uint8_t value)
 	{
+		if (!watched_.empty() && watched_[address]) {
+			watched_written_ = true;
+		}
+
+		if (ppu_sync_ != nullptr && is_ppu_visible(address)) {
+			ppu_sync_->sync_ppu(address);
+		}
+
 		// ROM
 		if (address <= 0x7fff || (address >= 0xa000 && address <= 0xbfff)) {
 			// std::cout << "INFO: attempt to write to 0x" << std::hex << (int)address << " value 0x" << (int)value << std::dec << '\n';
@@ -78,15 +125,27 @@ public:
 		// array_[address] = 0;
 		// }
 
+		// VRAM or OAM
+		if ((address >= 0x8000 && address <= 0x9fff) || (address >= 0xfe00 && address <= 0xfe9f)) {
+			video_memory_block_versions_[video_memory_block(address)] = ++video_memory_version_;
+		}
+
 		// DMA
 		if (address == 0xff46) {
+			GRAYBOY_TRACE_SCOPE("dma");
 			const auto source = value << 8;
 			for (auto i = 0; i < 0xa0; ++i) { array_[0xfe00 + i] = array_[source + i]; }
+			++video_memory_version_;
+			for (auto i = 0; i < 0xa0; i += VIDEO_MEMORY_BLOCK_SIZE) { video_memory_block_versions_[video_memory_block(0xfe00 + i)] = video_memory_version_; }
 		}
 		// Write to DIV resets it
 		else if (address == 0xff04) {
 			array_[address] = 0x00;
 		}
+		// LCD mode and LY == LYC bits of STAT are read only
+		else if (address == 0xff41) {
+			array_[address] = (value & ~0x7) | (array_[address] & 0x7);
+		}
 
 		// This part of memory is not usable
 		else if (address >= 0xfea0 && address <= 0xfeff) {
@@ -102,11 +161,99 @@ public:
 		return array_;
 	}
 
+	// Raw view of the whole address space, cartridge ROM and RAM are not part of it
+	[[nodiscard]] auto data() const -> const uint8_t*
+	{
+		return array_.data();
+	}
+
+	[[nodiscard]] auto cartridge() const -> const Cartridge&
+	{
+		return cartridge_;
+	}
+
+	// Changes every time CPU writes into VRAM or OAM
+	[[nodiscard]] auto video_memory_version() const -> uint64_t
+	{
+		return video_memory_version_;
+	}
+
+	// video_memory_version() of the last write into the block
+	[[nodiscard]] auto video_memory_block_version(const size_t& block) const -> uint64_t
+	{
+		return video_memory_block_versions_[block];
+	}
+
+	[[nodiscard]] static auto video_memory_block(const uint16_t address) -> size_t
+	{
+		if (address >= 0xfe00) {
+			return (0x2000 + address - 0xfe00) / VIDEO_MEMORY_BLOCK_SIZE;
+		}
+		return (address - 0x8000) / VIDEO_MEMORY_BLOCK_SIZE;
+	}
+
+	// First address of the block, the last OAM block is only partly OAM
+	[[nodiscard]] static auto video_memory_block_address(const size_t& block) -> uint16_t
+	{
+		const auto offset = block * VIDEO_MEMORY_BLOCK_SIZE;
+		return static_cast<uint16_t>(offset < 0x2000 ? 0x8000 + offset : 0xfe00 + offset - 0x2000);
+	}
+
+	auto save_state(State& state) const -> void
+	{
+		state.array = array_;
+		cartridge_.save_state(state.cartridge);
+		state.joypad_state = joypad_state_;
+	}
+
+	auto load_state(const State& state) -> void
+	{
+		array_ = state.array;
+		cartridge_.load_state(state.cartridge);
+		joypad_state_ = state.joypad_state;
+		// Whatever was recorded for the current video memory is no longer valid
+		video_memory_block_versions_.fill(++video_memory_version_);
+	}
+
 	auto update_joypad(const uint8_t& new_state) -> void
 	{
 		joypad_state_ = new_state;
 	}
 
+	[[nodiscard]] auto joypad_state() const -> uint8_t
+	{
+		return joypad_state_;
+	}
+
+	// CPU writes into any of these set a flag, no addresses turn it off
+	auto watch(const std::vector<uint16_t>& addresses) -> void
+	{
+		watched_.clear();
+		watched_written_ = false;
+		if (!addresses.empty()) {
+			watched_.resize(ArrayElements);
+			for (const auto& address : addresses) { watched_[address] = true; }
+		}
+	}
+
+	// Whether a watched address was written since the last call
+	auto take_watched_write() -> bool
+	{
+		return std::exchange(watched_written_, false);
+	}
+
+	auto set_ppu_sync(PpuSync* ppu_sync) -> void
+	{
+		ppu_sync_ = ppu_sync;
+	}
+
+	// VRAM, OAM, LCD registers and interupt flags
+	[[nodiscard]] static auto is_ppu_visible(const uint16_t address) -> bool
+	{
+		return (address >= 0x8000 && address <= 0x9fff) || (address >= 0xfe00 && address <= 0xfe9f) || address == 0xff0f
+		  || (address >= 0xff40 && address <= 0xff4b);
+	}
+
 private:
 	[[nodiscard]] auto get_direction_keys() const -> uint8_t
 	{
@@ -120,4 +267,9 @@ private:
 	ArrayType array_ = {};
 	Cartridge cartridge_ = {};
 	uint8_t joypad_state_ = {};
+	uint64_t video_memory_version_ = {};
+	std::array<uint64_t, VIDEO_MEMORY_BLOCKS> video_memory_block_versions_ = {};
+	PpuSync* ppu_sync_ = {};
+	std::vector<uint8_t> watched_ = {};
+	bool watched_written_ = {};
 };
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "batch_runner.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Shades are 0 (lightest) - 3 (darkest), as in the framebuffer
+enum class ObservationFormat {
+	// Shade per byte
+	index,
+	// 255, 170, 85, 0 for shades 0-3
+	grayscale,
+	// 4 pixels per byte, the first one in the lowest bits, every row starts with a new byte
+	packed_2bpp,
+};
+
+struct ObservationSpec {
+	ObservationFormat format = ObservationFormat::index;
+	// Part of the 160x144 frame, in frame pixels
+	int crop_x = 0;
+	int crop_y = 0;
+	int crop_width = 160;
+	int crop_height = 144;
+	// Every 2x2 block of the crop becomes one pixel, crop width and height have to be even
+	bool downsample = false;
+	// Observation holds the last `frame_stack` frames, the oldest first
+	uint32_t frame_stack = 1;
+};
+
+// 2x2 blocks of two rows into `out_width` shades. avg(avg(top), avg(bottom)) of pairs, each rounded up the same way
+// as the SIMD average instructions do.
+inline auto downsample_rows(const uint8_t* top, const uint8_t* bottom, const int& out_width, uint8_t* out) -> void
+{
+	auto x = 0;
+
+#if defined(__SSE2__)
+	const auto low_bytes = _mm_set1_epi16(0x00ff);
+	for (; x + 16 <= out_width; x += 16) {
+		const auto left = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + 2 * x)),
+		  _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + 2 * x)));
+		const auto right = _mm_avg_epu8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + 2 * x + 16)),
+		  _mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + 2 * x + 16)));
+
+		// Even and odd pixels are the low and high bytes of 16 bit lanes
+		const auto left_pairs = _mm_avg_epu16(_mm_and_si128(left, low_bytes), _mm_srli_epi16(left, 8));
+		const auto right_pairs = _mm_avg_epu16(_mm_and_si128(right, low_bytes), _mm_srli_epi16(right, 8));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(left_pairs, right_pairs));
+	}
+#endif
+
+	for (; x < out_width; ++x) {
+		const auto left = (top[2 * x] + bottom[2 * x] + 1) >> 1;
+		const auto right = (top[2 * x + 1] + bottom[2 * x + 1] + 1) >> 1;
+		out[x] = static_cast<uint8_t>((left + right + 1) >> 1);
+	}
+}
+
+inline auto shades_to_grayscale(const uint8_t* shades, const int& count, uint8_t* out) -> void
+{
+	auto i = 0;
+
+#if defined(__SSE2__)
+	// 255 - shade * 85, shades are small enough for the shifts to stay within bytes
+	const auto white = _mm_set1_epi8(static_cast<char>(0xff));
+	for (; i + 16 <= count; i += 16) {
+		const auto shade = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shades + i));
+		const auto times_5 = _mm_add_epi8(shade, _mm_slli_epi16(shade, 2));
+		const auto times_85 = _mm_add_epi8(times_5, _mm_slli_epi16(times_5, 4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_sub_epi8(white, times_85));
+	}
+#endif
+
+	for (; i < count; ++i) { out[i] = static_cast<uint8_t>(255 - shades[i] * 85); }
+}
+
+inline auto pack_2bpp(const uint8_t* shades, const int& count, uint8_t* out) -> void
+{
+	auto i = 0;
+
+#if defined(__SSE2__)
+	const auto low_bytes = _mm_set1_epi16(0x00ff);
+	for (; i + 16 <= count; i += 16) {
+		const auto shade = _mm_loadu_si128(reinterpret_cast<const __m128i*>(shades + i));
+		// Pairs of pixels into nibbles, then pairs of nibbles into bytes
+		const auto nibbles = _mm_or_si128(_mm_and_si128(shade, low_bytes), _mm_srli_epi16(shade, 6));
+		const auto packed_nibbles = _mm_packus_epi16(nibbles, nibbles);
+		const auto bytes = _mm_or_si128(_mm_and_si128(packed_nibbles, low_bytes), _mm_srli_epi16(packed_nibbles, 4));
+		const auto packed = _mm_cvtsi128_si32(_mm_packus_epi16(bytes, bytes));
+		std::memcpy(out + i / 4, &packed, 4);
+	}
+#endif
+
+	for (; i < count; i += 4) {
+		auto byte = 0;
+		for (auto j = 0; j < 4 && i + j < count; ++j) { byte |= shades[i + j] << (2 * j); }
+		out[i / 4] = static_cast<uint8_t>(byte);
+	}
+}
+
+// Converts framebuffers of a batch into observations in one contiguous buffer: instance after instance, frame after
+// frame within an instance. Frames kept for stacking are allocated up front, writing doesn't allocate.
+class ObservationWriter {
+public:
+	static constexpr int WIDTH = 160;
+	static constexpr int HEIGHT = 144;
+
+	ObservationWriter(const ObservationSpec& spec, const size_t& instances) : spec_{spec}
+	{
+		if (spec_.crop_x < 0 || spec_.crop_y < 0 || spec_.crop_width <= 0 || spec_.crop_height <= 0
+		    || spec_.crop_x + spec_.crop_width > WIDTH || spec_.crop_y + spec_.crop_height > HEIGHT) {
+			throw std::invalid_argument("Crop has to be within the frame");
+		}
+		if (spec_.downsample && (spec_.crop_width % 2 != 0 || spec_.crop_height % 2 != 0)) {
+			throw std::invalid_argument("Downsampled crop has to have even width and height");
+		}
+		if (spec_.frame_stack == 0) {
+			throw std::invalid_argument("At least one frame has to be stacked");
+		}
+
+		width_ = spec_.downsample ? spec_.crop_width / 2 : spec_.crop_width;
+		height_ = spec_.downsample ? spec_.crop_height / 2 : spec_.crop_height;
+		row_size_ = spec_.format == ObservationFormat::packed_2bpp ? static_cast<size_t>((width_ + 3) / 4) : static_cast<size_t>(width_);
+
+		history_.resize(instances * (spec_.frame_stack - 1) * frame_size());
+		history_head_.resize(instances);
+		history_filled_.resize(instances);
+	}
+
+	// Bytes of one frame, the observation of an instance is `frame_stack` of them
+	[[nodiscard]] auto frame_size() const -> size_t
+	{
+		return row_size_ * static_cast<size_t>(height_);
+	}
+
+	[[nodiscard]] auto observation_size() const -> size_t
+	{
+		return frame_size() * spec_.frame_stack;
+	}
+
+	[[nodiscard]] auto width() const -> int
+	{
+		return width_;
+	}
+
+	[[nodiscard]] auto height() const -> int
+	{
+		return height_;
+	}
+
+	// Writes all instances into `out`, batch.size() * observation_size() bytes. Needs headless rendering enabled.
+	auto write(BatchRunner& batch, uint8_t* out) -> void
+	{
+		batch.run([&](const size_t& index, Emulator<true>& emulator) {
+			write(index, emulator.framebuffer().data(), out + index * observation_size());
+		});
+	}
+
+	// Observation of one instance from its 160x144 framebuffer
+	auto write(const size_t& instance, const uint8_t* framebuffer, uint8_t* out) -> void
+	{
+		auto* newest = out + (spec_.frame_stack - 1) * frame_size();
+		convert(framebuffer, newest);
+
+		if (spec_.frame_stack == 1) {
+			return;
+		}
+
+		const auto kept = spec_.frame_stack - 1;
+		auto* history = history_.data() + instance * kept * frame_size();
+		auto& head = history_head_[instance];
+
+		// Nothing older yet, the first frame stands in for them
+		if (!history_filled_[instance]) {
+			for (auto frame = uint32_t{0}; frame < kept; ++frame) { std::memcpy(history + frame * frame_size(), newest, frame_size()); }
+			history_filled_[instance] = true;
+		}
+
+		// History is a ring, `head` is the oldest frame
+		for (auto frame = uint32_t{0}; frame < kept; ++frame) {
+			std::memcpy(out + frame * frame_size(), history + (head + frame) % kept * frame_size(), frame_size());
+		}
+		std::memcpy(history + head * frame_size(), newest, frame_size());
+		head = (head + 1) % kept;
+	}
+
+	// Forgets stacked frames of an instance, e.g. at the start of an episode
+	auto reset(const size_t& instance) -> void
+	{
+		history_filled_[instance] = false;
+		history_head_[instance] = 0;
+	}
+
+private:
+	auto convert(const uint8_t* framebuffer, uint8_t* out) const -> void
+	{
+		auto row = std::array<uint8_t, WIDTH>{};
+
+		for (auto y = 0; y < height_; ++y) {
+			const auto* shades = framebuffer + spec_.crop_x;
+			if (spec_.downsample) {
+				const auto* top = shades + (spec_.crop_y + 2 * y) * WIDTH;
+				downsample_rows(top, top + WIDTH, width_, row.data());
+				shades = row.data();
+			}
+			else {
+				shades += (spec_.crop_y + y) * WIDTH;
+			}
+
+			auto* target = out + static_cast<size_t>(y) * row_size_;
+			switch (spec_.format) {
+				case ObservationFormat::index:
+					std::memcpy(target, shades, static_cast<size_t>(width_));
+					break;
+				case ObservationFormat::grayscale:
+					shades_to_grayscale(shades, width_, target);
+					break;
+				case ObservationFormat::packed_2bpp:
+					pack_2bpp(shades, width_, target);
+					break;
+			}
+		}
+	}
+
+	ObservationSpec spec_ = {};
+	int width_ = {};
+	int height_ = {};
+	size_t row_size_ = {};
+
+	std::vector<uint8_t> history_ = {};
+	std::vector<uint32_t> history_head_ = {};
+	// Not vector<bool>, instances are written from more threads
+	std::vector<uint8_t> history_filled_ = {};
+};
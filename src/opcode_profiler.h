@@ -0,0 +1,253 @@
+#pragma once
+
+#include "instructions.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Executions and machine cycles of every opcode, CB-prefixed ones included. Cpu::execute_next() records into it only
+// when built with PROFILE_OPCODES (GRAYBOY_PROFILE_OPCODES), otherwise nothing is compiled in. With
+// PROFILE_OPCODES_HOST_TIME every HOST_TIME_PERIOD-th instruction is also timed on the host with rdtsc.
+class OpcodeProfiler {
+public:
+	static constexpr size_t OPCODES = 512;
+	static constexpr uint64_t HOST_TIME_PERIOD = 16;
+
+	struct Entry {
+		uint64_t count = {};
+		uint64_t cycles = {};
+		// Timed executions and their host ticks
+		uint64_t host_samples = {};
+		uint64_t host_ticks = {};
+	};
+
+	// Same order as get_all_instructions(), CB-prefixed opcodes from 0x100
+	[[nodiscard]] static auto index(const uint16_t& opcode) -> size_t
+	{
+		return opcode <= 0xff ? opcode : (opcode & 0xff) + 0x100;
+	}
+
+	[[nodiscard]] static auto now() -> uint64_t
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+	}
+
+	// Host time when the next instruction starts if it's sampled, 0 otherwise
+	[[nodiscard]] auto start() -> uint64_t
+	{
+#if defined(GRAYBOY_PROFILE_OPCODES_HOST_TIME)
+		if (++until_sample_ == HOST_TIME_PERIOD) {
+			until_sample_ = 0;
+			return now();
+		}
+#endif
+		return 0;
+	}
+
+	auto record(const uint16_t& opcode, const uint64_t& cycles, const uint64_t& started = 0) -> void
+	{
+		auto& entry = entries_[index(opcode)];
+		++entry.count;
+		entry.cycles += cycles;
+		if (started != 0) {
+			++entry.host_samples;
+			entry.host_ticks += now() - started;
+		}
+	}
+
+	auto merge(const OpcodeProfiler& other) -> void
+	{
+		for (auto i = size_t{0}; i < OPCODES; ++i) {
+			entries_[i].count += other.entries_[i].count;
+			entries_[i].cycles += other.entries_[i].cycles;
+			entries_[i].host_samples += other.entries_[i].host_samples;
+			entries_[i].host_ticks += other.entries_[i].host_ticks;
+		}
+	}
+
+	auto reset() -> void
+	{
+		entries_ = {};
+	}
+
+	[[nodiscard]] auto entries() const -> const std::array<Entry, OPCODES>&
+	{
+		return entries_;
+	}
+
+	[[nodiscard]] auto entry(const uint16_t& opcode) const -> const Entry&
+	{
+		return entries_[index(opcode)];
+	}
+
+	// Indices of executed opcodes, most cycles first
+	[[nodiscard]] auto sorted() const -> std::vector<size_t>
+	{
+		auto indices = std::vector<size_t>{};
+		for (auto i = size_t{0}; i < OPCODES; ++i) {
+			if (entries_[i].count > 0) {
+				indices.push_back(i);
+			}
+		}
+		std::stable_sort(begin(indices), end(indices), [&](const auto& a, const auto& b) {
+			return entries_[a].cycles > entries_[b].cycles;
+		});
+		return indices;
+	}
+
+	[[nodiscard]] auto report() const -> std::string
+	{
+		const auto [count, cycles] = totals();
+		const auto timed = host_timed();
+		const auto names = get_all_instructions();
+
+		auto out = std::ostringstream{};
+		out << std::fixed << std::setprecision(2);
+		out << "opcode  mnemonic           executions       %        cycles       %";
+		if (timed) {
+			out << "  ticks/exec";
+		}
+		out << '\n';
+
+		for (const auto& i : sorted()) {
+			const auto& entry = entries_[i];
+			out << std::left << std::setw(8) << opcode_name(i) << std::setw(17) << mnemonic(names, i) << std::right;
+			out << std::setw(12) << entry.count << std::setw(8) << 100.0 * static_cast<double>(entry.count) / static_cast<double>(count);
+			out << std::setw(14) << entry.cycles << std::setw(8) << 100.0 * static_cast<double>(entry.cycles) / static_cast<double>(cycles);
+			if (timed) {
+				out << std::setw(12) << ticks_per_execution(entry);
+			}
+			out << '\n';
+		}
+		out << "total " << count << " executions, " << cycles << " cycles\n";
+		return out.str();
+	}
+
+	[[nodiscard]] auto json() const -> std::string
+	{
+		const auto [count, cycles] = totals();
+		const auto names = get_all_instructions();
+
+		auto out = std::ostringstream{};
+		out << "{\n  \"executions\": " << count << ",\n  \"cycles\": " << cycles << ",\n  \"host_time\": " << (host_timed() ? "true" : "false");
+		out << ",\n  \"opcodes\": [";
+		auto first = true;
+		for (const auto& i : sorted()) {
+			const auto& entry = entries_[i];
+			out << (first ? "\n" : ",\n") << "    {\"opcode\": \"" << opcode_name(i) << "\", \"mnemonic\": \"" << mnemonic(names, i) << '"';
+			out << ", \"executions\": " << entry.count << ", \"cycles\": " << entry.cycles;
+			out << ", \"host_samples\": " << entry.host_samples << ", \"host_ticks\": " << entry.host_ticks << '}';
+			first = false;
+		}
+		out << "\n  ]\n}\n";
+		return out.str();
+	}
+
+private:
+	[[nodiscard]] auto totals() const -> std::pair<uint64_t, uint64_t>
+	{
+		auto count = uint64_t{0};
+		auto cycles = uint64_t{0};
+		for (const auto& entry : entries_) {
+			count += entry.count;
+			cycles += entry.cycles;
+		}
+		return {count, cycles};
+	}
+
+	[[nodiscard]] auto host_timed() const -> bool
+	{
+		return std::any_of(begin(entries_), end(entries_), [](const auto& entry) { return entry.host_samples > 0; });
+	}
+
+	[[nodiscard]] static auto ticks_per_execution(const Entry& entry) -> double
+	{
+		return entry.host_samples == 0 ? 0.0 : static_cast<double>(entry.host_ticks) / static_cast<double>(entry.host_samples);
+	}
+
+	[[nodiscard]] static auto opcode_name(const size_t& index) -> std::string
+	{
+		auto out = std::ostringstream{};
+		out << "0x" << std::hex << std::setfill('0') << (index < 0x100 ? std::setw(2) : std::setw(4)) << (index < 0x100 ? index : index - 0x100 + 0xcb00);
+		return out.str();
+	}
+
+	[[nodiscard]] static auto mnemonic(const std::vector<Instruction>& names, const size_t& index) -> std::string
+	{
+		return names[index].mnemonic.empty() ? "?" : names[index].mnemonic;
+	}
+
+	std::array<Entry, OPCODES> entries_ = {};
+	uint64_t until_sample_ = {};
+};
+
+// Profiles of all threads are added up here. At exit the report goes to stderr and the JSON to opcode_profile.json,
+// or the file in GRAYBOY_OPCODE_PROFILE.
+class OpcodeProfileExport {
+public:
+	~OpcodeProfileExport()
+	{
+		const auto lock = std::lock_guard{mutex_};
+		if (total_.sorted().empty()) {
+			return;
+		}
+
+		std::cerr << total_.report();
+		const auto* path = std::getenv("GRAYBOY_OPCODE_PROFILE");
+		auto file = std::ofstream(path != nullptr ? path : "opcode_profile.json");
+		file << total_.json();
+	}
+
+	auto add(const OpcodeProfiler& profiler) -> void
+	{
+		const auto lock = std::lock_guard{mutex_};
+		total_.merge(profiler);
+	}
+
+private:
+	std::mutex mutex_ = {};
+	OpcodeProfiler total_ = {};
+};
+
+inline auto opcode_profile_export() -> OpcodeProfileExport&
+{
+	static auto instance = OpcodeProfileExport{};
+	return instance;
+}
+
+// Each thread counts on its own and adds its profile to the export when it ends
+inline auto thread_opcode_profiler() -> OpcodeProfiler&
+{
+	struct ThreadProfiler {
+		// Created first so it's destroyed after this
+		OpcodeProfileExport& destination = opcode_profile_export();
+		OpcodeProfiler profiler = {};
+
+		~ThreadProfiler()
+		{
+			destination.add(profiler);
+		}
+	};
+
+	thread_local auto thread = ThreadProfiler{};
+	return thread.profiler;
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Host hardware counters of this thread (user space only) around a piece of work, read through Linux perf_event_open.
+// Counters the kernel, the CPU or a VM don't allow are missing from the results, without any it's just unavailable.
+class PerfCounters {
+public:
+	enum Counter { cycles, instructions, branch_misses, l1d_misses, COUNTERS };
+
+	static constexpr std::array<const char*, COUNTERS> NAMES = {"cycles", "instructions", "branch_misses", "l1d_misses"};
+
+	// Missing when the counter couldn't be opened
+	using Counts = std::array<std::optional<double>, COUNTERS>;
+
+	PerfCounters()
+	{
+#if defined(__linux__)
+		open(cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+		open(instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+		open(branch_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+		open(l1d_misses,
+		  PERF_TYPE_HW_CACHE,
+		  PERF_COUNT_HW_CACHE_L1D | PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+#else
+		error_ = "perf_event_open is only on Linux";
+#endif
+	}
+
+	PerfCounters(const PerfCounters&) = delete;
+	auto operator=(const PerfCounters&) -> PerfCounters& = delete;
+
+	~PerfCounters()
+	{
+#if defined(__linux__)
+		for (const auto& fd : fds_) {
+			if (fd >= 0) {
+				::close(fd);
+			}
+		}
+#endif
+	}
+
+	[[nodiscard]] auto available() const -> bool
+	{
+		for (const auto& fd : fds_) {
+			if (fd >= 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Why the first counter that failed couldn't be opened, empty if all were
+	[[nodiscard]] auto error() const -> const std::string&
+	{
+		return error_;
+	}
+
+	auto start() -> void
+	{
+#if defined(__linux__)
+		for (const auto& fd : fds_) {
+			if (fd >= 0) {
+				::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+				::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+		}
+#endif
+	}
+
+	// Counts since start(), scaled up if the kernel had to share the hardware counters between more events
+	auto stop() -> Counts
+	{
+		auto counts = Counts{};
+#if defined(__linux__)
+		for (auto i = size_t{0}; i < COUNTERS; ++i) {
+			if (fds_[i] >= 0) {
+				::ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+			}
+		}
+
+		for (auto i = size_t{0}; i < COUNTERS; ++i) {
+			// value, time enabled, time running
+			auto values = std::array<uint64_t, 3>{};
+			if (fds_[i] < 0 || ::read(fds_[i], values.data(), sizeof(values)) != sizeof(values) || values[2] == 0) {
+				continue;
+			}
+			counts[i] = static_cast<double>(values[0]) * static_cast<double>(values[1]) / static_cast<double>(values[2]);
+		}
+#endif
+		return counts;
+	}
+
+private:
+#if defined(__linux__)
+	auto open(const Counter& counter, const uint32_t& type, const uint64_t& config) -> void
+	{
+		auto attributes = perf_event_attr{};
+		attributes.size = sizeof(attributes);
+		attributes.type = type;
+		attributes.config = config;
+		attributes.disabled = 1;
+		attributes.exclude_kernel = 1;
+		attributes.exclude_hv = 1;
+		attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+		fds_[counter] = static_cast<int>(::syscall(SYS_perf_event_open, &attributes, 0, -1, -1, PERF_FLAG_FD_CLOEXEC));
+		if (fds_[counter] < 0 && error_.empty()) {
+			error_ = std::string(NAMES[counter]) + ": " + std::strerror(errno);
+		}
+	}
+#endif
+
+	std::array<int, COUNTERS> fds_ = {-1, -1, -1, -1};
+	std::string error_ = {};
+};
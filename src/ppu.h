@@ -0,0 +1,342 @@
+#pragma once
+#include "deferred_renderer.h"
+#include "memory.h"
+#include "scanline_renderer.h"
+#include "trace.h"
+
+#include <limits>
+#include <memory>
+
+struct ScanlineInfo {
+	uint64_t cycles = {};
+	bool line_rendered = {};
+	bool hblank_issued = {};
+
+	auto operator==(const ScanlineInfo&) const -> bool = default;
+};
+
+// PPU timing, rendered pixels and presentation settings are not part of it
+struct DisplayState {
+	uint64_t frame_cycles = {};
+	bool lcd_enabled = true;
+	bool vblank_issued = {};
+	ScanlineInfo scanline_info = {};
+
+	auto operator==(const DisplayState&) const -> bool = default;
+};
+
+// LCD timing, interupts and rendering into a framebuffer of shades, nothing here depends on how frames are shown
+class Ppu {
+public:
+	const uint64_t CYCLES_PER_FRAME = 70'224;
+	const uint64_t CYCLES_PER_SCANLINE = 456 / 4;
+	const uint64_t MODE_3_START = 80 / 4;
+	const uint64_t MODE_0_START = (80 + 172) / 4 + 1;
+
+	auto update(Memory& mem, const uint16_t& cycles) -> void
+	{
+		lcd_enabled_ = static_cast<bool>(mem.direct_read(0xff40) & (1 << 7));
+
+		frame_cycles_ += cycles;
+		if (lcd_enabled_) {
+			if (frame_cycles_ >= CYCLES_PER_FRAME) {
+				frame_cycles_ -= CYCLES_PER_FRAME;
+			}
+		}
+
+		else {
+			scanline_info_ = {};
+			mem.direct_write(0xff44, 0);
+			const auto stat = mem.direct_read(0xff41);
+			mem.direct_write(0xff41, stat & (~0x3));
+
+			return;
+		}
+
+		scanline_info_.cycles += cycles;
+
+		const auto stat = mem.direct_read(0xff41);
+		const auto scanline = mem.direct_read(0xff44);
+
+		auto request_interupt = false;
+		const auto orig_status = stat & 0x3;
+		auto new_status = 0;
+
+		if (scanline_info_.cycles < MODE_3_START) {
+			new_status = 2;
+			request_interupt = static_cast<bool>(stat & (1 << 5));
+		}
+		else if (scanline_info_.cycles < MODE_0_START) {
+			new_status = 3;
+			if (!scanline_info_.line_rendered) {
+				render_scanline(mem);
+				scanline_info_.line_rendered = true;
+			}
+		}
+
+		else {
+			new_status = 0;
+			if (!scanline_info_.hblank_issued) {
+				request_interupt = static_cast<bool>(stat & (1 << 3));
+				scanline_info_.hblank_issued = true;
+			}
+		}
+
+		if (new_status != orig_status && request_interupt) {
+			// Request interupt
+			mem.direct_write(0xff0f, mem.direct_read(0xff0f) | 0x2);
+		}
+
+		mem.direct_write(0xff41, (stat & ~0x3) | new_status);
+
+		if (scanline_info_.cycles >= CYCLES_PER_SCANLINE) {
+			scanline_info_.cycles -= CYCLES_PER_SCANLINE;
+			scanline_info_.line_rendered = scanline_info_.hblank_issued = vblank_issued_ = false;
+
+			if (scanline == 0x90 && !vblank_issued_) {
+				mem.direct_write(0xff0f, mem.direct_read(0xff0f) | 0x1);
+				vblank_issued_ = true;
+
+				if (deferred_renderer_ && !skip_rendering_ && !frame_hidden_) {
+					deferred_renderer_->submit_frame();
+				}
+				next_frame();
+			}
+
+			if (scanline + 1 >= 0x9a) {
+				mem.direct_write(0xff44, 0);
+			}
+			else {
+				mem.direct_write(0xff44, scanline + 1);
+			}
+			check_lyc(mem);
+		}
+	}
+
+	// Same as calling update() after every instruction, `last_step` being cycles of the last one. The cycles before it
+	// are split only where the PPU state changes. The last instruction is one update(), like without catching up,
+	// so a line end it crosses leaves HBlank in STAT until the next update.
+	auto catch_up(Memory& mem, uint64_t cycles, const uint64_t& last_step = 0) -> void
+	{
+		const auto last = std::min(cycles, last_step);
+		cycles -= last;
+		while (cycles > 0) {
+			const auto lcd_enabled = static_cast<bool>(mem.direct_read(0xff40) & (1 << 7));
+			const auto step = lcd_enabled ? std::min(cycles, cycles_to_next_step(mem)) : std::min(cycles, uint64_t{0xffff});
+
+			update(mem, static_cast<uint16_t>(step));
+			cycles -= step;
+		}
+		if (last > 0) {
+			update(mem, static_cast<uint16_t>(last));
+		}
+	}
+
+	// Cycles until the PPU may request an interupt: VBlank always, LCD STAT ones only if they are enabled.
+	// Nobody can observe the PPU before that unless it touches PPU memory or registers.
+	[[nodiscard]] auto cycles_to_interupt(const Memory& mem) const -> uint64_t
+	{
+		if (!(mem.direct_read(0xff40) & (1 << 7))) {
+			return std::numeric_limits<uint64_t>::max();
+		}
+
+		const auto LINES = uint64_t{0x9a};
+		const auto scanline = uint64_t{mem.direct_read(0xff44)};
+		const auto stat = mem.direct_read(0xff41);
+		const auto lyc = uint64_t{mem.direct_read(0xff45)};
+
+		const auto cycles = scanline_info_.cycles;
+		const auto to_line_end = CYCLES_PER_SCANLINE - cycles;
+
+		// VBlank is requested at the end of line 0x90
+		auto result = to_line_end + (0x90 + LINES - scanline) % LINES * CYCLES_PER_SCANLINE;
+
+		// LY == LYC is checked whenever LY changes
+		if ((stat & (1 << 6)) && lyc < LINES) {
+			result = std::min(result, to_line_end + (lyc + 2 * LINES - scanline - 1) % LINES * CYCLES_PER_SCANLINE);
+		}
+
+		// OAM search starts with the first update after the line changes
+		if (stat & (1 << 5)) {
+			result = std::min(result, line_start_pending(mem) ? uint64_t{1} : to_line_end + 1);
+		}
+
+		// HBlank
+		if (stat & (1 << 3)) {
+			result = std::min(result, cycles < MODE_0_START ? MODE_0_START - cycles : to_line_end + MODE_0_START);
+		}
+
+		return result;
+	}
+
+	// STAT mode catch_up() with `cycles` and `last_step` would leave, without running it
+	[[nodiscard]] auto mode_after(const Memory& mem, const uint64_t& cycles, const uint64_t& last_step) const -> uint8_t
+	{
+		if (cycles == 0) {
+			return mem.direct_read(0xff41) & 0x3;
+		}
+		if (!(mem.direct_read(0xff40) & (1 << 7))) {
+			return 0;
+		}
+
+		// A line end crossed by the last step stays in HBlank
+		const auto last = std::min(cycles, last_step);
+		const auto before_last = (scanline_info_.cycles + cycles - last) % CYCLES_PER_SCANLINE;
+		if (before_last + last >= CYCLES_PER_SCANLINE) {
+			return 0;
+		}
+		const auto line_cycles = before_last + last;
+		return line_cycles < MODE_3_START ? 2 : line_cycles < MODE_0_START ? 3 : 0;
+	}
+
+	static auto check_lyc(Memory& mem) -> void
+	{
+		const auto stat = mem.direct_read(0xff41);
+		auto new_status = stat & 0x3;
+
+		// LY == LYC
+		if (mem.direct_read(0xff44) == mem.direct_read(0xff45)) {
+			new_status |= 1 << 2;
+			if (stat & (1 << 6)) {
+				// Request interupt
+				mem.direct_write(0xff0f, mem.direct_read(0xff0f) | 0x2);
+			}
+		}
+		else {
+			new_status &= ~(1 << 2);
+		}
+
+		mem.direct_write(0xff41, (stat & ~0x3) | new_status);
+	}
+
+	// Shade (0-3) of every pixel of the last rendered frame, row by row
+	[[nodiscard]] auto framebuffer() const -> const std::array<uint8_t, 160 * 144>&
+	{
+		return framebuffer_;
+	}
+
+	// Number of times the PPU entered VBlank
+	[[nodiscard]] auto frame_count() const -> uint64_t
+	{
+		return frame_count_;
+	}
+
+	auto save_state(DisplayState& state) const -> void
+	{
+		state = {
+		  .frame_cycles = frame_cycles_,
+		  .lcd_enabled = lcd_enabled_,
+		  .vblank_issued = vblank_issued_,
+		  .scanline_info = scanline_info_,
+		};
+	}
+
+	auto load_state(const DisplayState& state) -> void
+	{
+		frame_cycles_ = state.frame_cycles;
+		lcd_enabled_ = state.lcd_enabled;
+		vblank_issued_ = state.vblank_issued;
+		scanline_info_ = state.scanline_info;
+	}
+
+	// Frames emulated while hidden are neither rendered nor presented (run-ahead)
+	auto set_frame_hidden(const bool& hidden) -> void
+	{
+		frame_hidden_ = hidden;
+	}
+
+	// Scanlines are only recorded during emulation and whole frames are rendered on a worker thread at VBlank
+	auto set_deferred_rendering(const bool& enabled) -> void
+	{
+		if (enabled && !deferred_renderer_) {
+			deferred_renderer_ = std::make_unique<DeferredRenderer>();
+		}
+		else if (!enabled && deferred_renderer_) {
+			deferred_renderer_->finish();
+			deferred_renderer_->copy_frame(framebuffer_);
+			deferred_renderer_.reset();
+		}
+	}
+
+	// `skip_frames` out of every `frames` frames are not rendered, 0 renders all of them
+	auto set_frame_skip(const uint32_t& skip_frames, const uint32_t& frames) -> void
+	{
+		skip_frames_ = skip_frames;
+		frames_ = std::max(frames, uint32_t{1});
+		frame_index_ = 0;
+	}
+
+protected:
+	std::array<uint8_t, 160 * 144> framebuffer_ = {};
+	std::unique_ptr<DeferredRenderer> deferred_renderer_ = {};
+	bool last_frame_rendered_ = true;
+
+private:
+	// Called at VBlank, decides whether the following frame gets rendered
+	auto next_frame() -> void
+	{
+		last_frame_rendered_ = !skip_rendering_ && !frame_hidden_;
+		++frame_count_;
+
+		++frame_index_;
+		skip_rendering_ = frame_index_ % frames_ < skip_frames_;
+	}
+
+	// A new line has started but STAT still shows HBlank of the previous one, the next update() switches to OAM search
+	[[nodiscard]] auto line_start_pending(const Memory& mem) const -> bool
+	{
+		return scanline_info_.cycles < MODE_3_START && (mem.direct_read(0xff41) & 0x3) != 2;
+	}
+
+	// Cycles until update() reaches the next mode change or the end of the scanline
+	[[nodiscard]] auto cycles_to_next_step(const Memory& mem) const -> uint64_t
+	{
+		const auto cycles = scanline_info_.cycles;
+		if (line_start_pending(mem)) {
+			return 1;
+		}
+		if (cycles < MODE_3_START) {
+			return MODE_3_START - cycles;
+		}
+		if (cycles < MODE_0_START) {
+			return MODE_0_START - cycles;
+		}
+		return CYCLES_PER_SCANLINE - cycles;
+	}
+
+	// Background, window and sprites of the current scanline are composed at once, straight into the framebuffer
+	auto render_scanline(const Memory& mem) -> void
+	{
+		if (skip_rendering_ || frame_hidden_) {
+			return;
+		}
+
+		GRAYBOY_TRACE_SCOPE("scanline");
+		if (deferred_renderer_) {
+			deferred_renderer_->record_scanline(mem);
+			return;
+		}
+
+		const auto scanline = mem.direct_read(0xff44);
+		if (scanline >= 0x90) {
+			return;
+		}
+
+		renderer_.render(mem, scanline, framebuffer_.data() + scanline * 160);
+	}
+
+	ScanlineRenderer renderer_ = {};
+
+	uint64_t frame_cycles_ = {};
+	uint64_t frame_count_ = {};
+	bool lcd_enabled_ = true;
+	bool vblank_issued_ = {};
+
+	uint32_t skip_frames_ = {};
+	uint32_t frames_ = 1;
+	uint64_t frame_index_ = {};
+	bool skip_rendering_ = {};
+	bool frame_hidden_ = {};
+
+	ScanlineInfo scanline_info_ = {};
+};
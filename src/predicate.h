@@ -0,0 +1,491 @@
+#pragma once
+
+#include "address_set.h"
+#include "registers.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <string>
+#include <vector>
+
+// Condition over guest memory, registers and frame count, e.g. "changed[0xd057] || [0xc0a0] == 0 && frame > 60".
+// Compiled once into flat bytecode for a small stack machine, evaluating it doesn't allocate.
+//
+// Values are integers, C operators and precedence: || && | ^ & == != < <= > >= + - and unary ! - ~, parentheses.
+//   123, 0x7b          constants
+//   [0xd057]           byte at the address
+//   word[0xd057]       little-endian 16 bit value at the address
+//   previous[0xd057]   byte at the address when the predicate was evaluated (or armed) the last time
+//   changed[0xd057]    1 if the byte differs from previous[0xd057]
+//   A F B C D E H L    8 bit registers
+//   AF BC DE HL PC SP  16 bit registers
+//   frame              frames run so far
+// Addresses have to be constants backed by the memory array, see AddressSet.
+class Predicate {
+public:
+	explicit Predicate(const std::string& expression) : expression_{expression}
+	{
+		auto parser = Parser{*this, expression};
+		parser.parse();
+
+		// Depth is known at compile time, there's a fixed stack for evaluation
+		auto depth = 0;
+		for (const auto& instruction : code_) {
+			depth += stack_effect(instruction.op);
+			max_depth_ = std::max(max_depth_, depth);
+		}
+		if (max_depth_ > static_cast<int>(MAX_DEPTH)) {
+			throw std::invalid_argument("Expression is too deeply nested: " + expression);
+		}
+
+		std::sort(begin(watched_), end(watched_));
+		watched_.erase(std::unique(begin(watched_), end(watched_)), end(watched_));
+		needs_ppu_sync_ = std::any_of(begin(watched_), end(watched_), [](const uint16_t& address) { return Memory::is_ppu_visible(address); });
+	}
+
+	// Takes the current values as the previous ones, changed[] is false until they change
+	auto arm(const uint8_t* memory) -> void
+	{
+		for (auto i = size_t{0}; i < tracked_.size(); ++i) { previous_[i] = memory[tracked_[i]]; }
+	}
+
+	// `memory` is the whole address space as Memory::data() gives it
+	auto evaluate(const uint8_t* memory, const Registers& registers, const uint64_t& frame) -> bool
+	{
+		const auto registers_array = registers.dump();
+		auto stack = std::array<int64_t, MAX_DEPTH>{};
+		auto top = -1;
+
+		for (auto pc = size_t{0}; pc < code_.size(); ++pc) {
+			const auto& [op, operand] = code_[pc];
+			switch (op) {
+				case Op::constant:
+					stack[++top] = operand;
+					break;
+				case Op::byte:
+					stack[++top] = memory[operand];
+					break;
+				case Op::word:
+					stack[++top] = memory[operand] | memory[operand + 1] << 8;
+					break;
+				case Op::previous:
+					stack[++top] = previous_[operand];
+					break;
+				case Op::changed:
+					stack[++top] = memory[tracked_[operand]] != previous_[operand];
+					break;
+				case Op::register8:
+					stack[++top] = registers_array[operand];
+					break;
+				case Op::register16:
+					stack[++top] = registers_array[operand] | registers_array[operand + 1] << 8;
+					break;
+				case Op::frame:
+					stack[++top] = static_cast<int64_t>(frame);
+					break;
+				case Op::logical_not:
+					stack[top] = !stack[top];
+					break;
+				case Op::negate:
+					stack[top] = -stack[top];
+					break;
+				case Op::bit_not:
+					stack[top] = ~stack[top];
+					break;
+				case Op::to_bool:
+					stack[top] = stack[top] != 0;
+					break;
+				// Short-circuit: the left side stays as the result or is dropped for the right side
+				case Op::jump_if_false:
+					if (stack[top] == 0) {
+						pc = static_cast<size_t>(operand) - 1;
+					}
+					else {
+						--top;
+					}
+					break;
+				case Op::jump_if_true:
+					if (stack[top] != 0) {
+						stack[top] = 1;
+						pc = static_cast<size_t>(operand) - 1;
+					}
+					else {
+						--top;
+					}
+					break;
+				default:
+					--top;
+					stack[top] = binary(op, stack[top], stack[top + 1]);
+					break;
+			}
+		}
+
+		// Values are taken after every evaluation, even from the parts short-circuit skipped
+		arm(memory);
+		return stack[0] != 0;
+	}
+
+	// Addresses the predicate reads, it can only change its result when they are written (or registers/frame change)
+	[[nodiscard]] auto watched_addresses() const -> const std::vector<uint16_t>&
+	{
+		return watched_;
+	}
+
+	[[nodiscard]] auto needs_ppu_sync() const -> bool
+	{
+		return needs_ppu_sync_;
+	}
+
+	[[nodiscard]] auto expression() const -> const std::string&
+	{
+		return expression_;
+	}
+
+	// Bytecode length, for tests and curiosity
+	[[nodiscard]] auto size() const -> size_t
+	{
+		return code_.size();
+	}
+
+private:
+	static constexpr size_t MAX_DEPTH = 64;
+
+	enum class Op : uint8_t {
+		constant,
+		byte,
+		word,
+		previous,
+		changed,
+		register8,
+		register16,
+		frame,
+		logical_not,
+		negate,
+		bit_not,
+		to_bool,
+		jump_if_false,
+		jump_if_true,
+		add,
+		subtract,
+		bit_and,
+		bit_or,
+		bit_xor,
+		equal,
+		not_equal,
+		less,
+		less_equal,
+		greater,
+		greater_equal,
+	};
+
+	struct Instruction {
+		Op op = {};
+		int64_t operand = {};
+	};
+
+	[[nodiscard]] static auto binary(const Op& op, const int64_t& left, const int64_t& right) -> int64_t
+	{
+		switch (op) {
+			case Op::add:
+				return left + right;
+			case Op::subtract:
+				return left - right;
+			case Op::bit_and:
+				return left & right;
+			case Op::bit_or:
+				return left | right;
+			case Op::bit_xor:
+				return left ^ right;
+			case Op::equal:
+				return left == right;
+			case Op::not_equal:
+				return left != right;
+			case Op::less:
+				return left < right;
+			case Op::less_equal:
+				return left <= right;
+			case Op::greater:
+				return left > right;
+			case Op::greater_equal:
+				return left >= right;
+			default:
+				return 0;
+		}
+	}
+
+	// Along the straight-line code, jumps leave the same depth either way
+	[[nodiscard]] static auto stack_effect(const Op& op) -> int
+	{
+		switch (op) {
+			case Op::constant:
+			case Op::byte:
+			case Op::word:
+			case Op::previous:
+			case Op::changed:
+			case Op::register8:
+			case Op::register16:
+			case Op::frame:
+				return 1;
+			case Op::logical_not:
+			case Op::negate:
+			case Op::bit_not:
+			case Op::to_bool:
+				return 0;
+			default:
+				return -1;
+		}
+	}
+
+	// Recursive descent, emits code straight into the predicate
+	class Parser {
+	public:
+		Parser(Predicate& predicate, const std::string& text) : predicate_{predicate}, text_{text} {}
+
+		auto parse() -> void
+		{
+			logical_or();
+			skip_spaces();
+			if (position_ != text_.size()) {
+				fail("Unexpected '" + text_.substr(position_, 1) + "'");
+			}
+		}
+
+	private:
+		auto logical_or() -> void
+		{
+			logical_and();
+			while (accept("||")) { short_circuit(Op::jump_if_true, [&] { logical_and(); }); }
+		}
+
+		auto logical_and() -> void
+		{
+			binary_level(0);
+			while (accept("&&")) { short_circuit(Op::jump_if_false, [&] { binary_level(0); }); }
+		}
+
+		template<typename Right>
+		auto short_circuit(const Op& jump, const Right& right) -> void
+		{
+			const auto jump_index = emit(jump);
+			right();
+			emit(Op::to_bool);
+			predicate_.code_[jump_index].operand = static_cast<int64_t>(predicate_.code_.size());
+		}
+
+		// Left associative binary operators from the loosest to the tightest binding
+		auto binary_level(const size_t& level) -> void
+		{
+			struct Operator {
+				const char* token;
+				Op op;
+			};
+			static const auto levels = std::array<std::vector<Operator>, 6>{{
+			  {{"|", Op::bit_or}},
+			  {{"^", Op::bit_xor}},
+			  {{"&", Op::bit_and}},
+			  {{"==", Op::equal}, {"!=", Op::not_equal}},
+			  {{"<=", Op::less_equal}, {">=", Op::greater_equal}, {"<", Op::less}, {">", Op::greater}},
+			  {{"+", Op::add}, {"-", Op::subtract}},
+			}};
+
+			const auto operand = [&] {
+				if (level + 1 < levels.size()) {
+					binary_level(level + 1);
+				}
+				else {
+					unary();
+				}
+			};
+
+			operand();
+			while (true) {
+				const auto it = std::find_if(begin(levels[level]), end(levels[level]), [&](const Operator& candidate) { return accept_operator(candidate.token); });
+				if (it == end(levels[level])) {
+					return;
+				}
+				operand();
+				emit(it->op);
+			}
+		}
+
+		auto unary() -> void
+		{
+			if (accept("!")) {
+				unary();
+				emit(Op::logical_not);
+			}
+			else if (accept("-")) {
+				unary();
+				emit(Op::negate);
+			}
+			else if (accept("~")) {
+				unary();
+				emit(Op::bit_not);
+			}
+			else {
+				primary();
+			}
+		}
+
+		auto primary() -> void
+		{
+			skip_spaces();
+			if (accept("(")) {
+				logical_or();
+				expect(")");
+				return;
+			}
+			if (accept("[")) {
+				emit(Op::byte, address(1));
+				return;
+			}
+			if (position_ < text_.size() && std::isdigit(static_cast<unsigned char>(text_[position_]))) {
+				emit(Op::constant, number());
+				return;
+			}
+
+			const auto name = identifier();
+			if (name == "frame") {
+				emit(Op::frame);
+			}
+			else if (name == "word") {
+				expect("[");
+				emit(Op::word, address(2));
+			}
+			else if (name == "previous" || name == "changed") {
+				expect("[");
+				emit(name == "previous" ? Op::previous : Op::changed, tracked_slot(address(1)));
+			}
+			else if (name.size() == 1 && std::string_view{"AFBCDEHL"}.find(name[0]) != std::string_view::npos) {
+				emit(Op::register8, Registers::register_index(name));
+			}
+			else if (name == "AF" || name == "BC" || name == "DE" || name == "HL" || name == "PC" || name == "SP") {
+				emit(Op::register16, Registers::register_index(name));
+			}
+			else {
+				fail(name.empty() ? "Expected a value" : "Unknown name '" + name + "'");
+			}
+		}
+
+		// Address in brackets, the opening one is consumed already
+		auto address(const int& bytes) -> int64_t
+		{
+			skip_spaces();
+			const auto value = number();
+			expect("]");
+
+			for (auto i = 0; i < bytes; ++i) {
+				const auto byte_address = value + i;
+				if (byte_address > 0xffff || !AddressSet::is_gatherable(static_cast<uint16_t>(byte_address))) {
+					fail("Address " + std::to_string(byte_address) + " is not backed by the memory array");
+				}
+				predicate_.watched_.push_back(static_cast<uint16_t>(byte_address));
+			}
+			return value;
+		}
+
+		auto tracked_slot(const int64_t& address) -> int64_t
+		{
+			auto& tracked = predicate_.tracked_;
+			const auto it = std::find(begin(tracked), end(tracked), address);
+			if (it != end(tracked)) {
+				return it - begin(tracked);
+			}
+			tracked.push_back(static_cast<uint16_t>(address));
+			predicate_.previous_.push_back(0);
+			return static_cast<int64_t>(tracked.size() - 1);
+		}
+
+		// Decimal or hexadecimal with 0x
+		auto number() -> int64_t
+		{
+			const auto hex = text_.compare(position_, 2, "0x") == 0;
+			const auto base = hex ? 16 : 10;
+			position_ += hex ? 2 : 0;
+
+			const auto start = position_;
+			auto value = int64_t{};
+			while (position_ < text_.size() && std::isxdigit(static_cast<unsigned char>(text_[position_]))) {
+				const auto c = static_cast<char>(std::tolower(static_cast<unsigned char>(text_[position_])));
+				const auto digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : c - 'a' + 10;
+				if (digit >= base || value > 0xffff'ffff) {
+					break;
+				}
+				value = value * base + digit;
+				++position_;
+			}
+			if (position_ == start) {
+				fail("Expected a number");
+			}
+			return value;
+		}
+
+		auto identifier() -> std::string
+		{
+			const auto start = position_;
+			while (position_ < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[position_])) || text_[position_] == '_')) {
+				++position_;
+			}
+			return text_.substr(start, position_ - start);
+		}
+
+		auto accept(const std::string_view& token) -> bool
+		{
+			skip_spaces();
+			if (text_.compare(position_, token.size(), token) == 0) {
+				position_ += token.size();
+				return true;
+			}
+			return false;
+		}
+
+		auto accept_operator(const std::string_view& token) -> bool
+		{
+			skip_spaces();
+			// "|" and "&" must not take the first half of "||" and "&&"
+			if ((token == "|" || token == "&") && position_ + 1 < text_.size() && text_[position_ + 1] == token[0]) {
+				return false;
+			}
+			return accept(token);
+		}
+
+		auto expect(const std::string_view& token) -> void
+		{
+			if (!accept(token)) {
+				fail("Expected '" + std::string{token} + "'");
+			}
+		}
+
+		auto skip_spaces() -> void
+		{
+			while (position_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[position_]))) { ++position_; }
+		}
+
+		auto emit(const Op& op, const int64_t& operand = 0) -> size_t
+		{
+			predicate_.code_.push_back({op, operand});
+			return predicate_.code_.size() - 1;
+		}
+
+		[[noreturn]] auto fail(const std::string& message) const -> void
+		{
+			throw std::invalid_argument(message + " at " + std::to_string(position_) + " in \"" + text_ + "\"");
+		}
+
+		Predicate& predicate_;
+		const std::string& text_;
+		size_t position_ = {};
+	};
+
+	std::string expression_ = {};
+	std::vector<Instruction> code_ = {};
+	int max_depth_ = {};
+
+	// Addresses of previous[] and changed[], slots are shared by the same address
+	std::vector<uint16_t> tracked_ = {};
+	std::vector<uint8_t> previous_ = {};
+
+	std::vector<uint16_t> watched_ = {};
+	bool needs_ppu_sync_ = {};
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "rl_protocol.h"
+
+#include <optional>
+#include <sys/un.h>
+#include <vector>
+
+// Client side of RlServer. reset() and step() block until the server answers and return the observations
+// of all environments, they stay valid for the next `slots() - 1` requests.
+class RlClient {
+public:
+	// Connects to the server listening on a Unix socket
+	explicit RlClient(const std::string& socket_path) : RlClient(connect_to(socket_path)) {}
+
+	// Takes ownership of a connected socket
+	explicit RlClient(const int& fd) : fd_{fd}
+	{
+		if (!receive_all(fd_, &hello_, sizeof(hello_)) || hello_.version != RL_PROTOCOL_VERSION) {
+			::close(fd_);
+			throw std::runtime_error("RL server didn't say hello or speaks another protocol version");
+		}
+
+		ring_.emplace(SharedRing::open(hello_.shared_memory_name, hello_.slots, size_t{hello_.envs} * hello_.observation_size));
+	}
+
+	RlClient(const RlClient&) = delete;
+	auto operator=(const RlClient&) -> RlClient& = delete;
+
+	~RlClient()
+	{
+		::close(fd_);
+	}
+
+	auto reset(const std::vector<uint8_t>& mask) -> const uint8_t*
+	{
+		return request(RlRequestType::reset, mask);
+	}
+
+	auto step(const std::vector<uint8_t>& actions) -> const uint8_t*
+	{
+		return request(RlRequestType::step, actions);
+	}
+
+	// Observation of one environment within what reset() or step() returned
+	[[nodiscard]] auto observation(const uint8_t* observations, const size_t& env) const -> const uint8_t*
+	{
+		return observations + env * hello_.observation_size;
+	}
+
+	[[nodiscard]] auto envs() const -> size_t
+	{
+		return hello_.envs;
+	}
+
+	[[nodiscard]] auto slots() const -> size_t
+	{
+		return hello_.slots;
+	}
+
+	[[nodiscard]] auto ram_bytes() const -> size_t
+	{
+		return hello_.ram_bytes;
+	}
+
+private:
+	static auto connect_to(const std::string& socket_path) -> int
+	{
+		auto address = sockaddr_un{.sun_family = AF_UNIX, .sun_path = {}};
+		if (socket_path.size() >= sizeof(address.sun_path)) {
+			throw std::invalid_argument("Socket path is too long");
+		}
+		std::copy(begin(socket_path), end(socket_path), address.sun_path);
+
+		const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+			const auto error = std::string(std::strerror(errno));
+			if (fd >= 0) {
+				::close(fd);
+			}
+			throw std::runtime_error("Can't connect to " + socket_path + ": " + error);
+		}
+		return fd;
+	}
+
+	auto request(const RlRequestType& type, const std::vector<uint8_t>& payload) -> const uint8_t*
+	{
+		if (payload.size() != hello_.envs) {
+			throw std::invalid_argument("One byte per environment is expected");
+		}
+
+		const auto header = RlRequest{.type = type, .envs = hello_.envs};
+		auto response = RlResponse{};
+		if (!send_all(fd_, &header, sizeof(header)) || !send_all(fd_, payload.data(), payload.size())
+		    || !receive_all(fd_, &response, sizeof(response))) {
+			throw std::runtime_error("Connection to the RL server was lost");
+		}
+		if (response.status != 0) {
+			throw std::runtime_error("RL server rejected the request");
+		}
+		return ring_->slot(response.slot);
+	}
+
+	int fd_ = -1;
+	RlHello hello_ = {};
+	std::optional<SharedRing> ring_ = {};
+};
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "batch_runner.h"
+
+#include <cstring>
+
+// Batch of headless emulators of one ROM driven as RL environments. Every step applies one joypad state (action)
+// per environment, runs `frame_skip` frames and writes observations of all environments into one buffer.
+//
+// Observation of an environment, `observation_size()` bytes:
+//   160 * 144 shades (0-3) of the last frame, row by row
+//   the selected RAM bytes in the order they were given, see AddressSet for which addresses are allowed
+//   padding to 64 bytes
+class RlEnvironment {
+public:
+	static constexpr size_t FRAMEBUFFER_SIZE = 160 * 144;
+
+	RlEnvironment(const std::string& cartridge_path,
+	  const size_t& envs,
+	  std::vector<uint16_t> ram_addresses = {},
+	  const uint32_t& frame_skip = 1,
+	  const size_t& threads = std::thread::hardware_concurrency())
+	  : batch_{std::vector<std::string>(envs, cartridge_path), threads}
+	  , ram_{std::move(ram_addresses)}
+	  , frame_skip_{std::max(frame_skip, uint32_t{1})}
+	  , power_on_(envs)
+	{
+		batch_.run([&](const size_t& index, Emulator<true>& emulator) {
+			emulator.set_headless_rendering(true);
+			emulator.save_state(power_on_[index]);
+		});
+	}
+
+	// Environments with a non-zero byte in `mask` (one per environment) go back to power-on
+	auto reset(const uint8_t* mask, uint8_t* observations) -> void
+	{
+		batch_.run([&](const size_t& index, Emulator<true>& emulator) {
+			if (mask[index] != 0) {
+				emulator.load_state(power_on_[index]);
+			}
+			write_observation(emulator, observations + index * observation_size());
+		});
+	}
+
+	// One action (joypad state, see Emulator::set_joypad) per environment
+	auto step(const uint8_t* actions, uint8_t* observations) -> void
+	{
+		batch_.run([&](const size_t& index, Emulator<true>& emulator) {
+			emulator.set_joypad(actions[index]);
+			for (auto frame = uint32_t{0}; frame < frame_skip_; ++frame) { emulator.run_frame(); }
+			write_observation(emulator, observations + index * observation_size());
+		});
+	}
+
+	[[nodiscard]] auto observation_size() const -> size_t
+	{
+		return (FRAMEBUFFER_SIZE + ram_.size() + 63) / 64 * 64;
+	}
+
+	[[nodiscard]] auto envs() const -> size_t
+	{
+		return batch_.size();
+	}
+
+	[[nodiscard]] auto ram_addresses() const -> const std::vector<uint16_t>&
+	{
+		return ram_.addresses();
+	}
+
+private:
+	auto write_observation(Emulator<true>& emulator, uint8_t* out) const -> void
+	{
+		std::memcpy(out, emulator.framebuffer().data(), FRAMEBUFFER_SIZE);
+		emulator.gather(ram_, out + FRAMEBUFFER_SIZE);
+	}
+
+	BatchRunner batch_;
+	AddressSet ram_;
+	uint32_t frame_skip_ = 1;
+	std::vector<EmulatorState> power_on_ = {};
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// RL server protocol. Requests and responses are small fixed messages on a Unix stream socket, observations are
+// written into a ring of slots in shared memory and only the slot index goes through the socket.
+//
+//   server -> client on connect: RlHello
+//   client -> server: RlRequest followed by `envs` bytes (reset mask or actions)
+//   server -> client: RlResponse, the observations are in slot `slot` of the ring
+//
+// Slot of a response stays untouched for the next `slots - 1` requests, so a client can keep recent observations
+// (frame stacking) without copying them.
+
+constexpr uint32_t RL_PROTOCOL_VERSION = 1;
+
+enum class RlRequestType : uint32_t {
+	reset = 1,
+	step = 2,
+};
+
+struct RlHello {
+	uint32_t version = RL_PROTOCOL_VERSION;
+	uint32_t envs = {};
+	uint32_t slots = {};
+	// Bytes of one environment's observation, see RlEnvironment
+	uint32_t observation_size = {};
+	uint32_t ram_bytes = {};
+	char shared_memory_name[64] = {};
+};
+
+struct RlRequest {
+	RlRequestType type = {};
+	uint32_t envs = {};
+};
+
+struct RlResponse {
+	int32_t status = {};
+	uint32_t slot = {};
+	uint64_t sequence = {};
+};
+
+// Whole buffer, false if the other side closed the connection
+inline auto send_all(const int& fd, const void* data, size_t size) -> bool
+{
+	const auto* bytes = static_cast<const uint8_t*>(data);
+	while (size > 0) {
+		const auto sent = ::send(fd, bytes, size, MSG_NOSIGNAL);
+		if (sent < 0 && errno == EINTR) {
+			continue;
+		}
+		if (sent <= 0) {
+			return false;
+		}
+		bytes += sent;
+		size -= static_cast<size_t>(sent);
+	}
+	return true;
+}
+
+inline auto receive_all(const int& fd, void* data, size_t size) -> bool
+{
+	auto* bytes = static_cast<uint8_t*>(data);
+	while (size > 0) {
+		const auto received = ::recv(fd, bytes, size, 0);
+		if (received < 0 && errno == EINTR) {
+			continue;
+		}
+		if (received <= 0) {
+			return false;
+		}
+		bytes += received;
+		size -= static_cast<size_t>(received);
+	}
+	return true;
+}
+
+// Ring of equally sized slots in POSIX shared memory. The creator removes the name when it's destroyed.
+class SharedRing {
+public:
+	static auto create(const std::string& name, const size_t& slots, const size_t& slot_size) -> SharedRing
+	{
+		::shm_unlink(name.c_str());
+		const auto fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+		if (fd < 0) {
+			throw std::runtime_error("Can't create shared memory " + name + ": " + std::strerror(errno));
+		}
+		if (::ftruncate(fd, static_cast<off_t>(slots * slot_size)) != 0) {
+			::close(fd);
+			::shm_unlink(name.c_str());
+			throw std::runtime_error("Can't resize shared memory " + name + ": " + std::strerror(errno));
+		}
+		return SharedRing{name, fd, slots, slot_size, true};
+	}
+
+	static auto open(const std::string& name, const size_t& slots, const size_t& slot_size) -> SharedRing
+	{
+		const auto fd = ::shm_open(name.c_str(), O_RDWR, 0);
+		if (fd < 0) {
+			throw std::runtime_error("Can't open shared memory " + name + ": " + std::strerror(errno));
+		}
+		return SharedRing{name, fd, slots, slot_size, false};
+	}
+
+	SharedRing(const SharedRing&) = delete;
+	auto operator=(const SharedRing&) -> SharedRing& = delete;
+
+	SharedRing(SharedRing&& other) noexcept
+	  : name_{std::move(other.name_)}
+	  , data_{std::exchange(other.data_, nullptr)}
+	  , slots_{other.slots_}
+	  , slot_size_{other.slot_size_}
+	  , owner_{std::exchange(other.owner_, false)}
+	{
+	}
+
+	auto operator=(SharedRing&&) -> SharedRing& = delete;
+
+	~SharedRing()
+	{
+		if (data_ != nullptr) {
+			::munmap(data_, slots_ * slot_size_);
+		}
+		if (owner_) {
+			::shm_unlink(name_.c_str());
+		}
+	}
+
+	[[nodiscard]] auto slot(const size_t& index) const -> uint8_t*
+	{
+		return static_cast<uint8_t*>(data_) + (index % slots_) * slot_size_;
+	}
+
+	[[nodiscard]] auto slots() const -> size_t
+	{
+		return slots_;
+	}
+
+	[[nodiscard]] auto name() const -> const std::string&
+	{
+		return name_;
+	}
+
+private:
+	SharedRing(std::string name, const int& fd, const size_t& slots, const size_t& slot_size, const bool& owner)
+	  : name_{std::move(name)}
+	  , slots_{slots}
+	  , slot_size_{slot_size}
+	  , owner_{owner}
+	{
+		data_ = ::mmap(nullptr, slots_ * slot_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		::close(fd);
+		if (data_ == MAP_FAILED) {
+			data_ = nullptr;
+			if (owner_) {
+				::shm_unlink(name_.c_str());
+			}
+			throw std::runtime_error("Can't map shared memory " + name_ + ": " + std::strerror(errno));
+		}
+	}
+
+	std::string name_ = {};
+	void* data_ = {};
+	size_t slots_ = {};
+	size_t slot_size_ = {};
+	bool owner_ = {};
+};
@@ -0,0 +1,139 @@
+#include "cli_options.h"
+#include "rl_server.h"
+
+#include <csignal>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <sys/un.h>
+
+namespace {
+
+// "0xd057,0xc000,..."
+auto parse_addresses(const std::string& list) -> std::vector<uint16_t>
+{
+	auto addresses = std::vector<uint16_t>{};
+	auto stream = std::istringstream{list};
+	for (auto item = std::string{}; std::getline(stream, item, ',');) {
+		addresses.push_back(static_cast<uint16_t>(parse_number("--ram", item, 0, 0xffff)));
+	}
+	return addresses;
+}
+
+auto listen_on(const std::string& socket_path) -> int
+{
+	auto address = sockaddr_un{.sun_family = AF_UNIX, .sun_path = {}};
+	if (socket_path.size() >= sizeof(address.sun_path)) {
+		throw std::invalid_argument("Socket path is too long");
+	}
+	std::copy(begin(socket_path), end(socket_path), address.sun_path);
+
+	::unlink(socket_path.c_str());
+	const auto fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0 || ::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 1) != 0) {
+		throw std::runtime_error("Can't listen on " + socket_path + ": " + std::strerror(errno));
+	}
+	return fd;
+}
+
+auto print_usage(const char* program) -> void
+{
+	std::cout << "Usage: " << program << " [--socket path] [--shm name] [--envs n] [--slots n] [--frame-skip n]"
+	          << " [--threads n] [--ram address,...] cartridge_filename\n";
+}
+
+// Sockets being waited on, the signal handler shuts them down so blocked accept() and recv() return
+volatile std::sig_atomic_t quit = 0;
+volatile std::sig_atomic_t listener_fd = -1;
+volatile std::sig_atomic_t client_fd = -1;
+
+auto request_quit(int /*signal*/) -> void
+{
+	quit = 1;
+	if (client_fd >= 0) {
+		::shutdown(client_fd, SHUT_RDWR);
+	}
+	if (listener_fd >= 0) {
+		::shutdown(listener_fd, SHUT_RDWR);
+	}
+}
+
+} // namespace
+
+// Hosts a batch of headless emulators and serves reset/step requests, one client at a time
+auto main(int argc, const char** argv) -> int
+{
+	auto args = std::vector<std::string>(argv + 1, argv + argc);
+	const auto socket_path = take_option(args, "--socket").value_or("/tmp/grayboy-rl.sock");
+	const auto shared_memory_name = take_option(args, "--shm").value_or("/grayboy-rl");
+	const auto envs_option = take_option(args, "--envs").value_or("16");
+	const auto slots_option = take_option(args, "--slots").value_or("4");
+	const auto frame_skip_option = take_option(args, "--frame-skip").value_or("1");
+	const auto threads_option = take_option(args, "--threads").value_or(std::to_string(std::max(1U, std::thread::hardware_concurrency())));
+	const auto ram_option = take_option(args, "--ram").value_or("");
+
+	if (args.size() != 1) {
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	// Counts end up in the protocol's 32-bit fields
+	const auto max = std::numeric_limits<uint32_t>::max();
+	auto envs = size_t{};
+	auto slots = size_t{};
+	auto frame_skip = uint32_t{};
+	auto threads = size_t{};
+	auto ram = std::vector<uint16_t>{};
+	try {
+		envs = parse_number("--envs", envs_option, 1, max);
+		slots = parse_number("--slots", slots_option, 1, max);
+		frame_skip = static_cast<uint32_t>(parse_number("--frame-skip", frame_skip_option, 1, max));
+		threads = parse_number("--threads", threads_option, 1, max);
+		ram = parse_addresses(ram_option);
+	}
+	catch (const std::invalid_argument& e) {
+		std::cout << e.what() << '\n';
+		print_usage(argv[0]);
+		return 1;
+	}
+
+	try {
+		auto environment = RlEnvironment{args[0], envs, ram, frame_skip, threads};
+		auto server = RlServer{environment, shared_memory_name, slots};
+		const auto listener = listen_on(socket_path);
+		listener_fd = listener;
+
+		// Not restarted, interrupted accept() returns and the loop ends
+		struct sigaction action = {};
+		action.sa_handler = request_quit;
+		::sigaction(SIGINT, &action, nullptr);
+		::sigaction(SIGTERM, &action, nullptr);
+
+		std::cout << "Serving " << envs << " environments on " << socket_path << ", observations in " << shared_memory_name << '\n';
+
+		while (quit == 0) {
+			const auto client = ::accept(listener, nullptr, nullptr);
+			if (client < 0) {
+				continue;
+			}
+
+			// A signal that came before the handler could see the client is noticed here
+			client_fd = client;
+			if (quit == 0) {
+				server.serve(client);
+			}
+			client_fd = -1;
+			::close(client);
+		}
+
+		listener_fd = -1;
+		::close(listener);
+		::unlink(socket_path.c_str());
+		// The server unlinks the shared memory as it goes out of scope
+	}
+	catch (const std::exception& e) {
+		std::cout << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "rl_environment.h"
+#include "rl_protocol.h"
+
+// Serves RlEnvironment to one connected client at a time, observations go into the shared ring
+class RlServer {
+public:
+	RlServer(RlEnvironment& environment, const std::string& shared_memory_name, const size_t& slots)
+	  : environment_{environment}
+	  , ring_{SharedRing::create(shared_memory_name, slots, environment.envs() * environment.observation_size())}
+	  , payload_(environment.envs())
+	{
+		hello_.envs = static_cast<uint32_t>(environment_.envs());
+		hello_.slots = static_cast<uint32_t>(ring_.slots());
+		hello_.observation_size = static_cast<uint32_t>(environment_.observation_size());
+		hello_.ram_bytes = static_cast<uint32_t>(environment_.ram_addresses().size());
+
+		if (shared_memory_name.size() >= sizeof(hello_.shared_memory_name)) {
+			throw std::invalid_argument("Shared memory name is too long");
+		}
+		std::copy(begin(shared_memory_name), end(shared_memory_name), hello_.shared_memory_name);
+	}
+
+	// Returns when the client disconnects or sends a malformed request
+	auto serve(const int& fd) -> void
+	{
+		if (!send_all(fd, &hello_, sizeof(hello_))) {
+			return;
+		}
+
+		auto request = RlRequest{};
+		while (receive_all(fd, &request, sizeof(request))) {
+			if (request.envs != payload_.size() || !receive_all(fd, payload_.data(), payload_.size())) {
+				return;
+			}
+
+			auto response = RlResponse{.slot = static_cast<uint32_t>(sequence_ % ring_.slots()), .sequence = sequence_};
+			auto* observations = ring_.slot(sequence_);
+
+			switch (request.type) {
+				case RlRequestType::reset:
+					environment_.reset(payload_.data(), observations);
+					break;
+				case RlRequestType::step:
+					environment_.step(payload_.data(), observations);
+					break;
+				default:
+					response.status = -1;
+					break;
+			}
+			++sequence_;
+
+			if (!send_all(fd, &response, sizeof(response))) {
+				return;
+			}
+		}
+	}
+
+private:
+	RlEnvironment& environment_;
+	SharedRing ring_;
+	RlHello hello_ = {};
+
+	std::vector<uint8_t> payload_ = {};
+	uint64_t sequence_ = {};
+};
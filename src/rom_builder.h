@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Assembles small ROMs for tests and synthetic benchmarks. Code is given as opcode bytes, jumps and calls can target
+// labels which are resolved by build().
+//
+// The entry point (0x100) jumps to 0x150, where the builder starts emitting. Header fields the emulator reads
+// (cartridge type, ROM size, checksum) are filled in.
+class RomBuilder {
+public:
+	static constexpr size_t BANK_SIZE = 0x4000;
+
+	// `banks` of 16 kB, a power of two, at least 2
+	explicit RomBuilder(const uint8_t& cartridge_type = 0x00, const size_t& banks = 2)
+	  : rom_(banks * BANK_SIZE, 0x00), written_(banks * BANK_SIZE)
+	{
+		if (banks < 2 || (banks & (banks - 1)) != 0) {
+			throw std::invalid_argument("ROM has to have a power of two banks, at least 2");
+		}
+
+		// ROM size code is log2(banks) - 1
+		auto size_code = uint8_t{0};
+		for (auto size = banks; size > 2; size /= 2) { ++size_code; }
+
+		org(0x147).bytes({cartridge_type, size_code});
+		// nop; jp 0x150
+		org(0x100).bytes({0x00, 0xc3, 0x50, 0x01});
+		org(0x150);
+	}
+
+	// Next bytes go to `address`. Banks other than 0 are emitted for the switchable area 0x4000-0x7fff.
+	auto org(const uint16_t& address, const size_t& bank = 0) -> RomBuilder&
+	{
+		if (bank == 0 ? address >= 2 * BANK_SIZE : (address < BANK_SIZE || address >= 2 * BANK_SIZE || bank * BANK_SIZE >= rom_.size())) {
+			throw std::invalid_argument("Address " + std::to_string(address) + " is not in bank " + std::to_string(bank));
+		}
+		position_ = bank == 0 ? address : bank * BANK_SIZE + address - BANK_SIZE;
+		return *this;
+	}
+
+	auto bytes(const std::vector<uint8_t>& values) -> RomBuilder&
+	{
+		for (const auto& value : values) {
+			if (position_ >= rom_.size() || written_[position_]) {
+				throw std::invalid_argument("Code overlaps or runs out of the ROM at offset " + std::to_string(position_));
+			}
+			written_[position_] = true;
+			rom_[position_++] = value;
+		}
+		return *this;
+	}
+
+	auto fill(const size_t& count, const uint8_t& value) -> RomBuilder&
+	{
+		return bytes(std::vector<uint8_t>(count, value));
+	}
+
+	// Names the current address
+	auto label(const std::string& name) -> RomBuilder&
+	{
+		if (!labels_.emplace(name, address()).second) {
+			throw std::invalid_argument("Label " + name + " is defined twice");
+		}
+		return *this;
+	}
+
+	auto jp(const std::string& target) -> RomBuilder&
+	{
+		return absolute(0xc3, target);
+	}
+
+	auto call(const std::string& target) -> RomBuilder&
+	{
+		return absolute(0xcd, target);
+	}
+
+	auto jr(const std::string& target) -> RomBuilder&
+	{
+		return relative(0x18, target);
+	}
+
+	auto jr_nz(const std::string& target) -> RomBuilder&
+	{
+		return relative(0x20, target);
+	}
+
+	auto jr_z(const std::string& target) -> RomBuilder&
+	{
+		return relative(0x28, target);
+	}
+
+	// Any instruction with a 16 bit operand, e.g. 0x21 (ld hl, nn) with a label of data
+	auto absolute(const uint8_t& opcode, const std::string& target) -> RomBuilder&
+	{
+		bytes({opcode});
+		fixups_.push_back({position_, target, false});
+		return bytes({0x00, 0x00});
+	}
+
+	// Any instruction with an 8 bit relative jump
+	auto relative(const uint8_t& opcode, const std::string& target) -> RomBuilder&
+	{
+		bytes({opcode});
+		fixups_.push_back({position_, target, true});
+		return bytes({0x00});
+	}
+
+	// CPU address of the next byte
+	[[nodiscard]] auto address() const -> uint16_t
+	{
+		return static_cast<uint16_t>(position_ < BANK_SIZE ? position_ : BANK_SIZE + position_ % BANK_SIZE);
+	}
+
+	[[nodiscard]] auto build() const -> std::vector<uint8_t>
+	{
+		auto rom = rom_;
+
+		for (const auto& [offset, target, relative] : fixups_) {
+			const auto it = labels_.find(target);
+			if (it == end(labels_)) {
+				throw std::invalid_argument("Label " + target + " is not defined");
+			}
+
+			if (relative) {
+				// Relative to the address after the operand, same bank as the jump
+				const auto from = static_cast<int>(offset < BANK_SIZE ? offset : BANK_SIZE + offset % BANK_SIZE) + 1;
+				const auto distance = static_cast<int>(it->second) - from;
+				if (distance < -128 || distance > 127) {
+					throw std::invalid_argument("Label " + target + " is too far for a relative jump");
+				}
+				rom[offset] = static_cast<uint8_t>(distance);
+			}
+			else {
+				rom[offset] = static_cast<uint8_t>(it->second & 0xff);
+				rom[offset + 1] = static_cast<uint8_t>(it->second >> 8);
+			}
+		}
+
+		auto checksum = uint8_t{0};
+		for (auto i = 0x134; i <= 0x14c; ++i) { checksum = static_cast<uint8_t>(checksum - rom[i] - 1); }
+		rom[0x14d] = checksum;
+
+		return rom;
+	}
+
+	auto write(const std::string& path) const -> void
+	{
+		const auto rom = build();
+		auto file = std::ofstream(path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(rom.data()), static_cast<std::streamsize>(rom.size()));
+		if (!file) {
+			throw std::runtime_error("Can't write " + path);
+		}
+	}
+
+private:
+	struct Fixup {
+		size_t offset = {};
+		std::string target = {};
+		bool relative = {};
+	};
+
+	std::vector<uint8_t> rom_ = {};
+	std::vector<bool> written_ = {};
+	size_t position_ = {};
+	std::map<std::string, uint16_t> labels_ = {};
+	std::vector<Fixup> fixups_ = {};
+};
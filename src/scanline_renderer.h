@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+struct Sprite {
+	uint8_t tile_number = {};
+	bool render_priority = {};
+	bool y_flip = {};
+	bool x_flip = {};
+	std::array<uint8_t, 4> colors = {};
+
+	int16_t pos_x = {};
+	int16_t pos_y = {};
+};
+
+// Composes background, window and sprites of one scanline into a line of shades (0-3).
+// Source is anything providing direct_read() of VRAM, OAM and LCD registers - Memory itself or a recorded copy of it.
+class ScanlineRenderer {
+public:
+	template<typename Source>
+	auto render(const Source& src, const uint8_t& scanline, uint8_t* line) -> void
+	{
+		const auto lcdc = src.direct_read(0xff40);
+		const auto colors = get_palette_colors(src.direct_read(0xff47));
+		const auto tile_data = ((lcdc >> 4) & 1) ? 0x8000 : 0x8800;
+
+		if (lcdc & 0x1) {
+			const auto SCY = src.direct_read(0xff42);
+			const auto SCX = src.direct_read(0xff43);
+			const auto tile_map = (((lcdc >> 3) & 1) == 1) ? 0x9c00 : 0x9800;
+
+			const auto pos_y = (scanline + SCY) % 256;
+
+			for (auto x = 0; x < 160; ++x) {
+				const auto pixel = get_tile_pixel(src, tile_map, tile_data, (x + SCX) % 256, pos_y);
+				line_raw_colors_[x] = pixel;
+				line[x] = colors[pixel];
+			}
+		}
+		else {
+			std::fill(begin(line_raw_colors_), end(line_raw_colors_), 0);
+			std::fill(line, line + 160, 0);
+		}
+
+		// Window covers the rest of the line from its left edge, sprites are not drawn over it
+		auto window_start = 160;
+
+		const auto window_y = src.direct_read(0xff4a);
+		const auto window_x = src.direct_read(0xff4b) - 0x7;
+
+		if ((lcdc & (1 << 5)) && window_y <= scanline) {
+			const auto tile_map = ((lcdc >> 6 & 1) == 1) ? 0x9c00 : 0x9800;
+			const auto pos_y = scanline - window_y;
+
+			window_start = std::max(0, window_x);
+			for (auto x = window_start; x < 160; ++x) {
+				const auto pixel = get_tile_pixel(src, tile_map, tile_data, x - window_x, pos_y);
+				line_raw_colors_[x] = pixel;
+				line[x] = colors[pixel];
+			}
+		}
+
+		// Objects enabled
+		if (lcdc & (1 << 1)) {
+			render_sprites(src, scanline, line, window_start);
+		}
+	}
+
+private:
+	template<typename Source>
+	auto render_sprites(const Source& src, const uint8_t& scanline, uint8_t* line, const int& window_start) -> void
+	{
+		auto sprites = std::array<Sprite, 80>{};
+		const auto count = get_scanline_sprites(src, scanline, sprites);
+
+		// Sprites are ordered by x, the first one with non-transparent pixel owns it even if it's hidden under background
+		auto taken = std::array<bool, 160>{};
+
+		for (auto i = size_t{0}; i < count; ++i) {
+			const auto& s = sprites[i];
+			const auto pixel_y = scanline - s.pos_y;
+			const auto row = load_tile_row(src, 0x8000 + s.tile_number * 0x10, s.y_flip ? 7 - pixel_y : pixel_y, s.x_flip);
+
+			for (auto x = std::max(0, static_cast<int>(s.pos_x)); x < std::min(s.pos_x + 8, 160); ++x) {
+				const auto pixel_val = row[x - s.pos_x];
+				if (pixel_val == 0 || taken[x]) {
+					continue;
+				}
+				taken[x] = true;
+
+				if (x < window_start && (!s.render_priority || line_raw_colors_[x] == 0)) {
+					line[x] = s.colors[pixel_val];
+				}
+			}
+		}
+	}
+
+	// Fills sprites visible on the scanline, returns how many of them should be drawn (at most 10 with the lowest x)
+	template<typename Source>
+	static auto get_scanline_sprites(const Source& src, const uint8_t& scanline, std::array<Sprite, 80>& sprites) -> size_t
+	{
+		auto count = size_t{0};
+
+		const auto large_sprites = src.direct_read(0xff40) & (1 << 2);
+		const auto is_visible = [scanline](const auto& s) {
+			return s.pos_x + 7 >= 0 && s.pos_x < 160 && s.pos_y + 7 >= scanline && s.pos_y <= scanline;
+		};
+
+		for (auto sprite = 0; sprite < 40; ++sprite) {
+			const auto index = sprite * 4;
+			const auto attrs_raw = src.direct_read(0xfe00 + index + 3);
+			const auto palette_address = (attrs_raw & (1 << 4)) ? 0xff49 : 0xff48;
+
+			const auto s = Sprite{
+			  .tile_number = src.direct_read(0xfe00 + index + 2),
+			  .render_priority = static_cast<bool>(attrs_raw & (1 << 7)),
+			  .y_flip = static_cast<bool>(attrs_raw & (1 << 6)),
+			  .x_flip = static_cast<bool>(attrs_raw & (1 << 5)),
+			  .colors = get_palette_colors(src.direct_read(palette_address)),
+			  .pos_x = static_cast<int16_t>(src.direct_read(0xfe00 + index + 1) - 0x8),
+			  .pos_y = static_cast<int16_t>(src.direct_read(0xfe00 + index) - 0x10),
+			};
+
+			if (is_visible(s)) {
+				sprites[count++] = s;
+			}
+
+			if (large_sprites) {
+				auto sprite2 = s;
+				++sprite2.tile_number;
+				sprite2.pos_y += 8;
+				if (is_visible(sprite2)) {
+					sprites[count++] = sprite2;
+				}
+			}
+		}
+
+		// Stable insertion sort by X, std::stable_sort would allocate a buffer on every scanline
+		for (auto i = size_t{1}; i < count; ++i) {
+			const auto sprite = sprites[i];
+			auto j = i;
+			for (; j > 0 && sprites[j - 1].pos_x > sprite.pos_x; --j) {
+				sprites[j] = sprites[j - 1];
+			}
+			sprites[j] = sprite;
+		}
+
+		return std::min(count, size_t{10});
+	}
+
+	static auto get_palette_colors(const uint8_t& palette) -> std::array<uint8_t, 4>
+	{
+		return {
+		  static_cast<uint8_t>(palette & 0x3),
+		  static_cast<uint8_t>((palette & 0xc) >> 2),
+		  static_cast<uint8_t>((palette & 0x30) >> 4),
+		  static_cast<uint8_t>((palette & 0xc0) >> 6),
+		};
+	}
+
+	template<typename Source>
+	static auto get_tile_pixel(const Source& src, const int& tile_map, const int& tile_data, const int& pos_x, const int& pos_y)
+	  -> uint8_t
+	{
+		const auto tile_index = tile_map + pos_y / 8 * 32 + pos_x / 8;
+		const auto tile_id = src.direct_read(tile_index);
+		const auto tile_address = tile_data == 0x8000
+		  ? (0x8000 + tile_id * 0x10)
+		  : ((tile_id < 128 ? 0x9000 + tile_id * 0x10 : 0x8800 + (tile_id - 128) * 0x10));
+
+		const auto first_byte = src.direct_read(tile_address + (pos_y % 8) * 2 + 1);
+		const auto second_byte = src.direct_read(tile_address + (pos_y % 8) * 2 + 0);
+
+		const auto first_bit = static_cast<bool>(first_byte & (1 << (7 - pos_x % 8)));
+		const auto second_bit = static_cast<bool>(second_byte & (1 << (7 - pos_x % 8)));
+
+		return static_cast<uint8_t>((static_cast<uint8_t>(first_bit) << 1) + second_bit);
+	}
+
+	template<typename Source>
+	static auto load_tile_row(const Source& src, const uint16_t& addr, const int& row, const bool& x_flip) -> std::array<uint8_t, 8>
+	{
+		auto pixels = std::array<uint8_t, 8>{};
+
+		const auto first_byte = src.direct_read(addr + row * 2 + 1);
+		const auto second_byte = src.direct_read(addr + row * 2 + 0);
+
+		for (auto x = 0; x < 8; ++x) {
+			const auto bit = x_flip ? x : 7 - x;
+			pixels[x] = static_cast<uint8_t>((((first_byte >> bit) & 1) << 1) + ((second_byte >> bit) & 1));
+		}
+
+		return pixels;
+	}
+
+	// Raw (pre-palette) background color of the scanline being rendered, sprites need it for their priority
+	std::array<uint8_t, 160> line_raw_colors_ = {};
+};
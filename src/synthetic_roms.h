@@ -0,0 +1,170 @@
+#pragma once
+
+#include "rom_builder.h"
+
+// Small generated ROMs stressing one hot path each, for benchmarks that can't ship commercial ROMs. They loop forever
+// and don't depend on anything but the emulated machine, so every run is the same.
+struct SyntheticRom {
+	std::string name = {};
+	std::string description = {};
+	std::vector<uint8_t> rom = {};
+};
+
+// ld a, 0xe4; ldh (0x47), a; ldh (0x48), a - shades 0-3 for BG and sprites
+inline auto synthetic_set_palettes(RomBuilder& builder) -> void
+{
+	builder.bytes({0x3e, 0xe4, 0xe0, 0x47, 0xe0, 0x48});
+}
+
+// Tile 0 (BG) and tile 1 (sprites) get a visible pattern
+inline auto synthetic_fill_tiles(RomBuilder& builder) -> void
+{
+	// ld hl, 0x8000; ld b, 32; ld a, 0x0f
+	builder.bytes({0x21, 0x00, 0x80, 0x06, 0x20, 0x3e, 0x0f}).label("fill_tiles");
+	// ld (hl+), a; rlca; dec b
+	builder.bytes({0x22, 0x07, 0x05}).jr_nz("fill_tiles");
+}
+
+inline auto synthetic_alu_loop() -> SyntheticRom
+{
+	auto builder = RomBuilder{};
+	synthetic_set_palettes(builder);
+	// ld b, 0xff
+	builder.label("outer").bytes({0x06, 0xff});
+	// add a, c; xor d; rlca; inc c; sub e; and 0x7f; or b; adc a, h; swap a; dec b
+	builder.label("inner").bytes({0x81, 0xaa, 0x07, 0x0c, 0x93, 0xe6, 0x7f, 0xb0, 0x8c, 0xcb, 0x37, 0x05}).jr_nz("inner");
+	// inc d; inc e
+	builder.bytes({0x14, 0x1c}).jr("outer");
+	return {"alu_loop", "8 bit arithmetic and logic in a tight loop", builder.build()};
+}
+
+inline auto synthetic_memcpy_loop() -> SyntheticRom
+{
+	auto builder = RomBuilder{};
+	synthetic_set_palettes(builder);
+	// ld hl, 0x0000; ld de, 0xc000; ld bc, 0x1000 - ROM into WRAM
+	builder.label("copy_rom").bytes({0x21, 0x00, 0x00, 0x11, 0x00, 0xc0, 0x01, 0x00, 0x10});
+	// ld a, (hl+); ld (de), a; inc de; dec bc; ld a, b; or c
+	builder.label("rom_byte").bytes({0x2a, 0x12, 0x13, 0x0b, 0x78, 0xb1}).jr_nz("rom_byte");
+	// ld hl, 0xc000; ld de, 0xd000; ld bc, 0x0800 - WRAM into WRAM
+	builder.bytes({0x21, 0x00, 0xc0, 0x11, 0x00, 0xd0, 0x01, 0x00, 0x08});
+	builder.label("ram_byte").bytes({0x2a, 0x12, 0x13, 0x0b, 0x78, 0xb1}).jr_nz("ram_byte");
+	builder.jp("copy_rom");
+	return {"memcpy_loop", "Byte copies from ROM to WRAM and within WRAM", builder.build()};
+}
+
+inline auto synthetic_halt_vblank() -> SyntheticRom
+{
+	auto builder = RomBuilder{};
+	// VBlank handler: reti
+	builder.org(0x40).bytes({0xd9}).org(0x150);
+	synthetic_set_palettes(builder);
+	// ld hl, 0xc000; ld a, 0x01; ldh (0xff), a; ei
+	builder.bytes({0x21, 0x00, 0xc0, 0x3e, 0x01, 0xe0, 0xff, 0xfb});
+	// halt; inc (hl)
+	builder.label("wait").bytes({0x76, 0x34}).jr("wait");
+	return {"halt_vblank", "Waits for VBlank in HALT, the CPU is idle most of the time", builder.build()};
+}
+
+inline auto synthetic_sprite_scene() -> SyntheticRom
+{
+	auto builder = RomBuilder{};
+	builder.org(0x40).bytes({0xd9}).org(0x150);
+	synthetic_set_palettes(builder);
+	synthetic_fill_tiles(builder);
+
+	// 40 sprites overlapping on most lines, table at 0xc100 for DMA: y = 16 + 3i, x = 8 + 4i, tile 1
+	// ld hl, 0xc100; ld b, 40; ld c, 16; ld d, 8
+	builder.bytes({0x21, 0x00, 0xc1, 0x06, 0x28, 0x0e, 0x10, 0x16, 0x08});
+	// ld a, c; ld (hl+), a; ld a, d; ld (hl+), a; ld a, 1; ld (hl+), a; xor a; ld (hl+), a
+	builder.label("sprite").bytes({0x79, 0x22, 0x7a, 0x22, 0x3e, 0x01, 0x22, 0xaf, 0x22});
+	// ld a, c; add a, 3; ld c, a; ld a, d; add a, 4; ld d, a; dec b
+	builder.bytes({0x79, 0xc6, 0x03, 0x4f, 0x7a, 0xc6, 0x04, 0x57, 0x05}).jr_nz("sprite");
+
+	// LCD on, tile data at 0x8000, sprites and BG on; VBlank interupt
+	// ld a, 0x93; ldh (0x40), a; ld a, 0x01; ldh (0xff), a; ei
+	builder.bytes({0x3e, 0x93, 0xe0, 0x40, 0x3e, 0x01, 0xe0, 0xff, 0xfb});
+
+	// Every frame all sprites move right and the table is copied into OAM
+	// halt; ld hl, 0xc101; ld b, 40
+	builder.label("frame").bytes({0x76, 0x21, 0x01, 0xc1, 0x06, 0x28});
+	// inc (hl); ld a, l; add a, 4; ld l, a; dec b
+	builder.label("move").bytes({0x34, 0x7d, 0xc6, 0x04, 0x6f, 0x05}).jr_nz("move");
+	// ld a, 0xc1; ldh (0x46), a
+	builder.bytes({0x3e, 0xc1, 0xe0, 0x46}).jr("frame");
+	return {"sprite_scene", "40 moving sprites, more than 10 on most lines, OAM DMA every frame", builder.build()};
+}
+
+inline auto synthetic_scx_raster() -> SyntheticRom
+{
+	auto builder = RomBuilder{};
+	// VBlank: push af; ldh a, (0x42); inc a; ldh (0x42), a; pop af; reti - SCY scrolls every frame
+	builder.org(0x40).bytes({0xf5, 0xf0, 0x42, 0x3c, 0xe0, 0x42, 0xf1, 0xd9});
+	// STAT (HBlank): push af; ldh a, (0x44); ldh (0x43), a; pop af; reti - SCX follows LY
+	builder.org(0x48).bytes({0xf5, 0xf0, 0x44, 0xe0, 0x43, 0xf1, 0xd9}).org(0x150);
+	synthetic_set_palettes(builder);
+	synthetic_fill_tiles(builder);
+
+	// ld a, 0x08; ldh (0x41), a; ld a, 0x03; ldh (0xff), a; ei
+	builder.bytes({0x3e, 0x08, 0xe0, 0x41, 0x3e, 0x03, 0xe0, 0xff, 0xfb});
+	// halt
+	builder.label("wait").bytes({0x76}).jr("wait");
+	return {"scx_raster", "SCX rewritten in every HBlank interupt, SCY every frame", builder.build()};
+}
+
+inline auto synthetic_mbc_switching() -> SyntheticRom
+{
+	constexpr auto banks = size_t{4};
+	auto builder = RomBuilder{0x01, banks};
+
+	// Every switchable bank is filled with its number
+	for (auto bank = size_t{1}; bank < banks; ++bank) { builder.org(0x4000, bank).fill(RomBuilder::BANK_SIZE, static_cast<uint8_t>(bank)); }
+	builder.org(0x150);
+
+	// ld c, 1
+	builder.label("banks").bytes({0x0e, 0x01});
+	// ld a, c; ld (0x2000), a; ld hl, 0x4000; ld b, 64
+	builder.label("bank").bytes({0x79, 0xea, 0x00, 0x20, 0x21, 0x00, 0x40, 0x06, 0x40});
+	// ld a, (hl+); add a, d; ld d, a; dec b
+	builder.label("sum").bytes({0x2a, 0x82, 0x57, 0x05}).jr_nz("sum");
+	// inc c; ld a, c; cp 4
+	builder.bytes({0x0c, 0x79, 0xfe, static_cast<uint8_t>(banks)}).jr_nz("bank");
+	builder.jr("banks");
+	return {"mbc_switching", "MBC1 ROM bank switches with reads from every bank", builder.build()};
+}
+
+inline auto synthetic_timer_storm() -> SyntheticRom
+{
+	auto builder = RomBuilder{};
+	// Timer: push af; ldh a, (0x80); inc a; ldh (0x80), a; pop af; reti
+	builder.org(0x50).bytes({0xf5, 0xf0, 0x80, 0x3c, 0xe0, 0x80, 0xf1, 0xd9}).org(0x150);
+	synthetic_set_palettes(builder);
+
+	// Fastest timer overflowing every 16 ticks
+	// ld a, 0xf0; ldh (0x06), a; ld a, 0x05; ldh (0x07), a; ld a, 0x04; ldh (0xff), a; ei
+	builder.bytes({0x3e, 0xf0, 0xe0, 0x06, 0x3e, 0x05, 0xe0, 0x07, 0x3e, 0x04, 0xe0, 0xff, 0xfb});
+	// inc b
+	builder.label("busy").bytes({0x04}).jr("busy");
+	return {"timer_storm", "Timer interupts as often as the timer can overflow", builder.build()};
+}
+
+inline auto synthetic_serial_writer() -> SyntheticRom
+{
+	auto builder = RomBuilder{};
+	synthetic_set_palettes(builder);
+	// ld a, c; ldh (0x01), a; ld a, 0x81; ldh (0x02), a; inc c - a byte counting up sent on every pass
+	builder.label("byte").bytes({0x79, 0xe0, 0x01, 0x3e, 0x81, 0xe0, 0x02, 0x0c}).jr("byte");
+	return {"serial_writer", "Serial transfers back to back, far more output than is kept", builder.build()};
+}
+
+inline auto synthetic_roms() -> std::vector<SyntheticRom>
+{
+	return {synthetic_alu_loop(),
+	  synthetic_memcpy_loop(),
+	  synthetic_halt_vblank(),
+	  synthetic_sprite_scene(),
+	  synthetic_scx_raster(),
+	  synthetic_mbc_switching(),
+	  synthetic_timer_storm(),
+	  synthetic_serial_writer()};
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Runs a batch of indexed tasks on persistent threads. Every worker starts with an equal share of the batch in its
+// own queue and steals from the others once it's done, so uneven tasks (one game lagging, another halted) don't
+// leave threads idle.
+class WorkStealingPool {
+public:
+	explicit WorkStealingPool(const size_t& threads = std::max(size_t{1}, size_t{std::thread::hardware_concurrency()}))
+	  : queues_(std::max(threads, size_t{1}))
+	{
+		for (auto id = size_t{0}; id < queues_.size(); ++id) {
+			workers_.emplace_back([this, id] { work(id); });
+		}
+	}
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	auto operator=(const WorkStealingPool&) -> WorkStealingPool& = delete;
+
+	~WorkStealingPool()
+	{
+		{
+			const auto lock = std::scoped_lock{mutex_};
+			quit_ = true;
+		}
+		wake_.notify_all();
+		for (auto& worker : workers_) { worker.join(); }
+	}
+
+	// Calls task(i) for every i in [0, count) and returns when all of them are done.
+	// The first exception thrown by a task is rethrown here, remaining tasks still run.
+	auto run(const size_t& count, const std::function<void(size_t)>& task) -> void
+	{
+		if (count == 0) {
+			return;
+		}
+
+		{
+			const auto lock = std::scoped_lock{mutex_};
+			task_ = &task;
+			error_ = nullptr;
+			remaining_ = count;
+
+			for (auto id = size_t{0}; id < queues_.size(); ++id) {
+				auto& queue = queues_[id];
+				const auto queue_lock = std::scoped_lock{queue.mutex};
+				for (auto index = id * count / queues_.size(); index < (id + 1) * count / queues_.size(); ++index) {
+					queue.tasks.push_back(index);
+				}
+			}
+			++generation_;
+		}
+		wake_.notify_all();
+
+		auto lock = std::unique_lock{mutex_};
+		done_.wait(lock, [this] { return remaining_ == 0; });
+
+		if (error_) {
+			std::rethrow_exception(error_);
+		}
+	}
+
+	[[nodiscard]] auto size() const -> size_t
+	{
+		return workers_.size();
+	}
+
+private:
+	struct WorkQueue {
+		std::mutex mutex = {};
+		std::deque<size_t> tasks = {};
+	};
+
+	auto work(const size_t& id) -> void
+	{
+		auto seen_generation = uint64_t{0};
+
+		while (true) {
+			{
+				auto lock = std::unique_lock{mutex_};
+				wake_.wait(lock, [&] { return quit_ || generation_ != seen_generation; });
+				if (quit_) {
+					return;
+				}
+				seen_generation = generation_;
+			}
+
+			while (const auto index = next_task(id)) {
+				try {
+					(*task_)(*index);
+				}
+				catch (...) {
+					const auto lock = std::scoped_lock{mutex_};
+					if (!error_) {
+						error_ = std::current_exception();
+					}
+				}
+
+				if (remaining_.fetch_sub(1) == 1) {
+					const auto lock = std::scoped_lock{mutex_};
+					done_.notify_all();
+				}
+			}
+		}
+	}
+
+	// Own tasks are taken from the front, stolen ones from the back of the victim's queue
+	auto next_task(const size_t& id) -> std::optional<size_t>
+	{
+		for (auto i = size_t{0}; i < queues_.size(); ++i) {
+			auto& queue = queues_[(id + i) % queues_.size()];
+			const auto lock = std::scoped_lock{queue.mutex};
+			if (queue.tasks.empty()) {
+				continue;
+			}
+
+			auto index = size_t{};
+			if (i == 0) {
+				index = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			else {
+				index = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+			return index;
+		}
+		return std::nullopt;
+	}
+
+	std::vector<WorkQueue> queues_;
+
+	// Guarded by mutex_
+	const std::function<void(size_t)>* task_ = {};
+	std::exception_ptr error_ = {};
+	uint64_t generation_ = {};
+	bool quit_ = {};
+
+	std::atomic<size_t> remaining_ = {};
+
+	std::mutex mutex_ = {};
+	std::condition_variable wake_ = {};
+	std::condition_variable done_ = {};
+
+	std::vector<std::thread> workers_ = {};
+};
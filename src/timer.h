@@ -1,11 +1,20 @@
 #pragma once
 
+#include "trace.h"
+
 class Timer {
 public:
 	const uint64_t CPU_FREQUENCY = 4'194'304 / 4;
 	const uint64_t DIV_REGISTER_FREQUENCY = 16'384;
 	const uint64_t DIV_REGISTER_CYCLES_PER_UPDATE = CPU_FREQUENCY / DIV_REGISTER_FREQUENCY;
 
+	struct State {
+		uint64_t div_register_cycles = {};
+		uint64_t timer_counter_cycles = {};
+
+		auto operator==(const State&) const -> bool = default;
+	};
+
 	// Inspiration: http://emudev.de/gameboy-emulator/interrupts-and-timers/
 	auto update(Memory& memory, const uint64_t& new_cycles)
 	{
@@ -44,6 +53,7 @@ public:
 
 					const auto TMA = memory.read(0xff06);
 					memory.write(0xff05, TMA);
+					GRAYBOY_TRACE_INSTANT("timer_overflow", TMA);
 				}
 
 				timer_counter_cycles_ -= timer_counter_cycles_per_update;
@@ -51,6 +61,17 @@ public:
 		}
 	}
 
+	auto save_state(State& state) const -> void
+	{
+		state = {.div_register_cycles = div_register_cycles_, .timer_counter_cycles = timer_counter_cycles_};
+	}
+
+	auto load_state(const State& state) -> void
+	{
+		div_register_cycles_ = state.div_register_cycles;
+		timer_counter_cycles_ = state.timer_counter_cycles;
+	}
+
 private:
 	uint64_t div_register_cycles_ = {};
 	uint64_t timer_counter_cycles_ = {};
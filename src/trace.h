@@ -0,0 +1,229 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Tracepoints around frames, scanlines, interupts, DMA, bank switches and presentation, written as a Chrome trace
+// (chrome://tracing, ui.perfetto.dev). Only built with TRACEPOINTS (GRAYBOY_TRACEPOINTS), otherwise the macros at
+// the bottom expand to nothing and not even their arguments are evaluated.
+//
+// Every thread records into its own ring, a background thread drains the rings into grayboy_trace.json (or the file
+// in GRAYBOY_TRACE) and the file is completed at exit.
+
+struct TraceEvent {
+	// String literal, only the pointer is stored
+	const char* name = {};
+	uint64_t start_ns = {};
+	uint64_t duration_ns = {};
+	uint64_t value = {};
+	bool instant = {};
+};
+
+// Nanoseconds since the first tracepoint
+[[nodiscard]] inline auto trace_now() -> uint64_t
+{
+	static const auto epoch = std::chrono::steady_clock::now();
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+// Single producer, single consumer. When the consumer falls behind, new events are dropped and counted.
+class TraceRing {
+public:
+	static constexpr size_t CAPACITY = 1 << 16;
+
+	explicit TraceRing(const uint32_t& thread_id) : thread_id_{thread_id} {}
+
+	auto push(const TraceEvent& event) -> void
+	{
+		const auto head = head_.load(std::memory_order_relaxed);
+		// The consumer's position is read only when the ring looks full, so the cache line isn't shared on every push
+		if (head - cached_tail_ == CAPACITY) {
+			cached_tail_ = tail_.load(std::memory_order_acquire);
+			if (head - cached_tail_ == CAPACITY) {
+				dropped_.store(dropped_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return;
+			}
+		}
+		events_[head % CAPACITY] = event;
+		head_.store(head + 1, std::memory_order_release);
+	}
+
+	template<typename Consumer>
+	auto drain(Consumer&& consume) -> void
+	{
+		auto tail = tail_.load(std::memory_order_relaxed);
+		const auto head = head_.load(std::memory_order_acquire);
+		for (; tail != head; ++tail) { consume(events_[tail % CAPACITY]); }
+		tail_.store(tail, std::memory_order_release);
+	}
+
+	[[nodiscard]] auto thread_id() const -> uint32_t
+	{
+		return thread_id_;
+	}
+
+	[[nodiscard]] auto dropped() const -> uint64_t
+	{
+		return dropped_.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::array<TraceEvent, CAPACITY> events_ = {};
+	alignas(64) std::atomic<uint64_t> head_ = {};
+	uint64_t cached_tail_ = {};
+	std::atomic<uint64_t> dropped_ = {};
+	alignas(64) std::atomic<uint64_t> tail_ = {};
+	uint32_t thread_id_ = {};
+};
+
+// One event of the JSON array format, scopes are complete ("X") events with their duration
+[[nodiscard]] inline auto trace_event_json(const TraceEvent& event, const uint32_t& thread_id) -> std::string
+{
+	// Microseconds with nanosecond precision, formatted without floating point
+	const auto start_us = event.start_ns / 1000;
+	const auto start_fraction = static_cast<unsigned>(event.start_ns % 1000);
+
+	auto buffer = std::array<char, 256>{};
+	const auto length = event.instant
+	  ? std::snprintf(buffer.data(), buffer.size(), R"({"name": "%s", "ph": "i", "ts": %llu.%03u, "s": "t", "args": {"value": %llu}, "pid": 1, "tid": %u})",
+	      event.name, static_cast<unsigned long long>(start_us), start_fraction, static_cast<unsigned long long>(event.value), thread_id)
+	  : std::snprintf(buffer.data(), buffer.size(), R"({"name": "%s", "ph": "X", "ts": %llu.%03u, "dur": %llu.%03u, "pid": 1, "tid": %u})",
+	      event.name, static_cast<unsigned long long>(start_us), start_fraction, static_cast<unsigned long long>(event.duration_ns / 1000),
+	      static_cast<unsigned>(event.duration_ns % 1000), thread_id);
+	return std::string(buffer.data(), static_cast<size_t>(std::clamp(length, 0, static_cast<int>(buffer.size()) - 1)));
+}
+
+// Owns the rings of all threads and the thread writing them into the file
+class Tracer {
+public:
+	static constexpr auto FLUSH_INTERVAL = std::chrono::milliseconds{10};
+
+	explicit Tracer(const std::string& path) : file_{path}
+	{
+		file_ << "[\n";
+		flusher_ = std::thread{[this] { flush_periodically(); }};
+	}
+
+	Tracer(const Tracer&) = delete;
+	auto operator=(const Tracer&) -> Tracer& = delete;
+
+	~Tracer()
+	{
+		{
+			const auto lock = std::scoped_lock{mutex_};
+			quit_ = true;
+		}
+		wake_.notify_all();
+		flusher_.join();
+
+		flush();
+		file_ << "\n]\n";
+
+		auto dropped = uint64_t{0};
+		for (const auto& ring : rings_) { dropped += ring->dropped(); }
+		if (dropped > 0) {
+			std::cerr << "Trace: " << dropped << " events dropped, the writer couldn't keep up\n";
+		}
+	}
+
+	// The tracer of tracepoints, created by the first one
+	static auto instance() -> Tracer&
+	{
+		static auto tracer = Tracer{std::getenv("GRAYBOY_TRACE") != nullptr ? std::getenv("GRAYBOY_TRACE") : "grayboy_trace.json"};
+		return tracer;
+	}
+
+	// The ring stays alive after its thread ends until its events are written
+	auto add_ring() -> std::shared_ptr<TraceRing>
+	{
+		const auto lock = std::scoped_lock{rings_mutex_};
+		rings_.push_back(std::make_shared<TraceRing>(static_cast<uint32_t>(rings_.size() + 1)));
+		return rings_.back();
+	}
+
+private:
+	auto flush_periodically() -> void
+	{
+		auto lock = std::unique_lock{mutex_};
+		while (!wake_.wait_for(lock, FLUSH_INTERVAL, [this] { return quit_; })) { flush(); }
+	}
+
+	auto flush() -> void
+	{
+		const auto lock = std::scoped_lock{rings_mutex_};
+		for (const auto& ring : rings_) {
+			ring->drain([&](const TraceEvent& event) {
+				file_ << (first_ ? "" : ",\n") << trace_event_json(event, ring->thread_id());
+				first_ = false;
+			});
+		}
+		file_.flush();
+	}
+
+	std::ofstream file_ = {};
+	bool first_ = true;
+
+	std::mutex rings_mutex_ = {};
+	std::vector<std::shared_ptr<TraceRing>> rings_ = {};
+
+	std::mutex mutex_ = {};
+	std::condition_variable wake_ = {};
+	bool quit_ = {};
+	std::thread flusher_ = {};
+};
+
+[[nodiscard]] inline auto trace_ring() -> TraceRing&
+{
+	thread_local const auto ring = Tracer::instance().add_ring();
+	return *ring;
+}
+
+// Records the time from its construction to its destruction
+class TraceScope {
+public:
+	explicit TraceScope(const char* name) : name_{name}, start_{trace_now()} {}
+
+	TraceScope(const TraceScope&) = delete;
+	auto operator=(const TraceScope&) -> TraceScope& = delete;
+
+	~TraceScope()
+	{
+		trace_ring().push({name_, start_, trace_now() - start_, 0, false});
+	}
+
+private:
+	const char* name_ = {};
+	uint64_t start_ = {};
+};
+
+inline auto trace_instant(const char* name, const uint64_t& value) -> void
+{
+	trace_ring().push({name, trace_now(), 0, value, true});
+}
+
+#define GRAYBOY_TRACE_CONCAT_(a, b) a##b
+#define GRAYBOY_TRACE_CONCAT(a, b) GRAYBOY_TRACE_CONCAT_(a, b)
+
+#if defined(GRAYBOY_TRACEPOINTS)
+#define GRAYBOY_TRACEPOINTS_ENABLED true
+// Times the rest of the enclosing block
+#define GRAYBOY_TRACE_SCOPE(name) const auto GRAYBOY_TRACE_CONCAT(trace_scope_, __LINE__) = TraceScope{name}
+#define GRAYBOY_TRACE_INSTANT(name, value) trace_instant(name, static_cast<uint64_t>(value))
+#else
+#define GRAYBOY_TRACEPOINTS_ENABLED false
+#define GRAYBOY_TRACE_SCOPE(name) static_cast<void>(0)
+#define GRAYBOY_TRACE_INSTANT(name, value) static_cast<void>(0)
+#endif
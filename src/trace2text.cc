@@ -0,0 +1,43 @@
+#include "instruction_trace.h"
+#include "instructions.h"
+
+#include <iostream>
+
+// Renders a binary instruction trace (grayboy --trace-instructions) as the binjgb text log
+auto main(int argc, const char** argv) -> int
+{
+	if (argc != 2 && argc != 3) {
+		std::cerr << "Usage: " << argv[0] << " trace.bin [output.log]\n";
+		return 1;
+	}
+
+	auto* out = stdout;
+	if (argc == 3) {
+		out = std::fopen(argv[2], "w");
+		if (out == nullptr) {
+			std::cerr << "Can't open " << argv[2] << '\n';
+			return 1;
+		}
+	}
+
+	try {
+		const auto instructions = get_all_instructions();
+		auto reader = InstructionTraceReader{argv[1]};
+		auto record = InstructionRecord{};
+		auto lines = std::string{};
+		while (reader.next(record)) {
+			append_binjgb_line(lines, record, instruction_record_mnemonic(record, instructions));
+			if (lines.size() > 1 << 20) {
+				std::fwrite(lines.data(), 1, lines.size(), out);
+				lines.clear();
+			}
+		}
+		std::fwrite(lines.data(), 1, lines.size(), out);
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+
+	return std::fclose(out) == 0 ? 0 : 1;
+}
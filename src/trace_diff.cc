@@ -0,0 +1,55 @@
+#include "cli_options.h"
+#include "trace_diff.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+
+// Compares emulation of a cartridge with a binjgb log of it, exits with 1 at the first difference
+auto main(int argc, const char** argv) -> int
+{
+	auto args = std::vector<std::string>(argv + 1, argv + argc);
+	auto options = TraceDiffOptions{};
+	options.compare_cycles = std::erase(args, "--no-cycles") == 0;
+	options.compare_ppu_mode = std::erase(args, "--no-ppu") == 0;
+	const auto context = take_option(args, "--context");
+	const auto limit = take_option(args, "--limit");
+
+	const auto usage = [&] {
+		std::cout << "Usage: " << argv[0] << " [--context lines] [--limit instructions] [--no-cycles] [--no-ppu] cartridge_filename binjgb.log\n";
+		return 1;
+	};
+	if (args.size() != 2) {
+		return usage();
+	}
+
+	try {
+		const auto max = std::numeric_limits<unsigned long>::max();
+		options.context = context ? parse_number("--context", *context, 0, max) : options.context;
+		options.max_instructions = limit ? parse_number("--limit", *limit, 0, max) : options.max_instructions;
+	}
+	catch (const std::invalid_argument& e) {
+		std::cout << e.what() << '\n';
+		return usage();
+	}
+
+	try {
+		auto emulator = Emulator<true>{args[0]};
+		emulator.set_headless_rendering(true);
+		const auto log = MappedFile{args[1]};
+
+		const auto start = std::chrono::steady_clock::now();
+		const auto result = trace_diff(emulator, log.view(), options);
+		const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::cout << result.report;
+		std::cout << result.instructions << " instructions " << (result.diverged ? "matched before the divergence" : "match") << " ("
+		          << static_cast<double>(result.instructions) / seconds / 1e6 << " M/s)\n";
+		return result.diverged ? 1 : 0;
+	}
+	catch (const std::exception& e) {
+		std::cerr << e.what() << '\n';
+		return 1;
+	}
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+#include "emulator.h"
+#include "instruction_trace.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Runs the emulator in lockstep with a binjgb log (the format append_binjgb_line() in instruction_trace.h writes) and
+// stops at the first line our state differs from. The log is mapped, not read, and our side is compared as records,
+// text is only made for the context printed at a divergence.
+
+// Whole file mapped read-only, for logs far bigger than would be sensible to read into memory
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path)
+	{
+		const auto fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			throw std::runtime_error("Can't open " + path + ": " + std::strerror(errno));
+		}
+		struct stat status = {};
+		if (::fstat(fd, &status) != 0) {
+			::close(fd);
+			throw std::runtime_error("Can't stat " + path + ": " + std::strerror(errno));
+		}
+		size_ = static_cast<size_t>(status.st_size);
+
+		if (size_ > 0) {
+			data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data_ == MAP_FAILED) {
+				data_ = nullptr;
+				::close(fd);
+				throw std::runtime_error("Can't map " + path + ": " + std::strerror(errno));
+			}
+			// Read once front to back, the kernel can read ahead and drop pages behind us
+			::madvise(data_, size_, MADV_SEQUENTIAL);
+		}
+		::close(fd);
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	auto operator=(const MappedFile&) -> MappedFile& = delete;
+
+	~MappedFile()
+	{
+		if (data_ != nullptr) {
+			::munmap(data_, size_);
+		}
+	}
+
+	[[nodiscard]] auto view() const -> std::string_view
+	{
+		return {static_cast<const char*>(data_), size_};
+	}
+
+private:
+	void* data_ = {};
+	size_t size_ = {};
+};
+
+// State at the start of a binjgb log line
+struct BinjgbLine {
+	// A F B C D E H L, like InstructionRecord
+	std::array<uint8_t, 8> registers = {};
+	uint16_t SP = {};
+	uint16_t PC = {};
+	// Clock cycles
+	uint64_t cycles = {};
+	uint8_t ppu_mode = {};
+};
+
+// False if the line isn't "A:.. F:.... BC:.... DE:.... HL:.... SP:.... PC:.... (cy: N) ppu:+M|...". Called for every
+// instruction, the fixed part is checked and converted 8 bytes at a time.
+[[nodiscard]] inline auto parse_binjgb_line(const std::string_view& line, BinjgbLine& out) -> bool
+{
+	// Everything up to the cycle count has a fixed position, dots are hex digits and flags
+	static constexpr auto PREFIX = std::string_view{"A:.. F:.... BC:.... DE:.... HL:.... SP:.... PC:.... (cy: "};
+	static constexpr auto WORDS = (PREFIX.size() + 7) / 8;
+	// Expected bytes and which of them are fixed, little endian like the loads
+	static constexpr auto PATTERN = [] {
+		auto pattern = std::array<std::array<uint64_t, WORDS>, 2>{};
+		for (auto i = size_t{0}; i < PREFIX.size(); ++i) {
+			if (PREFIX[i] != '.') {
+				pattern[0][i / 8] |= uint64_t{static_cast<uint8_t>(PREFIX[i])} << (i % 8 * 8);
+				pattern[1][i / 8] |= uint64_t{0xff} << (i % 8 * 8);
+			}
+		}
+		return pattern;
+	}();
+	static constexpr auto IS_HEX = [] {
+		auto table = std::array<bool, 256>{};
+		for (auto c = 0; c < 256; ++c) { table[c] = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+		return table;
+	}();
+
+	// Everything read below is within the line
+	if (line.size() < WORDS * 8 + 8) {
+		return false;
+	}
+
+	auto mismatch = uint64_t{0};
+	for (auto i = size_t{0}; i < WORDS; ++i) {
+		auto word = uint64_t{};
+		std::memcpy(&word, line.data() + i * 8, sizeof(word));
+		mismatch |= (word ^ PATTERN[0][i]) & PATTERN[1][i];
+	}
+
+	auto valid = true;
+	// 2 or 4 digits, upper or lower case
+	const auto hex = [&](const size_t& position, const size_t& digits) {
+		auto word = uint32_t{};
+		std::memcpy(&word, line.data() + position, sizeof(word));
+		for (auto i = position; i < position + digits; ++i) { valid &= IS_HEX[static_cast<uint8_t>(line[i])]; }
+
+		// Digit values in every byte, letters have bit 6 set
+		const auto values = (word & 0x0f0f0f0f) + ((word >> 6) & 0x01010101) * 9;
+		// Pairs of digits into bytes, first digit is the high nibble
+		const auto pairs = ((values & 0x000f000f) << 4) | ((values & 0x0f000f00) >> 8);
+		return digits == 2 ? pairs & 0xff : (pairs & 0xff) << 8 | (pairs >> 16 & 0xff);
+	};
+
+	auto flags = uint8_t{0};
+	constexpr auto FLAGS = std::string_view{"ZNHC"};
+	for (auto i = size_t{0}; i < FLAGS.size(); ++i) {
+		const auto c = line[7 + i];
+		valid &= c == FLAGS[i] || c == '-';
+		flags |= static_cast<uint8_t>(c == FLAGS[i] ? 0x80 >> i : 0);
+	}
+
+	const auto BC = hex(15, 4);
+	const auto DE = hex(23, 4);
+	const auto HL = hex(31, 4);
+	out.registers = {static_cast<uint8_t>(hex(2, 2)), flags, static_cast<uint8_t>(BC >> 8), static_cast<uint8_t>(BC),
+	  static_cast<uint8_t>(DE >> 8), static_cast<uint8_t>(DE), static_cast<uint8_t>(HL >> 8), static_cast<uint8_t>(HL)};
+	out.SP = static_cast<uint16_t>(hex(39, 4));
+	out.PC = static_cast<uint16_t>(hex(47, 4));
+
+	auto position = PREFIX.size();
+	out.cycles = 0;
+	for (; position < line.size() && line[position] >= '0' && line[position] <= '9'; ++position) {
+		out.cycles = out.cycles * 10 + static_cast<uint64_t>(line[position] - '0');
+	}
+	if (position == PREFIX.size() || line.substr(position, 7) != ") ppu:+" || position + 7 >= line.size()) {
+		return false;
+	}
+	const auto mode = line[position + 7];
+	out.ppu_mode = static_cast<uint8_t>(mode - '0');
+	return mismatch == 0 && valid && mode >= '0' && mode <= '3';
+}
+
+struct TraceDiffOptions {
+	// binjgb and we may count cycles from a different start or report the PPU mode differently while it's off
+	bool compare_cycles = true;
+	bool compare_ppu_mode = true;
+	// Matching lines printed before a divergence
+	size_t context = 8;
+	// Stops after this many instructions, 0 runs the whole log
+	uint64_t max_instructions = {};
+};
+
+struct TraceDiffResult {
+	// Matching instructions
+	uint64_t instructions = {};
+	bool diverged = {};
+	// Line of the log, from 1
+	uint64_t line_number = {};
+	// Context and the fields that differ, empty without a divergence
+	std::string report = {};
+};
+
+// Names and values of the fields `record` differs from `line` in, "A 01 != 02" with the log's value first
+[[nodiscard]] inline auto trace_diff_fields(const BinjgbLine& line, const InstructionRecord& record, const TraceDiffOptions& options)
+  -> std::string
+{
+	auto fields = std::string{};
+	const auto field = [&](const char* name, const uint64_t& expected, const uint64_t& actual, const int& digits) {
+		if (expected == actual) {
+			return;
+		}
+		fields += fields.empty() ? "" : ", ";
+		fields += name;
+		fields += ' ';
+		if (digits == 0) {
+			fields += std::to_string(expected) + " != " + std::to_string(actual);
+			return;
+		}
+		append_hex(fields, static_cast<uint32_t>(expected), digits);
+		fields += " != ";
+		append_hex(fields, static_cast<uint32_t>(actual), digits);
+	};
+
+	constexpr auto NAMES = std::array{"A", "F", "B", "C", "D", "E", "H", "L"};
+	for (auto i = size_t{0}; i < NAMES.size(); ++i) { field(NAMES[i], line.registers[i], record.registers[i], 2); }
+	field("SP", line.SP, record.SP, 4);
+	field("PC", line.PC, record.PC, 4);
+	if (options.compare_cycles) {
+		field("cy", line.cycles, record.cycles * 4, 0);
+	}
+	if (options.compare_ppu_mode) {
+		field("ppu", line.ppu_mode, record.ppu_mode, 0);
+	}
+	return fields;
+}
+
+// Parses the log on its own thread, up to CHUNKS chunks of lines ahead of the emulator. The lines are handed over a
+// chunk at a time, so the threads only synchronize every CHUNK_LINES lines.
+class BinjgbLogParser {
+public:
+	static constexpr size_t CHUNK_LINES = 4096;
+	static constexpr size_t CHUNKS = 4;
+
+	struct Line {
+		BinjgbLine state = {};
+		std::string_view text = {};
+		// From 1, lines which don't start with "A:" are counted but skipped
+		uint64_t number = {};
+	};
+
+	explicit BinjgbLogParser(const std::string_view& log) : log_{log}
+	{
+		for (auto& chunk : chunks_) { chunk.resize(CHUNK_LINES); }
+		parser_ = std::thread{[this] { parse_chunks(); }};
+	}
+
+	BinjgbLogParser(const BinjgbLogParser&) = delete;
+	auto operator=(const BinjgbLogParser&) -> BinjgbLogParser& = delete;
+
+	~BinjgbLogParser()
+	{
+		{
+			const auto lock = std::scoped_lock{mutex_};
+			quit_ = true;
+		}
+		chunk_free_.notify_all();
+		parser_.join();
+	}
+
+	// Next line or nullptr at the end of the log, throws std::runtime_error at a malformed line. The line is valid until
+	// the next call, its text as long as the log.
+	auto next() -> const Line*
+	{
+		// The last chunk can be empty, when the log ends with other lines or a malformed one
+		while (position_ == size_) {
+			auto lock = std::unique_lock{mutex_};
+			// The consumed chunk goes back to the parser
+			if (taken_) {
+				++tail_;
+				chunk_free_.notify_one();
+			}
+			chunk_parsed_.wait(lock, [this] { return tail_ != head_ || done_; });
+			if (tail_ == head_) {
+				taken_ = false;
+				if (!error_.empty()) {
+					throw std::runtime_error(error_);
+				}
+				return nullptr;
+			}
+			taken_ = true;
+			position_ = 0;
+			size_ = sizes_[tail_ % CHUNKS];
+		}
+		return &chunks_[tail_ % CHUNKS][position_++];
+	}
+
+private:
+	auto parse_chunks() -> void
+	{
+		auto position = size_t{0};
+		auto number = uint64_t{0};
+		auto error = std::string{};
+		while (position < log_.size() && error.empty()) {
+			{
+				auto lock = std::unique_lock{mutex_};
+				chunk_free_.wait(lock, [this] { return head_ - tail_ < CHUNKS || quit_; });
+				if (quit_) {
+					return;
+				}
+			}
+
+			// The consumer doesn't touch chunks until they are published
+			auto& chunk = chunks_[head_ % CHUNKS];
+			auto size = size_t{0};
+			while (size < CHUNK_LINES && position < log_.size()) {
+				const auto* newline = static_cast<const char*>(std::memchr(log_.data() + position, '\n', log_.size() - position));
+				const auto end = newline != nullptr ? static_cast<size_t>(newline - log_.data()) : log_.size();
+				auto& line = chunk[size];
+				line.text = log_.substr(position, end - position);
+				line.number = ++number;
+				position = end + 1;
+
+				if (line.text.substr(0, 2) != "A:") {
+					continue;
+				}
+				if (!parse_binjgb_line(line.text, line.state)) {
+					error = "Line " + std::to_string(line.number) + " isn't a binjgb log line: " + std::string{line.text};
+					break;
+				}
+				++size;
+			}
+
+			const auto lock = std::scoped_lock{mutex_};
+			sizes_[head_ % CHUNKS] = size;
+			++head_;
+			chunk_parsed_.notify_one();
+		}
+
+		const auto lock = std::scoped_lock{mutex_};
+		error_ = std::move(error);
+		done_ = true;
+		chunk_parsed_.notify_one();
+	}
+
+	std::string_view log_ = {};
+	std::array<std::vector<Line>, CHUNKS> chunks_ = {};
+	std::array<size_t, CHUNKS> sizes_ = {};
+
+	// Chunk being read, owned by the consumer
+	size_t position_ = {};
+	size_t size_ = {};
+	bool taken_ = {};
+
+	std::mutex mutex_ = {};
+	std::condition_variable chunk_parsed_ = {};
+	std::condition_variable chunk_free_ = {};
+	// Chunks parsed and consumed, both only grow
+	uint64_t head_ = {};
+	uint64_t tail_ = {};
+	bool done_ = {};
+	bool quit_ = {};
+	std::string error_ = {};
+	std::thread parser_ = {};
+};
+
+// Steps `emulator` once per line of `log` until they differ, the log ends or options.max_instructions ran. Lines which
+// don't start with "A:" are skipped, malformed ones throw std::runtime_error. The log is parsed on another thread.
+template<bool headless>
+[[nodiscard]] auto trace_diff(Emulator<headless>& emulator, const std::string_view& log, const TraceDiffOptions& options = {}) -> TraceDiffResult
+{
+	struct Step {
+		std::string_view line = {};
+		InstructionRecord record = {};
+	};
+	// Last matching steps, only looked at once they diverge
+	auto history = std::vector<Step>(options.context);
+	// Oldest step once the history is full
+	auto next_step = size_t{0};
+
+	auto result = TraceDiffResult{};
+	auto parser = BinjgbLogParser{log};
+	while (options.max_instructions == 0 || result.instructions < options.max_instructions) {
+		const auto* line = parser.next();
+		if (line == nullptr) {
+			break;
+		}
+		const auto& expected = line->state;
+		result.line_number = line->number;
+
+		const auto record = emulator.instruction_record();
+		// The register file is compared first, it's what nearly always differs
+		if (expected.registers != record.registers || expected.SP != record.SP || expected.PC != record.PC
+		    || (options.compare_cycles && expected.cycles != record.cycles * 4) || (options.compare_ppu_mode && expected.ppu_mode != record.ppu_mode)) {
+			result.diverged = true;
+
+			const auto instructions = get_all_instructions();
+			const auto context = std::min<uint64_t>(options.context, result.instructions);
+			auto& report = result.report;
+			report = "Diverged after " + std::to_string(result.instructions) + " instructions, at line " + std::to_string(result.line_number)
+			  + " of the log\n";
+			for (auto i = history.size() - context; i < history.size(); ++i) {
+				const auto& step = history[(next_step + i) % history.size()];
+				report += "  log: " + std::string{step.line} + "\n  our: ";
+				append_binjgb_line(report, step.record, instruction_record_mnemonic(step.record, instructions));
+			}
+			report += "> log: " + std::string{line->text} + "\n> our: ";
+			append_binjgb_line(report, record, instruction_record_mnemonic(record, instructions));
+			report += "Differs in " + trace_diff_fields(expected, record, options) + " (log != our)\n";
+			return result;
+		}
+
+		if (!history.empty()) {
+			history[next_step] = {line->text, record};
+			next_step = next_step + 1 == history.size() ? 0 : next_step + 1;
+		}
+		++result.instructions;
+		emulator.step();
+	}
+	return result;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Repeats every pixel of the row `scale` times
+inline auto upscale_row(const uint32_t* src, const int& width, uint32_t* dst, const int& scale) -> void
+{
+	auto x = 0;
+
+#if defined(__SSE2__)
+	if (scale == 2) {
+		for (; x + 4 <= width; x += 4) {
+			const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2), _mm_unpacklo_epi32(pixels, pixels));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 2 + 4), _mm_unpackhi_epi32(pixels, pixels));
+		}
+	}
+	else if (scale == 4) {
+		for (; x + 4 <= width; x += 4) {
+			const auto pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+			auto* out = reinterpret_cast<__m128i*>(dst + x * 4);
+			_mm_storeu_si128(out + 0, _mm_shuffle_epi32(pixels, 0x00));
+			_mm_storeu_si128(out + 1, _mm_shuffle_epi32(pixels, 0x55));
+			_mm_storeu_si128(out + 2, _mm_shuffle_epi32(pixels, 0xaa));
+			_mm_storeu_si128(out + 3, _mm_shuffle_epi32(pixels, 0xff));
+		}
+	}
+	else if (scale > 4) {
+		for (; x < width; ++x) {
+			const auto pixel = _mm_set1_epi32(static_cast<int>(src[x]));
+			auto* out = dst + x * scale;
+			auto i = 0;
+			for (; i + 4 <= scale; i += 4) { _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), pixel); }
+			for (; i < scale; ++i) { out[i] = src[x]; }
+		}
+	}
+#endif
+
+	for (; x < width; ++x) {
+		for (auto i = 0; i < scale; ++i) { dst[x * scale + i] = src[x]; }
+	}
+}
+
+// Nearest-neighbour integer upscale of 32-bit pixels, pitches are in pixels.
+// Every source row is expanded once and then copied to the remaining `scale - 1` rows.
+inline auto upscale_nearest(
+  const uint32_t* src, const int& width, const int& height, const int& src_pitch, uint32_t* dst, const int& dst_pitch, const int& scale)
+  -> void
+{
+	for (auto y = 0; y < height; ++y) {
+		auto* row = dst + y * scale * dst_pitch;
+		upscale_row(src + y * src_pitch, width, row, scale);
+
+		for (auto i = 1; i < scale; ++i) { std::memcpy(row + i * dst_pitch, row, sizeof(uint32_t) * width * scale); }
+	}
+}
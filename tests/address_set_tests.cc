@@ -0,0 +1,49 @@
+#include "batch_runner.h"
+#include "catch2/catch.hpp"
+#include "test_utils.h"
+
+TEST_CASE("Consecutive addresses are copied at once", "[address_set]")
+{
+	const auto addresses = AddressSet{{0xc000, 0xc001, 0xc002, 0xff80, 0xd057, 0xd058, 0xc000}};
+	CHECK(addresses.size() == 7);
+	CHECK(addresses.runs() == 4);
+	CHECK_FALSE(addresses.needs_ppu_sync());
+	CHECK(AddressSet{{0xc000, 0xff44}}.needs_ppu_sync());
+
+	auto memory = std::vector<uint8_t>(0x10000);
+	for (auto i = size_t{0}; i < memory.size(); ++i) { memory[i] = static_cast<uint8_t>(i * 7 + (i >> 8)); }
+
+	auto out = std::vector<uint8_t>(addresses.size());
+	addresses.gather(memory.data(), out.data());
+	for (auto i = size_t{0}; i < out.size(); ++i) { CHECK(out[i] == memory[addresses.addresses()[i]]); }
+}
+
+TEST_CASE("Addresses outside of the memory array are rejected", "[address_set]")
+{
+	for (const auto address : {0x0000, 0x7fff, 0xa000, 0xbfff, 0xfea0, 0xff00}) {
+		CHECK_THROWS_AS(AddressSet(std::vector<uint16_t>{0xc000, static_cast<uint16_t>(address)}), std::invalid_argument);
+	}
+	CHECK_NOTHROW(AddressSet(std::vector<uint16_t>{0x8000, 0xc000, 0xdfff, 0xfe00, 0xff44, 0xff80, 0xffff}));
+}
+
+TEST_CASE("Batch gather gives what read_memory does", "[address_set]")
+{
+	const auto rom = write_test_rom("grayboy_address_set_tests.gb");
+	const auto addresses = AddressSet{{0xc000, 0x8000, 0xff44, 0xff0f, 0xc000, 0xc001}};
+
+	auto batch = BatchRunner{std::vector<std::string>(3, rom), 2};
+	batch.set_headless_rendering(true);
+	batch.emulator(1).run_frame();
+	batch.emulator(2).run_cycles(12345);
+
+	auto gathered = std::vector<uint8_t>(batch.size() * addresses.size());
+	batch.gather(addresses, gathered.data());
+
+	for (auto instance = size_t{0}; instance < batch.size(); ++instance) {
+		for (auto i = size_t{0}; i < addresses.size(); ++i) {
+			INFO("instance " << instance << ", address " << addresses.addresses()[i]);
+			CHECK(gathered[instance * addresses.size() + i] == batch.emulator(instance).read_memory(addresses.addresses()[i]));
+		}
+	}
+	CHECK(gathered[addresses.size()] != gathered[0]);
+}
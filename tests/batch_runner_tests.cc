@@ -0,0 +1,60 @@
+#include "batch_runner.h"
+#include "catch2/catch.hpp"
+#include "test_utils.h"
+#include "thread_pool.h"
+
+TEST_CASE("Every task runs exactly once", "[batch]")
+{
+	auto pool = WorkStealingPool{4};
+
+	for (const auto count : {size_t{1}, size_t{3}, size_t{1000}}) {
+		auto runs = std::vector<std::atomic<int>>(count);
+		pool.run(count, [&](const size_t& index) { ++runs[index]; });
+
+		auto wrong = 0;
+		for (const auto& run : runs) { wrong += run != 1; }
+		CHECK(wrong == 0);
+	}
+}
+
+TEST_CASE("Task exception is rethrown after the batch", "[batch]")
+{
+	auto pool = WorkStealingPool{2};
+	auto finished = std::atomic<int>{};
+
+	CHECK_THROWS_AS(pool.run(10,
+	                  [&](const size_t& index) {
+		                  if (index == 3) {
+			                  throw std::runtime_error{"task"};
+		                  }
+		                  ++finished;
+	                  }),
+	  std::runtime_error);
+	CHECK(finished == 9);
+
+	// Pool is still usable
+	pool.run(5, [&](const size_t&) { ++finished; });
+	CHECK(finished == 14);
+}
+
+TEST_CASE("Batch gives the same results as sequential run", "[batch]")
+{
+	const auto rom = write_test_rom("grayboy_batch_tests.gb");
+
+	auto batch = BatchRunner{std::vector<std::string>(8, rom), 3};
+	batch.run_frames(4);
+	batch.run_cycles(1000);
+
+	auto sequential = Emulator<true>{rom};
+	for (auto i = 0; i < 4; ++i) { sequential.run_frame(); }
+	sequential.run_cycles(1000);
+
+	auto expected = EmulatorState{};
+	sequential.save_state(expected);
+
+	for (auto i = size_t{0}; i < batch.size(); ++i) {
+		auto actual = EmulatorState{};
+		batch.emulator(i).save_state(actual);
+		CHECK(actual == expected);
+	}
+}
@@ -0,0 +1,230 @@
+#include "catch2/catch.hpp"
+#include "grayboy.h"
+#include "synthetic_roms.h"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Every allocation of the process, the library's included
+auto allocations = std::atomic<size_t>{0};
+
+} // namespace
+
+auto operator new(std::size_t size) -> void*
+{
+	++allocations;
+	if (auto* memory = std::malloc(size == 0 ? 1 : size)) {
+		return memory;
+	}
+	throw std::bad_alloc{};
+}
+
+auto operator delete(void* memory) noexcept -> void
+{
+	std::free(memory);
+}
+
+auto operator delete(void* memory, std::size_t /*size*/) noexcept -> void
+{
+	std::free(memory);
+}
+
+namespace {
+
+using GrayboyPtr = std::unique_ptr<grayboy, decltype(&grayboy_destroy)>;
+using StatePtr = std::unique_ptr<grayboy_state, decltype(&grayboy_state_destroy)>;
+
+// Sets a palette and keeps writing an increasing value into the first tile (row 0) and WRAM
+auto test_rom() -> std::vector<uint8_t>
+{
+	auto rom = std::vector<uint8_t>(0x8000, 0x00);
+
+	// nop; jp 0x150
+	const auto entry = std::array<uint8_t, 4>{0x00, 0xc3, 0x50, 0x01};
+	std::copy(begin(entry), end(entry), begin(rom) + 0x100);
+
+	// ld a, 0xe4; ldh (0x47), a
+	// loop: inc a; ld (0x8000), a; ld (0xc000), a; jr loop
+	const auto program = std::array<uint8_t, 13>{0x3e, 0xe4, 0xe0, 0x47, 0x3c, 0xea, 0x00, 0x80, 0xea, 0x00, 0xc0, 0x18, 0xf7};
+	std::copy(begin(program), end(program), begin(rom) + 0x150);
+
+	return rom;
+}
+
+auto create() -> GrayboyPtr
+{
+	const auto rom = test_rom();
+	return {grayboy_create(rom.data(), rom.size()), grayboy_destroy};
+}
+
+auto framebuffer(const grayboy* gb) -> std::vector<uint8_t>
+{
+	const auto* pixels = grayboy_framebuffer(gb);
+	return {pixels, pixels + GRAYBOY_WIDTH * GRAYBOY_HEIGHT};
+}
+
+} // namespace
+
+TEST_CASE("Invalid ROM is rejected", "[c_api]")
+{
+	const auto rom = std::vector<uint8_t>(0x100, 0x00);
+	CHECK(grayboy_create(rom.data(), rom.size()) == nullptr);
+	CHECK(grayboy_create(nullptr, 0x8000) == nullptr);
+	CHECK(grayboy_api_version() == GRAYBOY_API_VERSION);
+}
+
+TEST_CASE("Frames end at VBlank and are rendered", "[c_api]")
+{
+	const auto gb = create();
+	REQUIRE(gb);
+
+	// 70224 clocks per frame
+	CHECK(grayboy_step_frames(gb.get(), 1) > 0);
+	grayboy_write(gb.get(), 0xff0f, 0x00);
+	const auto cycles = grayboy_step_frames(gb.get(), 1);
+	CHECK(cycles >= 17'550);
+	CHECK(cycles <= 17'560);
+	// No interupts are enabled, the VBlank request stays in IF
+	CHECK((grayboy_read(gb.get(), 0xff0f) & 0x01) != 0);
+
+	// Only row 0 of the tile has any pixels set
+	const auto pixels = framebuffer(gb.get());
+	auto set_in_first_rows = 0;
+	auto set_elsewhere = 0;
+	for (auto y = 0; y < GRAYBOY_HEIGHT; ++y) {
+		for (auto x = 0; x < GRAYBOY_WIDTH; ++x) {
+			const auto set = pixels[y * GRAYBOY_WIDTH + x] != 0;
+			(y % 8 == 0 ? set_in_first_rows : set_elsewhere) += set;
+		}
+	}
+	CHECK(set_in_first_rows > 0);
+	CHECK(set_elsewhere == 0);
+
+	CHECK(grayboy_step_cycles(gb.get(), 1000) >= 1000);
+	CHECK(std::string(grayboy_last_error(gb.get())).empty());
+}
+
+TEST_CASE("Memory can be read and written", "[c_api]")
+{
+	const auto gb = create();
+	REQUIRE(gb);
+
+	grayboy_write(gb.get(), 0xc100, 42);
+	CHECK(grayboy_read(gb.get(), 0xc100) == 42);
+
+	// Header of the ROM
+	CHECK(grayboy_read(gb.get(), 0x101) == 0xc3);
+}
+
+TEST_CASE("Loading a state repeats the same frames", "[c_api]")
+{
+	const auto gb = create();
+	REQUIRE(gb);
+	const auto state = StatePtr{grayboy_state_create(), grayboy_state_destroy};
+	REQUIRE(state);
+
+	grayboy_step_frames(gb.get(), 3);
+	REQUIRE(grayboy_save_state(gb.get(), state.get()) == GRAYBOY_OK);
+
+	grayboy_step_frames(gb.get(), 5);
+	const auto expected_pixels = framebuffer(gb.get());
+	const auto expected_value = grayboy_read(gb.get(), 0xc000);
+
+	REQUIRE(grayboy_load_state(gb.get(), state.get()) == GRAYBOY_OK);
+	grayboy_step_frames(gb.get(), 5);
+	CHECK(framebuffer(gb.get()) == expected_pixels);
+	CHECK(grayboy_read(gb.get(), 0xc000) == expected_value);
+
+	CHECK(grayboy_load_state(gb.get(), nullptr) == GRAYBOY_ERROR);
+	CHECK(std::string(grayboy_last_error(gb.get())) == "state is null");
+	CHECK(grayboy_save_state(gb.get(), nullptr) == GRAYBOY_ERROR);
+	CHECK(std::string(grayboy_last_error(gb.get())) == "state is null");
+}
+
+TEST_CASE("Only states saved from the same ROM can be loaded", "[c_api]")
+{
+	const auto gb = create();
+	REQUIRE(gb);
+	const auto never_saved = StatePtr{grayboy_state_create(), grayboy_state_destroy};
+	REQUIRE(never_saved);
+
+	grayboy_step_frames(gb.get(), 2);
+	const auto value = grayboy_read(gb.get(), 0xc000);
+	CHECK(grayboy_load_state(gb.get(), never_saved.get()) == GRAYBOY_ERROR);
+	CHECK(!std::string(grayboy_last_error(gb.get())).empty());
+
+	// Same size, one byte of the program differs
+	auto rom = test_rom();
+	rom[0x151] = 0xe5;
+	const auto other = GrayboyPtr{grayboy_create(rom.data(), rom.size()), grayboy_destroy};
+	REQUIRE(other);
+	const auto state = StatePtr{grayboy_state_create(), grayboy_state_destroy};
+	REQUIRE(state);
+	REQUIRE(grayboy_save_state(other.get(), state.get()) == GRAYBOY_OK);
+	CHECK(grayboy_load_state(gb.get(), state.get()) == GRAYBOY_ERROR);
+
+	// Nothing was loaded
+	CHECK(grayboy_read(gb.get(), 0xc000) == value);
+	CHECK(grayboy_load_state(other.get(), state.get()) == GRAYBOY_OK);
+}
+
+TEST_CASE("Stepping frames doesn't allocate", "[c_api]")
+{
+	// Serial output is collected too, the writer sends many times what is kept
+	for (const auto& synthetic : {synthetic_sprite_scene(), synthetic_serial_writer()}) {
+		INFO(synthetic.name);
+		const auto gb = GrayboyPtr{grayboy_create(synthetic.rom.data(), synthetic.rom.size()), grayboy_destroy};
+		REQUIRE(gb);
+		grayboy_step_frames(gb.get(), 2);
+
+		const auto before = allocations.load();
+		grayboy_step_frames(gb.get(), 60);
+		CHECK(allocations.load() - before == 0);
+	}
+}
+
+TEST_CASE("Reset gives the same run as a new emulator", "[c_api]")
+{
+	const auto gb = create();
+	const auto fresh = create();
+	REQUIRE(gb);
+	REQUIRE(fresh);
+
+	grayboy_step_frames(gb.get(), 7);
+	REQUIRE(grayboy_reset(gb.get()) == GRAYBOY_OK);
+
+	CHECK(grayboy_step_frames(gb.get(), 4) == grayboy_step_frames(fresh.get(), 4));
+	CHECK(grayboy_read(gb.get(), 0xc000) == grayboy_read(fresh.get(), 0xc000));
+}
+
+TEST_CASE("Joypad reads as pressed and requests an interupt", "[c_api]")
+{
+	const auto gb = create();
+	REQUIRE(gb);
+
+	// Select direction keys
+	grayboy_write(gb.get(), 0xff00, 0x20);
+	grayboy_write(gb.get(), 0xff0f, 0x00);
+	grayboy_set_joypad(gb.get(), GRAYBOY_RIGHT | GRAYBOY_START);
+
+	CHECK((grayboy_read(gb.get(), 0xff00) & 0x0f) == 0x0e);
+	CHECK((grayboy_read(gb.get(), 0xff0f) & 0x10) != 0);
+
+	grayboy_set_joypad(gb.get(), 0);
+	CHECK((grayboy_read(gb.get(), 0xff00) & 0x0f) == 0x0f);
+}
+
+TEST_CASE("Null emulator is an error, not a crash", "[c_api]")
+{
+	CHECK(grayboy_step_frames(nullptr, 1) == 0);
+	CHECK(grayboy_reset(nullptr) == GRAYBOY_ERROR);
+	CHECK(grayboy_framebuffer(nullptr) == nullptr);
+	grayboy_destroy(nullptr);
+}
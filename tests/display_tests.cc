@@ -0,0 +1,108 @@
+#include "catch2/catch.hpp"
+#include "display.h"
+#include "emulator.h"
+#include "synthetic_roms.h"
+
+#include <map>
+#include <set>
+
+TEST_CASE("Frame is presented scaled with the dummy video driver", "[display]")
+{
+	// No hardware renderer with the dummy driver, the frame goes through the software upscaler
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+	auto mem = Memory{};
+	for (auto address = 0x8000; address < 0xa000; ++address) { mem.write(address, std::rand()); }
+	// LCD and background on
+	mem.direct_write(0xff40, 0x91);
+	mem.direct_write(0xff47, 0xe4);
+
+	auto display = Display<false>{};
+	display.catch_up(mem, display.CYCLES_PER_FRAME / 4);
+	display.render();
+
+	const auto* surface = SDL_GetWindowSurface(display.window());
+	REQUIRE(surface != nullptr);
+
+	const auto scale = surface->w / display.WIDTH;
+	REQUIRE(scale >= 1);
+
+	// Palette is not known here, but every shade has to map to a single color and every pixel fill a scale x scale block
+	auto colors = std::map<uint8_t, Uint32>{};
+	auto mismatches = 0;
+
+	for (auto y = 0; y < display.HEIGHT * scale; ++y) {
+		const auto* row = reinterpret_cast<const Uint32*>(static_cast<const Uint8*>(surface->pixels) + y * surface->pitch);
+		for (auto x = 0; x < display.WIDTH * scale; ++x) {
+			const auto shade = display.framebuffer()[y / scale * 160 + x / scale];
+			const auto [it, inserted] = colors.emplace(shade, row[x]);
+			mismatches += it->second != row[x];
+		}
+	}
+
+	auto distinct_colors = std::set<Uint32>{};
+	for (const auto& [shade, color] : colors) { distinct_colors.insert(color); }
+
+	CHECK(mismatches == 0);
+	CHECK(distinct_colors.size() == 4);
+
+	SDL_Quit();
+}
+
+TEST_CASE("Turbo renders and presents only the frames it doesn't skip", "[display]")
+{
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+	// Sprites move every frame, so every rendered frame differs from the previous one
+	auto emulator = Emulator<false>{Cartridge{synthetic_sprite_scene().rom}};
+	auto metrics = FrameMetrics{};
+	emulator.set_frame_metrics(&metrics);
+	emulator.set_turbo_settings({.speed = 0, .skip_frames = 3, .frames = 4});
+
+	const auto run = [&](const int& frames) {
+		auto rendered = std::vector<bool>{};
+		auto presented = std::vector<bool>{};
+		for (auto frame = 0; frame < frames; ++frame) {
+			const auto previous = emulator.framebuffer();
+			emulator.run_frame();
+			rendered.push_back(emulator.framebuffer() != previous);
+			emulator.present_frame();
+			presented.push_back(metrics.current(FrameMetrics::compose) > FrameMetrics::Clock::duration{});
+			metrics.end_frame();
+		}
+		return std::pair{rendered, presented};
+	};
+
+	run(2);
+
+	// Whether a frame is rendered is decided when the previous one ends, so switching takes effect a frame later
+	emulator.set_turbo(true);
+	const auto [rendered, presented] = run(12);
+	const auto one_in_four = std::vector<bool>{true, false, false, true, false, false, false, true, false, false, false, true};
+	CHECK(rendered == one_in_four);
+	CHECK(presented == one_in_four);
+
+	emulator.set_turbo(false);
+	const auto [normal_rendered, normal_presented] = run(4);
+	const auto all_but_first = std::vector<bool>{false, true, true, true};
+	CHECK(normal_rendered == all_but_first);
+	CHECK(normal_presented == all_but_first);
+}
+
+TEST_CASE("Syncing to the display without a renderer falls back to the pacer", "[display]")
+{
+	// Window surface only with the dummy driver, nothing to present with vsync
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+	auto display = Display<false>{};
+	display.set_sync_to_display_refresh(true);
+	CHECK_FALSE(display.vsync());
+
+	// Frames are still paced, not run as fast as presenting allows
+	display.render();
+	display.render();
+	CHECK(display.frame_time_stats().frames == 1);
+	CHECK(display.frame_time_stats().mean_ms > 10);
+
+	SDL_Quit();
+}
@@ -0,0 +1,95 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "synthetic_roms.h"
+
+#include <filesystem>
+
+TEST_CASE("Histogram percentiles are within a bucket", "[frame_metrics]")
+{
+	for (const auto& value : {uint64_t{0}, uint64_t{15}, uint64_t{16}, uint64_t{17}, uint64_t{1'000'000}, UINT64_MAX}) {
+		const auto index = DurationHistogram::bucket_index(value);
+		REQUIRE(index < DurationHistogram::BUCKETS);
+		CHECK(DurationHistogram::bucket_lower_bound(index) <= value);
+		CHECK((index + 1 == DurationHistogram::BUCKETS || DurationHistogram::bucket_lower_bound(index + 1) > value));
+	}
+
+	auto histogram = DurationHistogram{};
+	CHECK(histogram.percentile(0.5) == 0);
+	for (auto value = uint64_t{1}; value <= 1000; ++value) { histogram.record(value * 1000); }
+
+	CHECK(histogram.count() == 1000);
+	CHECK(histogram.max() == 1'000'000);
+	CHECK(histogram.mean() == Approx(500'500.0));
+	CHECK(histogram.percentile(0.5) >= 500'000);
+	CHECK(histogram.percentile(0.5) <= 500'000 * 1.0625);
+	CHECK(histogram.percentile(0.99) >= 990'000);
+	CHECK(histogram.percentile(0.99) <= 990'000 * 1.0625);
+	CHECK(histogram.percentile(1.0) == 1'000'000);
+	CHECK(histogram.stats().p50_ms == Approx(static_cast<double>(histogram.percentile(0.5)) / 1e6));
+}
+
+TEST_CASE("Histogram can be read while it's recorded into", "[frame_metrics]")
+{
+	auto histogram = DurationHistogram{};
+	auto done = std::atomic<bool>{};
+	auto writer = std::thread{[&] {
+		for (auto i = uint64_t{0}; i < 200'000; ++i) { histogram.record(1000 + i % 100); }
+		done = true;
+	}};
+
+	while (!done) {
+		const auto p50 = histogram.percentile(0.5);
+		CHECK((p50 == 0 || (p50 >= 1000 && p50 <= 1100)));
+	}
+	writer.join();
+	CHECK(histogram.count() == 200'000);
+}
+
+TEST_CASE("Emulator splits frames into CPU and PPU time", "[frame_metrics]")
+{
+	auto metrics = FrameMetrics{};
+	auto emulator = Emulator<true>{Cartridge{synthetic_scx_raster().rom}};
+	emulator.set_headless_rendering(true);
+	emulator.set_frame_metrics(&metrics);
+
+	for (auto frame = 0; frame < 10; ++frame) {
+		emulator.run_frame();
+		metrics.end_frame();
+	}
+	emulator.set_frame_metrics(nullptr);
+	emulator.run_frame();
+
+	CHECK(metrics.frames() == 10);
+	CHECK(metrics.stats(FrameMetrics::frame).count == 9);
+	CHECK(metrics.stats(FrameMetrics::cpu).count == 10);
+	CHECK(metrics.stats(FrameMetrics::cpu).max_ms > 0.0);
+	CHECK(metrics.stats(FrameMetrics::ppu).max_ms > 0.0);
+	// Nothing is presented headless
+	CHECK(metrics.stats(FrameMetrics::present).max_ms == 0.0);
+	CHECK(metrics.current(FrameMetrics::cpu) == FrameMetrics::Clock::duration{});
+
+	const auto json = metrics.json();
+	CHECK(json.rfind("{\"frames\": 10, \"frame\": {\"count\": 9", 0) == 0);
+	CHECK(json.find("\"sleep\": {\"count\": 10") != std::string::npos);
+}
+
+TEST_CASE("Reporter writes the metrics periodically", "[frame_metrics]")
+{
+	const auto path = (std::filesystem::temp_directory_path() / "frame_metrics_tests.json").string();
+	std::filesystem::remove(path);
+
+	auto metrics = FrameMetrics{};
+	metrics.add(FrameMetrics::cpu, std::chrono::milliseconds{5});
+	metrics.end_frame();
+	{
+		const auto reporter = FrameMetricsReporter{metrics, std::chrono::milliseconds{10}, path, false};
+		std::this_thread::sleep_for(std::chrono::milliseconds{50});
+	}
+
+	auto file = std::ifstream(path);
+	auto json = std::string{};
+	std::getline(file, json);
+	CHECK(json == metrics.json().substr(0, metrics.json().size() - 1));
+	CHECK(json.find("\"cpu\": {\"count\": 1, \"mean_ms\": 5,") != std::string::npos);
+	std::filesystem::remove(path);
+}
@@ -0,0 +1,142 @@
+#include "catch2/catch.hpp"
+#include "frame_pacer.h"
+
+#include <vector>
+
+namespace {
+
+// Time only moves when the pacer looks at it: every now() is a microsecond of spinning, sleeps oversleep by `overshoot`
+struct FakeClock {
+	using duration = std::chrono::nanoseconds;
+	using rep = duration::rep;
+	using period = duration::period;
+	using time_point = std::chrono::time_point<FakeClock>;
+	static constexpr bool is_steady = true;
+
+	static auto now() -> time_point
+	{
+		current += std::chrono::microseconds{1};
+		return current;
+	}
+
+	static auto sleep_until(const time_point& time) -> void
+	{
+		current = std::max(current, time + overshoot);
+	}
+
+	// Not at the epoch, the pacer takes a default time point for no frame yet
+	static inline time_point current = time_point{std::chrono::seconds{1}};
+	static inline duration overshoot = {};
+};
+
+using Pacer = BasicFramePacer<FakeClock>;
+
+// Times the frames started at, relative to the pacer's construction
+auto frame_starts(Pacer& pacer, const FakeClock::time_point& start, const int& frames) -> std::vector<Pacer::Duration>
+{
+	auto starts = std::vector<Pacer::Duration>{};
+	for (auto i = 0; i < frames; ++i) {
+		pacer.wait_next_frame();
+		starts.emplace_back(FakeClock::current - start);
+	}
+	return starts;
+}
+
+} // namespace
+
+TEST_CASE("Frames are never started before their deadline", "[frame_pacer]")
+{
+	FakeClock::overshoot = std::chrono::microseconds{300};
+	const auto period = Pacer::Duration{0.002};
+	const auto frames = 30;
+
+	// Deadlines count from the pacer's construction
+	const auto start = FakeClock::current;
+	auto pacer = Pacer{period};
+	const auto starts = frame_starts(pacer, start, frames);
+
+	// Sleeping ends before the deadline and the rest is spun, a frame starts within a few now() calls of it
+	for (auto i = 0; i < frames; ++i) {
+		INFO(i);
+		CHECK(starts[i] >= period * (i + 1));
+		CHECK(starts[i] < period * (i + 1) + std::chrono::microseconds{10});
+	}
+
+	const auto stats = pacer.stats();
+	CHECK(stats.frames == frames - 1);
+	CHECK(stats.mean_ms == Approx(2.0).margin(0.01));
+	CHECK(stats.max_error_ms < 0.01);
+}
+
+TEST_CASE("Spin margin grows until oversleeping no longer delays frames", "[frame_pacer]")
+{
+	// More than the initial margin of 1 ms, less than the largest one
+	FakeClock::overshoot = std::chrono::milliseconds{3};
+	const auto period = Pacer::Duration{0.010};
+	const auto frames = 10;
+
+	const auto start = FakeClock::current;
+	auto pacer = Pacer{period};
+	const auto starts = frame_starts(pacer, start, frames);
+
+	CHECK(starts[0] >= period + std::chrono::milliseconds{1});
+	for (auto i = 1; i < frames; ++i) {
+		INFO(i);
+		CHECK(starts[i] < period * (i + 1) + std::chrono::microseconds{10});
+	}
+}
+
+TEST_CASE("Pacer starts over when it falls far behind", "[frame_pacer]")
+{
+	FakeClock::overshoot = {};
+	const auto period = Pacer::Duration{0.001};
+	auto pacer = Pacer{period};
+
+	pacer.wait_next_frame();
+	FakeClock::current += std::chrono::milliseconds{20};
+
+	// Way past the deadline, the frame starts right away and pacing starts over from it
+	const auto late = FakeClock::current;
+	pacer.wait_next_frame();
+	CHECK(FakeClock::current - late < std::chrono::microseconds{10});
+
+	// Without rebasing the missed frames would be run back to back
+	const auto rebased = FakeClock::current;
+	pacer.wait_next_frame();
+	CHECK(FakeClock::current - rebased >= period - std::chrono::microseconds{10});
+}
+
+TEST_CASE("Frames waited for elsewhere are counted and pacing continues from them", "[frame_pacer]")
+{
+	FakeClock::overshoot = {};
+	const auto period = Pacer::Duration{0.005};
+	auto pacer = Pacer{period};
+
+	// Present blocking for a refresh of 4 ms
+	for (auto i = 0; i < 5; ++i) {
+		FakeClock::current += std::chrono::milliseconds{4};
+		pacer.frame_presented();
+	}
+	CHECK(pacer.stats().frames == 4);
+	CHECK(pacer.stats().mean_ms == Approx(4.0).margin(0.01));
+
+	// A frame that isn't presented is paced a period after the last presented one, not caught up to the construction
+	const auto presented = FakeClock::current;
+	pacer.wait_next_frame();
+	CHECK(FakeClock::current - presented >= period);
+	CHECK(FakeClock::current - presented < period + std::chrono::microseconds{10});
+}
+
+TEST_CASE("Steady clock pacing takes at least the frames' time", "[frame_pacer]")
+{
+	const auto period = FramePacer::Duration{0.002};
+	const auto frames = 10;
+
+	const auto start = FramePacer::Clock::now();
+	auto pacer = FramePacer{period};
+	for (auto i = 0; i < frames; ++i) { pacer.wait_next_frame(); }
+
+	// Only a lower bound, how late the real clock wakes up depends on the machine
+	CHECK(FramePacer::Duration{FramePacer::Clock::now() - start} >= period * frames);
+	CHECK(pacer.stats().frames == frames - 1);
+}
@@ -0,0 +1,83 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "rom_builder.h"
+
+#include <filesystem>
+
+namespace {
+
+// main calls work, which calls inner twice; inner is a busy loop
+auto nested_calls_rom() -> RomBuilder
+{
+	auto builder = RomBuilder{};
+	builder.label("main").call("work").jr("main");
+	builder.label("work").call("inner").call("inner").bytes({0xc9});
+	// ld b, 200; dec b; jr nz; ret
+	builder.label("inner").bytes({0x06, 0xc8}).label("inner_loop").bytes({0x05}).jr_nz("inner_loop").bytes({0xc9});
+	return builder;
+}
+
+} // namespace
+
+TEST_CASE("Samples are attributed to symbols and call stacks", "[guest_profiler]")
+{
+	const auto builder = nested_calls_rom();
+	const auto path = std::filesystem::temp_directory_path() / "guest_profiler_tests.sym";
+	{
+		auto sym = std::ofstream(path);
+		sym << "; File generated by rgblink\n00:0150 Main\n00:0155 Work\n";
+		sym << "00:015c Inner\n00:015e Inner.loop\nbogus line\n00:c000 wCounter\n";
+	}
+
+	auto profiler = GuestProfiler{64};
+	profiler.load_symbols(path.string());
+	std::filesystem::remove(path);
+	CHECK_THROWS_AS(profiler.load_symbols(path.string()), std::runtime_error);
+
+	auto emulator = Emulator<true>{Cartridge{builder.build()}};
+	emulator.set_guest_profiler(&profiler);
+	emulator.run_cycles(100'000);
+	emulator.set_guest_profiler(nullptr);
+
+	CHECK(profiler.samples() >= 100'000 / 64 - 1);
+	CHECK(profiler.depth() <= 2);
+
+	// Nearly all time is in the loop of inner
+	const auto hot = profiler.hot_spots(2);
+	REQUIRE(hot.size() == 2);
+	CHECK(profiler.name(hot[0].location).rfind("Inner+0x", 0) == 0);
+	CHECK(profiler.samples_at(0, 0x15e) + profiler.samples_at(0, 0x15f) > profiler.samples() * 9 / 10);
+	CHECK(profiler.name(GuestProfiler::location(0, 0x0150)) == "Main");
+	CHECK(profiler.name(GuestProfiler::location(1, 0x4000)) == "01:4000");
+
+	const auto collapsed = profiler.collapsed();
+	const auto line = collapsed.find("Main;Work;Inner ");
+	REQUIRE(line != std::string::npos);
+	const auto count = std::stoull(collapsed.substr(line + std::string{"Main;Work;Inner "}.size()));
+	CHECK(count > profiler.samples() * 9 / 10);
+	CHECK(collapsed.find("Inner;Inner") == std::string::npos);
+	CHECK(profiler.report().find("Inner+0x") != std::string::npos);
+}
+
+TEST_CASE("Interupts and RST are frames, without symbols locations are named", "[guest_profiler]")
+{
+	auto builder = RomBuilder{};
+	// VBlank: rst 0x08; reti. rst 0x08: busy loop, ret
+	builder.org(0x08).bytes({0x06, 0xff, 0x05}).relative(0x20, "rst_loop").bytes({0xc9});
+	builder.org(0x0a).label("rst_loop");
+	builder.org(0x40).bytes({0xcf, 0xd9}).org(0x150);
+	// LCD on, VBlank interupt, then HALT in a loop (at 0x159)
+	builder.bytes({0x3e, 0x91, 0xe0, 0x40, 0x3e, 0x01, 0xe0, 0xff, 0xfb}).label("wait").bytes({0x76}).jr("wait");
+
+	auto profiler = GuestProfiler{16};
+	auto emulator = Emulator<true>{Cartridge{builder.build()}};
+	emulator.set_headless_rendering(true);
+	emulator.set_guest_profiler(&profiler);
+	for (auto frame = 0; frame < 10; ++frame) { emulator.run_frame(); }
+
+	const auto collapsed = profiler.collapsed();
+	CHECK(collapsed.find("root;00:0040;00:0008 ") != std::string::npos);
+	// Most of the time is spent in HALT, PC is already past it
+	CHECK(profiler.samples_at(0, 0x15a) > profiler.samples() / 2);
+	CHECK(profiler.depth() == 0);
+}
@@ -0,0 +1,97 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "synthetic_roms.h"
+
+#include <filesystem>
+
+TEST_CASE("Binary trace has every instruction in order", "[instruction_trace]")
+{
+	const auto path = (std::filesystem::temp_directory_path() / "instruction_trace_tests.bin").string();
+	// More than a whole ring of chunks, so the emulator has to wait for the writer at times
+	const auto instructions = InstructionTraceWriter::CHUNK_RECORDS * (InstructionTraceWriter::CHUNKS + 2) + 123;
+	const auto rom = synthetic_mbc_switching().rom;
+	{
+		auto trace = InstructionTraceWriter{path};
+		auto emulator = Emulator<true>{Cartridge{rom}};
+		emulator.set_instruction_trace(&trace);
+		for (auto i = size_t{0}; i < instructions; ++i) { emulator.execute_next(); }
+		emulator.set_instruction_trace(nullptr);
+		emulator.execute_next();
+		CHECK(trace.records() == instructions);
+		CHECK_NOTHROW(trace.finish());
+	}
+
+	auto reference = Emulator<true>{Cartridge{rom}};
+	auto reader = InstructionTraceReader{path};
+	auto record = InstructionRecord{};
+	auto read = size_t{0};
+	auto same = true;
+	auto banks = std::array<bool, 256>{};
+	while (reader.next(record)) {
+		same = same && record == reference.instruction_record();
+		banks[record.bank] = true;
+		reference.execute_next();
+		++read;
+	}
+	CHECK(read == instructions);
+	CHECK(same);
+	CHECK(std::count(begin(banks), end(banks), true) > 1);
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Failed trace writes are reported", "[instruction_trace]")
+{
+	// Every write fails with ENOSPC
+	const auto path = std::string{"/dev/full"};
+
+	// One chunk more than the ring holds waits for the writer to finish the first one, which has failed by then
+	auto trace = InstructionTraceWriter{path};
+	const auto fill_ring = [&] {
+		for (auto i = size_t{0}; i < InstructionTraceWriter::CHUNK_RECORDS * (InstructionTraceWriter::CHUNKS + 1); ++i) {
+			trace.record({});
+		}
+	};
+	CHECK_THROWS_AS(fill_ring(), std::runtime_error);
+	CHECK_THROWS_AS(trace.finish(), std::runtime_error);
+
+	auto unfinished = InstructionTraceWriter{path};
+	unfinished.record({});
+	CHECK_THROWS_AS(unfinished.finish(), std::runtime_error);
+}
+
+TEST_CASE("Records render as binjgb log lines", "[instruction_trace]")
+{
+	const auto instructions = get_all_instructions();
+	auto record = InstructionRecord{};
+	record.registers = {0x01, 0xb0, 0x00, 0x13, 0x00, 0xd8, 0x01, 0x4d};
+	record.SP = 0xfffe;
+	record.PC = 0x0100;
+	record.bytes = {0x00};
+	record.size = 1;
+
+	auto line = std::string{};
+	append_binjgb_line(line, record, instruction_record_mnemonic(record, instructions));
+	CHECK(line == "A:01 F:Z-HC BC:0013 DE:00d8 HL:014d SP:fffe PC:0100 (cy: 0) ppu:+0|[00]0x0100: 00 \t\tNOP \n");
+
+	record.registers = {0xff, 0x40, 0xab, 0xcd, 0x12, 0x34, 0xc0, 0x00};
+	record.PC = 0x4a2f;
+	record.cycles = 1'000'000;
+	record.ppu_mode = 3;
+	record.bytes = {0xcb, 0x00};
+	record.size = 2;
+	line.clear();
+	append_binjgb_line(line, record, instruction_record_mnemonic(record, instructions));
+	CHECK(line == "A:ff F:-N-- BC:abcd DE:1234 HL:c000 SP:fffe PC:4a2f (cy: 4000000) ppu:+3|[00]0x4a2f: cb 00 \t\tRLC B \n");
+}
+
+TEST_CASE("Reader refuses other files", "[instruction_trace]")
+{
+	const auto path = (std::filesystem::temp_directory_path() / "instruction_trace_tests.txt").string();
+	CHECK_THROWS_AS(InstructionTraceReader{path}, std::runtime_error);
+	{
+		auto file = std::ofstream(path);
+		file << "A:01 F:Z-HC BC:0013 DE:00d8 HL:014d SP:fffe PC:0100 (cy: 0) ppu:+0|[00]0x0100: 00 \t\tNOP \n";
+	}
+	CHECK_THROWS_AS(InstructionTraceReader{path}, std::runtime_error);
+	std::filesystem::remove(path);
+}
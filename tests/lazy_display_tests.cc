@@ -0,0 +1,75 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "synthetic_roms.h"
+
+namespace {
+
+// OAM search and LY == LYC interupts, the main loop polls STAT and LY all the time
+auto stat_polling_rom() -> std::vector<uint8_t>
+{
+	auto builder = RomBuilder{};
+	// STAT: push af; ldh a, (0x41); ldh (0x81), a; ldh a, (0x80); inc a; ldh (0x80), a; pop af; reti
+	builder.org(0x48).bytes({0xf5, 0xf0, 0x41, 0xe0, 0x81, 0xf0, 0x80, 0x3c, 0xe0, 0x80, 0xf1, 0xd9}).org(0x150);
+	// ld a, 0x40; ldh (0x45), a; ld a, 0x60; ldh (0x41), a; ld a, 0x02; ldh (0xff), a; ei
+	builder.bytes({0x3e, 0x40, 0xe0, 0x45, 0x3e, 0x60, 0xe0, 0x41, 0x3e, 0x02, 0xe0, 0xff, 0xfb});
+	// ldh a, (0x41); ld b, a; ldh a, (0x44); ld c, a
+	builder.label("poll").bytes({0xf0, 0x41, 0x47, 0xf0, 0x44, 0x4f}).jr("poll");
+	return builder.build();
+}
+
+auto roms() -> std::vector<SyntheticRom>
+{
+	auto result = synthetic_roms();
+	result.push_back({"stat_polling", "", stat_polling_rom()});
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Lazy display gives the same frames as updating it after every instruction", "[lazy_display]")
+{
+	for (const auto& synthetic : roms()) {
+		INFO(synthetic.name);
+		auto lazy = Emulator<true>{Cartridge{synthetic.rom}};
+		lazy.set_headless_rendering(true);
+		auto eager = Emulator<true>{Cartridge{synthetic.rom}};
+		eager.set_headless_rendering(true);
+		eager.set_lazy_display(false);
+
+		auto same = true;
+		for (auto frame = 0; frame < 30; ++frame) {
+			same = same && lazy.run_frame() == eager.run_frame();
+
+			auto lazy_state = EmulatorState{};
+			lazy.save_state(lazy_state);
+			auto eager_state = EmulatorState{};
+			eager.save_state(eager_state);
+			same = same && lazy_state == eager_state && lazy.framebuffer() == eager.framebuffer();
+		}
+		CHECK(same);
+	}
+}
+
+TEST_CASE("Lazy display shows the same STAT, LY and IF between instructions", "[lazy_display]")
+{
+	for (const auto& synthetic : roms()) {
+		INFO(synthetic.name);
+		auto lazy = Emulator<true>{Cartridge{synthetic.rom}};
+		lazy.set_headless_rendering(true);
+		auto eager = Emulator<true>{Cartridge{synthetic.rom}};
+		eager.set_headless_rendering(true);
+		eager.set_lazy_display(false);
+
+		auto same = true;
+		for (auto i = 0; i < 200'000; ++i) {
+			// Only now and then, so the lazy display has cycles of many instructions to catch up with
+			if (i % 37 == 0) {
+				same = same && lazy.instruction_record() == eager.instruction_record();
+				for (const auto address : {0xff41, 0xff44, 0xff0f}) { same = same && lazy.read_memory(address) == eager.read_memory(address); }
+			}
+			lazy.step();
+			eager.step();
+		}
+		CHECK(same);
+	}
+}
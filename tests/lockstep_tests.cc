@@ -0,0 +1,89 @@
+#include "catch2/catch.hpp"
+#include "lockstep_batch.h"
+#include "test_utils.h"
+
+namespace {
+
+// Every lane runs `opcode` from WRAM on its own random registers
+auto check_opcode(const uint16_t& opcode, const bool& avx2) -> void
+{
+	auto batch = LockstepBatch{Cartridge{}, Registers{}};
+	batch.set_avx2(avx2);
+
+	auto expected = std::vector<Registers>{};
+	for (auto lane = size_t{0}; lane < LockstepBatch::LANES; ++lane) {
+		auto regs = getRandomRegisters();
+		regs.write("PC", 0xc000);
+		batch.set_registers(lane, regs);
+		batch.memory(lane).write(0xc000, static_cast<uint8_t>(opcode));
+
+		auto memory = Memory{};
+		memory.write(0xc000, static_cast<uint8_t>(opcode));
+		auto cpu = Cpu{regs};
+		[[maybe_unused]] const auto cycles = cpu.execute_next(memory);
+		expected.push_back(cpu.registers());
+	}
+
+	batch.step();
+
+	for (auto lane = size_t{0}; lane < LockstepBatch::LANES; ++lane) {
+		INFO("opcode " << opcode << ", lane " << lane);
+		CHECK_THAT(batch.registers(lane), RegistersCompare(expected[lane]));
+		CHECK(batch.cycles(lane) == 1);
+	}
+	CHECK(batch.vectorized_instructions() == LockstepBatch::LANES);
+}
+
+} // namespace
+
+TEST_CASE("Vectorized opcodes match the interpreter", "[lockstep]")
+{
+	auto supported = 0;
+	for (auto opcode = uint16_t{0}; opcode <= 0xff; ++opcode) {
+		if (!LockstepBatch::supports(opcode)) {
+			continue;
+		}
+		++supported;
+
+		for (auto round = 0; round < 20; ++round) {
+			check_opcode(opcode, false);
+			check_opcode(opcode, true);
+		}
+	}
+	// nop, 49 loads, 56 ALU ops, 7 inc and 7 dec
+	CHECK(supported == 120);
+}
+
+TEST_CASE("Divergent lanes match separate interpreters", "[lockstep]")
+{
+	const auto path = write_test_rom("grayboy_lockstep_test.gb");
+	const auto initial = RegistersChanger{.AF = 0x01b0, .BC = 0x0013, .DE = 0x00d8, .HL = 0x014d, .PC = 0x0100, .SP = 0xfffe}.get(Registers{});
+
+	auto batch = LockstepBatch{Cartridge{path}, initial};
+
+	auto cpus = std::vector<Cpu>{};
+	auto memories = std::vector<Memory>{};
+	for (auto lane = size_t{0}; lane < LockstepBatch::LANES; ++lane) {
+		// Different A and B per lane make the flags diverge
+		const auto regs = RegistersChanger{.AF = static_cast<uint16_t>(lane * 0x1130), .BC = static_cast<uint16_t>(lane * 0x0f00)}.get(initial);
+		batch.set_registers(lane, regs);
+		cpus.emplace_back(regs);
+		memories.emplace_back(Cartridge{path});
+	}
+
+	for (auto step = 0; step < 5000; ++step) {
+		batch.step();
+		for (auto lane = size_t{0}; lane < LockstepBatch::LANES; ++lane) {
+			[[maybe_unused]] const auto cycles = cpus[lane].execute_next(memories[lane]);
+		}
+	}
+
+	for (auto lane = size_t{0}; lane < LockstepBatch::LANES; ++lane) {
+		INFO("lane " << lane);
+		CHECK_THAT(batch.registers(lane), RegistersCompare(cpus[lane].registers()));
+		CHECK(batch.memory(lane).read(0xc000) == memories[lane].read(0xc000));
+		CHECK(batch.memory(lane).read(0x8000) == memories[lane].read(0x8000));
+	}
+	CHECK(batch.vectorized_instructions() > 0);
+	CHECK(batch.scalar_instructions() > 0);
+}
@@ -0,0 +1,20 @@
+#include "catch2/catch.hpp"
+#include "memory.h"
+
+TEST_CASE("CPU writes keep the mode and coincidence bits of STAT", "[memory]")
+{
+	auto memory = Memory{};
+
+	// Mode 2 and LY == LYC, as the PPU sets them
+	memory.direct_write(0xff41, 0x06);
+	memory.write(0xff41, 0x78);
+	CHECK(memory.direct_read(0xff41) == 0x7e);
+
+	// Interupt sources can be turned off again, the read only bits stay
+	memory.write(0xff41, 0x07);
+	CHECK(memory.direct_read(0xff41) == 0x06);
+
+	// The PPU still changes them
+	memory.direct_write(0xff41, 0x03);
+	CHECK(memory.read(0xff41) == 0x03);
+}
@@ -0,0 +1,156 @@
+#include "catch2/catch.hpp"
+#include "observation.h"
+#include "test_utils.h"
+
+#include <random>
+
+namespace {
+
+auto random_frame(const uint32_t& seed) -> std::vector<uint8_t>
+{
+	auto random = std::mt19937{seed};
+	auto frame = std::vector<uint8_t>(160 * 144);
+	for (auto& shade : frame) { shade = static_cast<uint8_t>(random() % 4); }
+	return frame;
+}
+
+// Straightforward per-pixel version of one frame of an observation
+auto reference_frame(const ObservationSpec& spec, const std::vector<uint8_t>& frame) -> std::vector<uint8_t>
+{
+	const auto step = spec.downsample ? 2 : 1;
+	const auto width = spec.crop_width / step;
+	const auto height = spec.crop_height / step;
+
+	auto shades = std::vector<uint8_t>{};
+	for (auto y = 0; y < height; ++y) {
+		for (auto x = 0; x < width; ++x) {
+			const auto at = [&](const int& dx, const int& dy) {
+				return frame[static_cast<size_t>((spec.crop_y + y * step + dy) * 160 + spec.crop_x + x * step + dx)];
+			};
+			if (spec.downsample) {
+				const auto left = (at(0, 0) + at(0, 1) + 1) / 2;
+				const auto right = (at(1, 0) + at(1, 1) + 1) / 2;
+				shades.push_back(static_cast<uint8_t>((left + right + 1) / 2));
+			}
+			else {
+				shades.push_back(at(0, 0));
+			}
+		}
+	}
+
+	auto result = std::vector<uint8_t>{};
+	for (auto y = 0; y < height; ++y) {
+		for (auto x = 0; x < width; ++x) {
+			const auto shade = shades[static_cast<size_t>(y * width + x)];
+			switch (spec.format) {
+				case ObservationFormat::index:
+					result.push_back(shade);
+					break;
+				case ObservationFormat::grayscale:
+					result.push_back(static_cast<uint8_t>(255 - shade * 85));
+					break;
+				case ObservationFormat::packed_2bpp:
+					if (x % 4 == 0) {
+						result.push_back(0);
+					}
+					result.back() = static_cast<uint8_t>(result.back() | shade << (2 * (x % 4)));
+					break;
+			}
+		}
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Formats, crops and downsampling match the per-pixel reference", "[observation]")
+{
+	const auto frame = random_frame(1);
+	const auto format = GENERATE(ObservationFormat::index, ObservationFormat::grayscale, ObservationFormat::packed_2bpp);
+
+	// Whole frame, odd sizes and offsets and widths that leave remainders after the SIMD loops
+	const auto crops = std::vector<std::array<int, 4>>{{0, 0, 160, 144}, {3, 5, 37, 11}, {1, 0, 159, 144}, {8, 16, 66, 30}, {0, 0, 2, 2}};
+	for (const auto& [x, y, width, height] : crops) {
+		for (const auto downsample : {false, true}) {
+			if (downsample && (width % 2 != 0 || height % 2 != 0)) {
+				continue;
+			}
+
+			const auto spec = ObservationSpec{.format = format, .crop_x = x, .crop_y = y, .crop_width = width, .crop_height = height, .downsample = downsample};
+			auto writer = ObservationWriter{spec, 1};
+			auto observation = std::vector<uint8_t>(writer.observation_size());
+			writer.write(0, frame.data(), observation.data());
+
+			INFO("crop " << x << ", " << y << ", " << width << "x" << height << (downsample ? " downsampled" : ""));
+			CHECK(observation == reference_frame(spec, frame));
+		}
+	}
+}
+
+TEST_CASE("Stacked frames are the last ones, the oldest first", "[observation]")
+{
+	const auto spec = ObservationSpec{.format = ObservationFormat::index, .crop_width = 16, .crop_height = 2, .frame_stack = 3};
+	auto writer = ObservationWriter{spec, 2};
+	const auto size = writer.frame_size();
+	REQUIRE(writer.observation_size() == 3 * size);
+
+	auto frames = std::vector<std::vector<uint8_t>>{};
+	for (auto i = 0u; i < 5; ++i) { frames.push_back(random_frame(i)); }
+	const auto converted = [&](const size_t& index) { return reference_frame(spec, frames[index]); };
+	const auto stacked = [&](const std::vector<uint8_t>& observation, const size_t& position) {
+		return std::vector<uint8_t>(begin(observation) + static_cast<long>(position * size), begin(observation) + static_cast<long>((position + 1) * size));
+	};
+
+	auto observation = std::vector<uint8_t>(writer.observation_size());
+
+	// First frame fills the whole stack
+	writer.write(0, frames[0].data(), observation.data());
+	for (auto position = size_t{0}; position < 3; ++position) { CHECK(stacked(observation, position) == converted(0)); }
+
+	for (auto i = size_t{1}; i < 5; ++i) { writer.write(0, frames[i].data(), observation.data()); }
+	CHECK(stacked(observation, 0) == converted(2));
+	CHECK(stacked(observation, 1) == converted(3));
+	CHECK(stacked(observation, 2) == converted(4));
+
+	// The other instance has its own history
+	writer.write(1, frames[1].data(), observation.data());
+	CHECK(stacked(observation, 0) == converted(1));
+
+	writer.reset(0);
+	writer.write(0, frames[3].data(), observation.data());
+	for (auto position = size_t{0}; position < 3; ++position) { CHECK(stacked(observation, position) == converted(3)); }
+}
+
+TEST_CASE("Invalid specs are rejected", "[observation]")
+{
+	CHECK_THROWS_AS(ObservationWriter(ObservationSpec{.crop_x = 1}, 1), std::invalid_argument);
+	CHECK_THROWS_AS(ObservationWriter(ObservationSpec{.crop_height = 0}, 1), std::invalid_argument);
+	CHECK_THROWS_AS(ObservationWriter(ObservationSpec{.crop_width = 31, .downsample = true}, 1), std::invalid_argument);
+	CHECK_THROWS_AS(ObservationWriter(ObservationSpec{.frame_stack = 0}, 1), std::invalid_argument);
+}
+
+TEST_CASE("Batch is written into one buffer, instance after instance", "[observation]")
+{
+	// ld a, 0xe4; ldh (0x47), a; then changing tile data
+	const auto rom = write_rom("grayboy_observation_tests.gb", {0x3e, 0xe4, 0xe0, 0x47, 0x3c, 0x04, 0x78, 0xea, 0x00, 0x80, 0xea, 0x03, 0x80});
+
+	auto batch = BatchRunner{std::vector<std::string>(4, rom), 2};
+	batch.set_headless_rendering(true);
+	batch.run_frames(3);
+
+	const auto spec = ObservationSpec{.format = ObservationFormat::packed_2bpp, .crop_y = 8, .crop_height = 128, .downsample = true, .frame_stack = 2};
+	auto writer = ObservationWriter{spec, batch.size()};
+	auto observations = std::vector<uint8_t>(batch.size() * writer.observation_size());
+	writer.write(batch, observations.data());
+
+	const auto& framebuffer = batch.emulator(0).framebuffer();
+	const auto expected = reference_frame(spec, std::vector<uint8_t>(begin(framebuffer), end(framebuffer)));
+	CHECK(std::any_of(begin(expected), end(expected), [](const uint8_t& byte) { return byte != 0; }));
+
+	for (auto instance = size_t{0}; instance < batch.size(); ++instance) {
+		for (auto frame = size_t{0}; frame < 2; ++frame) {
+			const auto* start = observations.data() + instance * writer.observation_size() + frame * writer.frame_size();
+			CHECK(std::equal(begin(expected), end(expected), start));
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "opcode_profiler.h"
+#include "synthetic_roms.h"
+
+TEST_CASE("Opcodes are counted, sorted by cycles and exported", "[opcode_profiler]")
+{
+	auto profiler = OpcodeProfiler{};
+	profiler.record(0x00, 1);
+	profiler.record(0x00, 1);
+	profiler.record(0xcb37, 2);
+	profiler.record(0xcd, 6, OpcodeProfiler::now());
+
+	CHECK(profiler.entry(0x00).count == 2);
+	CHECK(profiler.entry(0xcb37).cycles == 2);
+	CHECK(profiler.entry(0x37).count == 0);
+	CHECK(profiler.entry(0xcd).host_samples == 1);
+	CHECK(profiler.sorted() == std::vector<size_t>{0xcd, 0x00, 0x137});
+
+	const auto report = profiler.report();
+	CHECK(report.find("0xcb37  SWAP A") != std::string::npos);
+	CHECK(report.find("total 4 executions, 10 cycles") != std::string::npos);
+	CHECK(report.find("ticks/exec") != std::string::npos);
+
+	const auto json = profiler.json();
+	CHECK(json.find("\"executions\": 4") != std::string::npos);
+	CHECK(json.find("{\"opcode\": \"0xcd\", \"mnemonic\": \"CALL a16\", \"executions\": 1, \"cycles\": 6") != std::string::npos);
+
+	auto total = OpcodeProfiler{};
+	total.merge(profiler);
+	total.merge(profiler);
+	CHECK(total.entry(0x00).count == 4);
+	total.reset();
+	CHECK(total.sorted().empty());
+}
+
+TEST_CASE("The CPU records into the profiler only when it's built in", "[opcode_profiler]")
+{
+	auto& profiler = thread_opcode_profiler();
+	profiler.reset();
+
+	auto emulator = Emulator<true>{Cartridge{synthetic_alu_loop().rom}};
+	emulator.set_headless_rendering(true);
+	emulator.run_frame();
+
+#if defined(GRAYBOY_PROFILE_OPCODES)
+	// swap a runs once per inner loop, as often as dec b
+	CHECK(profiler.entry(0xcb37).count > 1000);
+	CHECK(profiler.entry(0xcb37).count == profiler.entry(0x05).count);
+	CHECK(profiler.entry(0xcb37).cycles == 2 * profiler.entry(0xcb37).count);
+#else
+	CHECK(profiler.sorted().empty());
+#endif
+	profiler.reset();
+}
@@ -0,0 +1,31 @@
+#include "catch2/catch.hpp"
+#include "perf_counters.h"
+
+TEST_CASE("Counters count or are cleanly missing", "[perf_counters]")
+{
+	auto counters = PerfCounters{};
+
+	counters.start();
+	auto sum = uint64_t{0};
+	for (auto i = uint64_t{0}; i < 1'000'000; ++i) { sum += i * i; }
+	const auto counts = counters.stop();
+	CHECK(sum != 0);
+
+	if (!counters.available()) {
+		// E.g. a VM without a PMU or perf_event_paranoid too high
+		CHECK_FALSE(counters.error().empty());
+		for (const auto& count : counts) { CHECK_FALSE(count.has_value()); }
+		return;
+	}
+
+	if (counts[PerfCounters::instructions]) {
+		CHECK(*counts[PerfCounters::instructions] > 1'000'000);
+	}
+
+	// Counting again starts from zero
+	counters.start();
+	const auto empty = counters.stop();
+	if (counts[PerfCounters::instructions] && empty[PerfCounters::instructions]) {
+		CHECK(*empty[PerfCounters::instructions] < *counts[PerfCounters::instructions]);
+	}
+}
@@ -0,0 +1,155 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "test_utils.h"
+
+namespace {
+
+struct Machine {
+	std::vector<uint8_t> memory = std::vector<uint8_t>(0x10000);
+	Registers registers = {};
+	uint64_t frame = {};
+
+	auto evaluate(Predicate& predicate) -> bool
+	{
+		return predicate.evaluate(memory.data(), registers, frame);
+	}
+};
+
+} // namespace
+
+TEST_CASE("Operators follow C precedence", "[predicate]")
+{
+	auto machine = Machine{};
+	const auto holds = [&](const std::string& expression) {
+		auto predicate = Predicate{expression};
+		return machine.evaluate(predicate);
+	};
+
+	CHECK(holds("1 + 2 == 3"));
+	CHECK(holds("0x10 == 16"));
+	CHECK(holds("1 | 2 == 2"));
+	CHECK_FALSE(holds("(1 | 2) == 2"));
+	CHECK(holds("6 & 3 ^ 1 == 3"));
+	CHECK(holds("1 || 0 && 0"));
+	CHECK_FALSE(holds("(1 || 0) && 0"));
+	CHECK(holds("!0 && ~0 == -1 && - 2 + 3 == 1"));
+	CHECK(holds("5 - 2 - 1 == 2"));
+	CHECK(holds("3 <= 3 && 3 >= 3 && 2 < 3 && 3 > 2 && 2 != 3"));
+	CHECK(holds("2 || 0"));
+}
+
+TEST_CASE("Memory, registers and frames are read", "[predicate]")
+{
+	auto machine = Machine{};
+	machine.memory[0xc000] = 0x34;
+	machine.memory[0xc001] = 0x12;
+	machine.memory[0xff80] = 7;
+	machine.registers.write("A", 0x42);
+	machine.registers.write("HL", 0xabcd);
+	machine.registers.write("PC", 0x0150);
+	machine.frame = 61;
+
+	auto predicate = Predicate{"[0xc000] == 0x34 && word[0xc000] == 0x1234 && [0xff80] == 7 && A == 0x42 && H == 0xab && HL == 0xabcd"
+	                           " && PC == 0x150 && frame > 60"};
+	CHECK(machine.evaluate(predicate));
+	CHECK(predicate.watched_addresses() == std::vector<uint16_t>{0xc000, 0xc001, 0xff80});
+	CHECK_FALSE(predicate.needs_ppu_sync());
+	CHECK(Predicate{"[0xff44] == 0x90"}.needs_ppu_sync());
+}
+
+TEST_CASE("Changed compares with the previous evaluation", "[predicate]")
+{
+	auto machine = Machine{};
+	machine.memory[0xd057] = 3;
+
+	auto predicate = Predicate{"changed[0xd057] && previous[0xd057] == 3"};
+	predicate.arm(machine.memory.data());
+	CHECK_FALSE(machine.evaluate(predicate));
+
+	machine.memory[0xd057] = 2;
+	CHECK(machine.evaluate(predicate));
+	// Now 2 is the previous value
+	CHECK_FALSE(machine.evaluate(predicate));
+
+	// Skipped by short-circuit, the previous value is still taken
+	auto skipped = Predicate{"frame == 1 && changed[0xd057]"};
+	skipped.arm(machine.memory.data());
+	machine.memory[0xd057] = 1;
+	CHECK_FALSE(machine.evaluate(skipped));
+	machine.frame = 1;
+	CHECK_FALSE(machine.evaluate(skipped));
+}
+
+TEST_CASE("Invalid expressions are rejected", "[predicate]")
+{
+	for (const auto* expression : {"", "1 +", "(1", "1 2", "[0x4000]", "[0xa000]", "word[0xfe9f]", "[0xff00]", "changed[0x10000]", "X == 1", "1 = 1",
+	       "[c000]"}) {
+		INFO(expression);
+		CHECK_THROWS_AS(Predicate{expression}, std::invalid_argument);
+	}
+
+	auto deep = std::string{};
+	for (auto i = 0; i < 100; ++i) { deep += "1 + ("; }
+	deep += "1" + std::string(100, ')');
+	CHECK_THROWS_AS(Predicate{deep}, std::invalid_argument);
+}
+
+TEST_CASE("Emulator stops right after the watched write", "[predicate]")
+{
+	// inc a; ld (0xc000), a; ...
+	const auto rom = write_test_rom("grayboy_predicate_tests.gb");
+	auto emulator = Emulator<true>{rom};
+	emulator.set_headless_rendering(true);
+	emulator.set_stop_condition(Predicate{"[0xc000] == 0x10"});
+
+	emulator.run_frame();
+	CHECK(emulator.stopped_by_condition());
+	CHECK(emulator.read_memory(0xc000) == 0x10);
+	CHECK(emulator.frames() == 0);
+
+	// Runs to the end of the frame when nothing else happens
+	emulator.set_stop_condition(Predicate{"changed[0xc000] && [0xc000] == 0x05"});
+	emulator.run_frame();
+	CHECK_FALSE(emulator.stopped_by_condition());
+	CHECK(emulator.frames() == 1);
+
+	// The loop stores LY + 1, it stays the same for a few writes
+	const auto before = emulator.read_memory(0xc000);
+	emulator.set_stop_condition(Predicate{"changed[0xc000]"});
+	const auto executed = emulator.execute_instructions(1000);
+	CHECK(emulator.stopped_by_condition());
+	CHECK(executed < 1000);
+	CHECK(emulator.read_memory(0xc000) != before);
+}
+
+TEST_CASE("Register and frame conditions are checked when asked to", "[predicate]")
+{
+	const auto rom = write_test_rom("grayboy_predicate_tests.gb");
+	auto emulator = Emulator<true>{rom};
+	emulator.set_headless_rendering(true);
+
+	// Registers are not watched, only frame ends check them
+	emulator.set_stop_condition(Predicate{"B == 3"});
+	emulator.execute_instructions(1000);
+	CHECK_FALSE(emulator.stopped_by_condition());
+
+	auto registers_check = Emulator<true>{rom};
+	registers_check.set_stop_condition(Predicate{"B == 3"}, StopCheck::instruction);
+	registers_check.execute_instructions(1000);
+	CHECK(registers_check.stopped_by_condition());
+
+	auto frames_check = Emulator<true>{rom};
+	frames_check.set_headless_rendering(true);
+	frames_check.set_stop_condition(Predicate{"frame == 3"}, StopCheck::frame_end);
+	auto frames = 0;
+	while (!frames_check.stopped_by_condition()) {
+		frames_check.run_frame();
+		++frames;
+	}
+	CHECK(frames == 3);
+
+	// Removed condition never stops
+	frames_check.set_stop_condition(std::nullopt);
+	frames_check.run_frame();
+	CHECK_FALSE(frames_check.stopped_by_condition());
+}
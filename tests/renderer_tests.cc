@@ -0,0 +1,63 @@
+#include "catch2/catch.hpp"
+#include "deferred_renderer.h"
+#include "memory.h"
+#include "scanline_renderer.h"
+
+namespace {
+
+auto fill_random_video_memory(Memory& mem) -> void
+{
+	for (auto address = 0x8000; address < 0xa000; ++address) { mem.write(address, std::rand()); }
+	for (auto address = 0xfe00; address < 0xfea0; ++address) { mem.write(address, std::rand() % 170); }
+
+	// LCD and background on, objects on, window on using the second tile map
+	mem.direct_write(0xff40, 0xe3);
+	mem.direct_write(0xff47, 0xe4);
+	mem.direct_write(0xff48, 0xd2);
+	mem.direct_write(0xff49, 0x1b);
+	mem.direct_write(0xff4a, 100);
+	mem.direct_write(0xff4b, 40);
+}
+
+} // namespace
+
+TEST_CASE("Deferred frame matches scanline rendering", "[renderer]")
+{
+	auto mem = Memory{};
+	fill_random_video_memory(mem);
+
+	auto renderer = ScanlineRenderer{};
+	auto deferred = DeferredRenderer{};
+
+	for (auto frame = 0; frame < 3; ++frame) {
+		auto expected = std::array<uint8_t, 160 * 144>{};
+
+		for (auto scanline = 0; scanline < 144; ++scanline) {
+			mem.direct_write(0xff44, scanline);
+			// Raster effect, scroll changes every line
+			mem.direct_write(0xff43, (scanline * 3 + frame) % 256);
+
+			// VRAM and OAM change mid-frame
+			if (scanline == 50 + frame) {
+				for (auto address = 0x8000; address < 0x8800; ++address) { mem.write(address, std::rand()); }
+				mem.write(0xfe00 + frame, scanline);
+			}
+			// Single bytes of the window tile map and of the last OAM block
+			if (scanline == 90 + frame) {
+				mem.write(0x9c21 + frame, std::rand());
+				mem.write(0xfe9c, std::rand() % 170);
+			}
+
+			renderer.render(mem, scanline, expected.data() + scanline * 160);
+			deferred.record_scanline(mem);
+		}
+
+		deferred.submit_frame();
+		deferred.finish();
+
+		auto actual = std::array<uint8_t, 160 * 144>{};
+		deferred.copy_frame(actual);
+
+		CHECK(actual == expected);
+	}
+}
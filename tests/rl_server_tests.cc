@@ -0,0 +1,90 @@
+#include "catch2/catch.hpp"
+#include "rl_client.h"
+#include "rl_server.h"
+#include "test_utils.h"
+
+#include <thread>
+
+TEST_CASE("Environments step independently and reset to power-on", "[rl]")
+{
+	const auto path = write_test_rom("grayboy_rl_test.gb");
+	auto environment = RlEnvironment{path, 3, {0xc000, 0xff44}, 2, 2};
+	const auto size = environment.observation_size();
+	REQUIRE(size % 64 == 0);
+
+	const auto ram = [&](const std::vector<uint8_t>& observations, const size_t& env, const size_t& index) {
+		return observations[env * size + RlEnvironment::FRAMEBUFFER_SIZE + index];
+	};
+
+	auto observations = std::vector<uint8_t>(3 * size);
+	environment.reset(std::vector<uint8_t>{1, 1, 1}.data(), observations.data());
+	const auto power_on = ram(observations, 0, 0);
+	CHECK(power_on == 0xff);
+
+	environment.step(std::vector<uint8_t>{0, 0, 0}.data(), observations.data());
+	const auto stepped = ram(observations, 0, 0);
+	CHECK(stepped != power_on);
+	CHECK(ram(observations, 1, 0) == stepped);
+	// Frames end at VBlank
+	CHECK(ram(observations, 2, 1) == 0x91);
+
+	// Only the middle one goes back
+	environment.reset(std::vector<uint8_t>{0, 1, 0}.data(), observations.data());
+	CHECK(ram(observations, 0, 0) == stepped);
+	CHECK(ram(observations, 1, 0) == power_on);
+}
+
+TEST_CASE("Client gets the same observations through the server", "[rl]")
+{
+	const auto path = write_test_rom("grayboy_rl_test.gb");
+	const auto envs = size_t{4};
+	const auto shared_memory_name = "/grayboy-rl-test-" + std::to_string(::getpid());
+
+	auto served = RlEnvironment{path, envs, {0xc000}, 1, 2};
+	auto server = RlServer{served, shared_memory_name, 3};
+	auto reference = RlEnvironment{path, envs, {0xc000}, 1, 2};
+
+	int fds[2] = {};
+	REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+	auto server_thread = std::thread{[&] {
+		server.serve(fds[0]);
+		::close(fds[0]);
+	}};
+
+	{
+		auto client = RlClient{fds[1]};
+		REQUIRE(client.envs() == envs);
+		REQUIRE(client.ram_bytes() == 1);
+		const auto size = served.observation_size();
+
+		auto expected = std::vector<uint8_t>(envs * size);
+		const auto* observations = client.reset(std::vector<uint8_t>(envs, 1));
+		reference.reset(std::vector<uint8_t>(envs, 1).data(), expected.data());
+		CHECK(std::equal(begin(expected), end(expected), observations));
+
+		auto previous = std::vector<const uint8_t*>{};
+		auto previous_copy = std::vector<std::vector<uint8_t>>{};
+		for (auto step = 0; step < 5; ++step) {
+			const auto actions = std::vector<uint8_t>{0, 1, 2, static_cast<uint8_t>(step)};
+			observations = client.step(actions);
+			reference.step(actions.data(), expected.data());
+			CHECK(std::equal(begin(expected), end(expected), observations));
+
+			// The previous `slots - 1` observations are still there
+			if (previous.size() == client.slots() - 1) {
+				for (auto i = size_t{0}; i < previous.size(); ++i) {
+					CHECK(previous[i] != observations);
+					CHECK(std::equal(begin(previous_copy[i]), end(previous_copy[i]), previous[i]));
+				}
+				previous.erase(begin(previous));
+				previous_copy.erase(begin(previous_copy));
+			}
+			previous.push_back(observations);
+			previous_copy.emplace_back(observations, observations + envs * size);
+		}
+
+		CHECK_THROWS_AS(client.step(std::vector<uint8_t>(envs + 1)), std::invalid_argument);
+	}
+
+	server_thread.join();
+}
@@ -0,0 +1,181 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "synthetic_roms.h"
+
+namespace {
+
+// States every time the CPU is about to execute the instruction at `address`
+auto states_at(const std::vector<uint8_t>& rom, const uint16_t& address, const int& count) -> std::vector<EmulatorState>
+{
+	auto emulator = Emulator<true>{Cartridge{rom}};
+	auto stepper = emulator.stepper({.vblank = false, .breakpoints = {address}});
+	auto states = std::vector<EmulatorState>(static_cast<size_t>(count));
+	for (auto& state : states) {
+		stepper.next();
+		emulator.save_state(state);
+	}
+	return states;
+}
+
+// A, C, D and E of alu_loop
+auto alu_loop_registers(const Registers& registers) -> std::array<uint8_t, 4>
+{
+	return {registers.read("A"), registers.read("C"), registers.read("D"), registers.read("E")};
+}
+
+// What one pass of alu_loop's outer loop does to them, carry is always clear before adc a, h
+auto alu_loop_pass(const Registers& registers) -> std::array<uint8_t, 4>
+{
+	auto a = registers.read("A");
+	auto c = registers.read("C");
+	const auto d = registers.read("D");
+	const auto e = registers.read("E");
+	const auto h = registers.read("H");
+	for (auto b = 0xff; b > 0; --b) {
+		a = static_cast<uint8_t>((a + c) ^ d);
+		a = static_cast<uint8_t>((a << 1) | (a >> 7));
+		++c;
+		a = static_cast<uint8_t>((static_cast<uint8_t>(a - e) & 0x7f) | b);
+		a = static_cast<uint8_t>(a + h);
+		a = static_cast<uint8_t>((a << 4) | (a >> 4));
+	}
+
+	return {a, c, static_cast<uint8_t>(d + 1), static_cast<uint8_t>(e + 1)};
+}
+
+} // namespace
+
+TEST_CASE("Labels are resolved for absolute and relative jumps", "[rom_builder]")
+{
+	auto builder = RomBuilder{};
+	builder.label("start").bytes({0x00}).jr_nz("end").jp("start");
+	builder.fill(20, 0x00).label("end").jr("start").absolute(0x21, "data");
+	builder.org(0x4000, 1).label("data").bytes({0x42});
+
+	const auto rom = builder.build();
+	REQUIRE(rom.size() == 0x8000);
+	// jr nz at 0x151, 3 + 20 bytes after its operand
+	CHECK(rom[0x152] == 23);
+	CHECK(rom[0x154] == 0x50);
+	CHECK(rom[0x155] == 0x01);
+	// jr at 0x16a back to 0x150
+	CHECK(static_cast<int8_t>(rom[0x16b]) == 0x150 - 0x16c);
+	CHECK(rom[0x16d] == 0x00);
+	CHECK(rom[0x16e] == 0x40);
+	CHECK(rom[0x4000] == 0x42);
+
+	// Entry point and header
+	CHECK(rom[0x101] == 0xc3);
+	auto checksum = uint8_t{0};
+	for (auto i = 0x134; i <= 0x14c; ++i) { checksum = static_cast<uint8_t>(checksum - rom[i] - 1); }
+	CHECK(rom[0x14d] == checksum);
+	CHECK(RomBuilder{0x01, 8}.build()[0x148] == 2);
+}
+
+TEST_CASE("Mistakes in the program are reported", "[rom_builder]")
+{
+	CHECK_THROWS_AS(RomBuilder(0x00, 3), std::invalid_argument);
+	CHECK_THROWS_AS(RomBuilder{}.jp("nowhere").build(), std::invalid_argument);
+	CHECK_THROWS_AS(RomBuilder{}.label("a").label("a"), std::invalid_argument);
+	CHECK_THROWS_AS(RomBuilder{}.org(0x100).bytes({0x00}), std::invalid_argument);
+	CHECK_THROWS_AS(RomBuilder{}.org(0x4000, 2), std::invalid_argument);
+
+	auto far = RomBuilder{};
+	far.label("start").fill(200, 0x00).jr("start");
+	CHECK_THROWS_AS(far.build(), std::invalid_argument);
+}
+
+TEST_CASE("Synthetic ROMs run the same every time and do what they are for", "[rom_builder]")
+{
+	const auto run = [](const std::vector<uint8_t>& rom, EmulatorState& state) {
+		auto emulator = Emulator<true>{Cartridge{rom}};
+		emulator.set_headless_rendering(true);
+		for (auto frame = 0; frame < 30; ++frame) { emulator.run_frame(); }
+		emulator.save_state(state);
+	};
+
+	for (const auto& synthetic : synthetic_roms()) {
+		INFO(synthetic.name);
+		auto first = EmulatorState{};
+		auto second = EmulatorState{};
+		run(synthetic.rom, first);
+		run(synthetic.rom, second);
+		CHECK(first == second);
+
+		const auto& memory = first.memory.array;
+		if (synthetic.name == "memcpy_loop") {
+			CHECK(std::equal(begin(synthetic.rom), begin(synthetic.rom) + 0x800, begin(memory) + 0xd000));
+		}
+		else if (synthetic.name == "halt_vblank") {
+			// One VBlank every frame, except the first one (before the interupt is enabled) and the last one (run_frame()
+			// returns when VBlank starts, before the CPU wakes up)
+			CHECK(memory[0xc000] >= 28);
+			CHECK(memory[0xc000] <= 30);
+		}
+		else if (synthetic.name == "sprite_scene") {
+			CHECK(memory[0xfe00 + 39 * 4] == 16 + 39 * 3);
+			CHECK(memory[0xfe01] > 8);
+			CHECK(memory[0xfe02] == 1);
+		}
+		else if (synthetic.name == "alu_loop") {
+			// At the start of the outer loop (after setting the palettes)
+			const auto states = states_at(synthetic.rom, 0x156, 4);
+			for (auto pass = size_t{1}; pass < states.size(); ++pass) {
+				INFO(pass);
+				CHECK(alu_loop_registers(states[pass].registers) == alu_loop_pass(states[pass - 1].registers));
+			}
+		}
+		else if (synthetic.name == "scx_raster") {
+			// The HBlank handler copies LY into SCX, the last time on the line before the one the frame ended on. The
+			// VBlank handler has run once for every frame before the last one, run_frame() returns before it runs.
+			CHECK(memory[0xff44] >= 144);
+			CHECK(memory[0xff43] == memory[0xff44] - 1);
+			CHECK(memory[0xff42] == 29);
+		}
+		else if (synthetic.name == "timer_storm") {
+			auto emulator = Emulator<true>{Cartridge{synthetic.rom}};
+			emulator.set_headless_rendering(true);
+			auto dispatched = uint64_t{0};
+			auto counted = uint64_t{0};
+			auto cycles = uint64_t{0};
+			while (emulator.frames() < 30) {
+				cycles += emulator.step();
+				// Dispatch runs in one step with the handler's first instruction, 0x57 follows its write to 0xff80
+				const auto PC = emulator.instruction_record().PC;
+				dispatched += PC == 0x51;
+				counted += PC == 0x57;
+			}
+
+			// TIMA overflows from 0 first (256 ticks of 4 cycles), then every 16 ticks from TMA
+			CHECK(dispatched == 1 + (cycles - 1024) / 64);
+			CHECK(dispatched - counted <= 1);
+			CHECK(memory[0xff80] == static_cast<uint8_t>(counted));
+		}
+		else if (synthetic.name == "serial_writer") {
+			auto emulator = Emulator<true>{Cartridge{synthetic.rom}};
+			emulator.set_headless_rendering(true);
+			for (auto frame = 0; frame < 30; ++frame) { emulator.run_frame(); }
+
+			// Only the latest bytes are kept, every one is the previous one plus 1
+			const auto& link = emulator.get_serial_link();
+			CHECK(first.serial_bytes > emulator.SERIAL_LINK_CAPACITY);
+			CHECK(link.size() <= emulator.SERIAL_LINK_CAPACITY);
+			CHECK(link.size() >= emulator.SERIAL_LINK_CAPACITY / 2);
+			auto not_counting = 0;
+			for (auto i = size_t{1}; i < link.size(); ++i) {
+				not_counting += static_cast<uint8_t>(link[i]) != static_cast<uint8_t>(link[i - 1] + 1);
+			}
+			CHECK(not_counting == 0);
+		}
+		else if (synthetic.name == "mbc_switching") {
+			// Every pass reads 64 bytes from each of banks 1-3 into D
+			const auto states = states_at(synthetic.rom, 0x150, 4);
+			for (auto pass = size_t{1}; pass < states.size(); ++pass) {
+				INFO(pass);
+				const auto sum = static_cast<uint8_t>(states[pass].registers.read("D") - states[pass - 1].registers.read("D"));
+				CHECK(sum == static_cast<uint8_t>(64 * (1 + 2 + 3)));
+				CHECK(states[pass].memory.cartridge.current_rom_bank == 3);
+			}
+		}
+	}
+}
@@ -0,0 +1,70 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "test_utils.h"
+
+namespace {
+
+// Cycles of the longest step (a call or an interupt dispatch) are well below this
+const auto MAX_INSTRUCTION_CYCLES = uint64_t{12};
+
+} // namespace
+
+TEST_CASE("Frame ends with the instruction that requests VBlank", "[run_frame]")
+{
+	const auto rom = write_test_rom("grayboy_run_frame_tests.gb");
+
+	auto framed = Emulator<true>{rom};
+	framed.set_headless_rendering(true);
+	auto stepped = Emulator<true>{rom};
+	stepped.set_headless_rendering(true);
+
+	// No interupts are enabled, IF keeps what the PPU requested until it is cleared here
+	auto total = uint64_t{0};
+	auto stepped_total = uint64_t{0};
+	for (auto frame = 0; frame < 5; ++frame) {
+		INFO(frame);
+		total += framed.run_frame();
+		CHECK((framed.read_memory(0xff0f) & 0x1) != 0);
+		framed.write_memory(0xff0f, 0);
+
+		auto vblank_at = uint64_t{0};
+		while (vblank_at == 0) {
+			stepped_total += stepped.step();
+			if (stepped.read_memory(0xff0f) & 0x1) {
+				vblank_at = stepped_total;
+				stepped.write_memory(0xff0f, 0);
+			}
+		}
+		CHECK(vblank_at == total);
+	}
+	CHECK(framed.frames() == 5);
+}
+
+TEST_CASE("Frames have fixed length with the LCD off", "[run_frame]")
+{
+	// ld a, 0x00; ldh (0x40), a
+	auto emulator = Emulator<true>{write_rom("grayboy_run_frame_lcd_off.gb", {0x3e, 0x00, 0xe0, 0x40})};
+	emulator.set_headless_rendering(true);
+
+	for (auto frame = 0; frame < 3; ++frame) {
+		const auto cycles = emulator.run_frame();
+		CHECK(cycles >= emulator.CYCLES_PER_FRAME);
+		CHECK(cycles < emulator.CYCLES_PER_FRAME + MAX_INSTRUCTION_CYCLES);
+		CHECK(emulator.read_memory(0xff44) == 0);
+	}
+	CHECK(emulator.frames() == 3);
+}
+
+TEST_CASE("Frames have fixed length without the PPU", "[run_frame]")
+{
+	// Headless without rendering doesn't emulate the PPU at all
+	auto emulator = Emulator<true>{write_test_rom("grayboy_run_frame_no_ppu.gb")};
+
+	for (auto frame = 0; frame < 3; ++frame) {
+		const auto cycles = emulator.run_frame();
+		CHECK(cycles >= emulator.CYCLES_PER_FRAME);
+		CHECK(cycles < emulator.CYCLES_PER_FRAME + MAX_INSTRUCTION_CYCLES);
+		CHECK((emulator.read_memory(0xff0f) & 0x1) == 0);
+	}
+	CHECK(emulator.frames() == 3);
+}
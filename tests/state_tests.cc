@@ -0,0 +1,97 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "test_utils.h"
+
+#include <filesystem>
+
+TEST_CASE("Loaded state continues the same way", "[state]")
+{
+	auto emu = Emulator<true>{write_test_rom("grayboy_state_tests.gb")};
+	for (auto i = 0; i < 3; ++i) { emu.run_frame(); }
+
+	auto saved = EmulatorState{};
+	emu.save_state(saved);
+
+	for (auto i = 0; i < 5; ++i) { emu.run_frame(); }
+	auto first = EmulatorState{};
+	emu.save_state(first);
+
+	emu.load_state(saved);
+	auto loaded = EmulatorState{};
+	emu.save_state(loaded);
+	CHECK(loaded == saved);
+
+	for (auto i = 0; i < 5; ++i) { emu.run_frame(); }
+	auto second = EmulatorState{};
+	emu.save_state(second);
+
+	CHECK(second == first);
+	CHECK_FALSE(second == saved);
+}
+
+TEST_CASE("Run-ahead leaves the emulator at the end of the real frame", "[state]")
+{
+	const auto rom = write_test_rom("grayboy_state_tests.gb");
+
+	auto plain = Emulator<true>{rom};
+	auto ahead = Emulator<true>{rom};
+	ahead.set_run_ahead(3);
+
+	for (auto i = 0; i < 4; ++i) {
+		plain.run_host_frame();
+		ahead.run_host_frame();
+	}
+
+	auto expected = EmulatorState{};
+	plain.save_state(expected);
+	auto actual = EmulatorState{};
+	ahead.save_state(actual);
+
+	CHECK(actual == expected);
+	CHECK_THROWS_AS(ahead.set_run_ahead(ahead.MAX_RUN_AHEAD_FRAMES + 1), std::invalid_argument);
+}
+
+TEST_CASE("Run-ahead frames reach neither serial echo nor profilers", "[state]")
+{
+	// inc b; ld a, b; ldh (0x01), a; ld a, 0x81; ldh (0x02), a - a serial byte, then ld c, 0; dec c; jr nz, -3 - a pause
+	const auto rom = write_rom("grayboy_state_serial.gb", {0x04, 0x78, 0xe0, 0x01, 0x3e, 0x81, 0xe0, 0x02, 0x0e, 0x00, 0x0d, 0x20, 0xfd});
+
+	struct Run {
+		std::string echo = {};
+		std::string serial_link = {};
+		std::string profile = {};
+		uint64_t records = {};
+	};
+
+	const auto run = [&](const uint32_t& run_ahead) {
+		auto emulator = Emulator<true>{rom};
+		emulator.set_headless_rendering(true);
+		emulator.set_run_ahead(run_ahead);
+		emulator.set_serial_echo(true);
+		auto profiler = GuestProfiler{64};
+		emulator.set_guest_profiler(&profiler);
+		const auto path = (std::filesystem::temp_directory_path() / "grayboy_state_trace.bin").string();
+		auto trace = InstructionTraceWriter{path};
+		emulator.set_instruction_trace(&trace);
+
+		auto echo = std::ostringstream{};
+		auto* const cout = std::cout.rdbuf(echo.rdbuf());
+		for (auto i = 0; i < 6; ++i) { emulator.run_host_frame(); }
+		std::cout.rdbuf(cout);
+
+		emulator.set_guest_profiler(nullptr);
+		emulator.set_instruction_trace(nullptr);
+		auto result = Run{echo.str(), emulator.get_serial_link(), profiler.collapsed(), trace.records()};
+		std::filesystem::remove(path);
+		return result;
+	};
+
+	const auto plain = run(0);
+	const auto ahead = run(3);
+
+	REQUIRE_FALSE(plain.echo.empty());
+	CHECK(ahead.echo == plain.echo);
+	CHECK(ahead.serial_link == plain.serial_link);
+	CHECK(ahead.profile == plain.profile);
+	CHECK(ahead.records == plain.records);
+}
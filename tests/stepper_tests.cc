@@ -0,0 +1,157 @@
+#include "catch2/catch.hpp"
+#include "emulator.h"
+#include "test_utils.h"
+
+TEST_CASE("Breakpoint stops before the instruction, once per visit", "[stepper]")
+{
+	auto emulator = Emulator<true>{write_test_rom("grayboy_stepper_test.gb")};
+	auto stepper = emulator.stepper({.vblank = false, .breakpoints = {0x150}});
+
+	const auto first = stepper.next();
+	REQUIRE(first);
+	CHECK(first->event == StopEvent::breakpoint);
+	CHECK(first->PC == 0x150);
+
+	// nop; jp 0x150
+	CHECK(first->cycles == 5);
+
+	for (auto i = 0; i < 10; ++i) {
+		const auto stop = stepper.next();
+		REQUIRE(stop);
+		CHECK(stop->event == StopEvent::breakpoint);
+		CHECK(stop->PC == 0x150);
+		// One pass through the loop
+		CHECK(stop->cycles == 17);
+	}
+}
+
+TEST_CASE("Breakpoint on a self loop stops at every pass", "[stepper]")
+{
+	// jr -2
+	auto emulator = Emulator<true>{write_rom("grayboy_stepper_self_loop.gb", {0x18, 0xfe})};
+	auto stepper = emulator.stepper({.vblank = false, .breakpoints = {0x150}});
+
+	const auto first = stepper.next();
+	REQUIRE(first);
+	CHECK(first->event == StopEvent::breakpoint);
+
+	for (auto i = 0; i < 10; ++i) {
+		const auto stop = stepper.next();
+		REQUIRE(stop);
+		CHECK(stop->event == StopEvent::breakpoint);
+		CHECK(stop->PC == 0x150);
+		CHECK(stop->cycles == 3);
+	}
+}
+
+TEST_CASE("Serial bytes are yielded as they are sent", "[stepper]")
+{
+	// ld a, 'H'; ldh (0x01), a; ld a, 0x81; ldh (0x02), a
+	const auto path = write_rom("grayboy_stepper_serial.gb", {0x3e, 'H', 0xe0, 0x01, 0x3e, 0x81, 0xe0, 0x02});
+	auto emulator = Emulator<true>{path};
+	auto stepper = emulator.stepper({.vblank = false, .serial_byte = true});
+
+	for (auto i = 0; i < 3; ++i) {
+		const auto stop = stepper.next();
+		REQUIRE(stop);
+		CHECK(stop->event == StopEvent::serial_byte);
+		CHECK(stop->serial_byte == 'H');
+	}
+	CHECK(emulator.get_serial_link() == "HHH");
+}
+
+TEST_CASE("Headless VBlank stops come every frame worth of cycles", "[stepper]")
+{
+	auto emulator = Emulator<true>{write_test_rom("grayboy_stepper_test.gb")};
+	auto stepper = emulator.stepper({});
+
+	for (auto i = 0; i < 5; ++i) {
+		const auto stop = stepper.next();
+		REQUIRE(stop);
+		CHECK(stop->event == StopEvent::vblank);
+		CHECK(stop->cycles >= emulator.CYCLES_PER_FRAME);
+		CHECK(stop->cycles < emulator.CYCLES_PER_FRAME + 6);
+	}
+}
+
+TEST_CASE("Budget reached with the end of a frame stops for both", "[stepper]")
+{
+	// Without the PPU frames have fixed length, the budget and the frame run out on the same instruction
+	auto emulator = Emulator<true>{write_test_rom("grayboy_stepper_test.gb")};
+	auto stepper = emulator.stepper({.cycle_budget = emulator.CYCLES_PER_FRAME});
+
+	const auto budget = stepper.next();
+	REQUIRE(budget);
+	CHECK(budget->event == StopEvent::cycle_budget);
+	CHECK(budget->cycles >= emulator.CYCLES_PER_FRAME);
+
+	const auto vblank = stepper.next();
+	REQUIRE(vblank);
+	CHECK(vblank->event == StopEvent::vblank);
+	CHECK(vblank->cycles == 0);
+	CHECK(vblank->PC == budget->PC);
+	CHECK(emulator.frames() == 1);
+}
+
+TEST_CASE("Stepper counts frames as run_frame() does", "[stepper]")
+{
+	const auto path = write_test_rom("grayboy_stepper_test.gb");
+	auto stepped = Emulator<true>{path};
+	stepped.set_headless_rendering(true);
+	auto framed = Emulator<true>{path};
+	framed.set_headless_rendering(true);
+	auto stepper = stepped.stepper({});
+
+	for (auto i = 0; i < 5; ++i) {
+		INFO(i);
+		const auto stop = stepper.next();
+		REQUIRE(stop);
+		CHECK(stop->event == StopEvent::vblank);
+		CHECK(stop->cycles == framed.run_frame());
+		CHECK(stepped.frames() == framed.frames());
+	}
+	CHECK(stepped.frames() == 5);
+
+	auto expected = EmulatorState{};
+	framed.save_state(expected);
+	auto actual = EmulatorState{};
+	stepped.save_state(actual);
+	CHECK(actual == expected);
+}
+
+TEST_CASE("Interleaved emulators match uninterrupted runs", "[stepper]")
+{
+	const auto path = write_test_rom("grayboy_stepper_test.gb");
+	const auto count = 64;
+
+	auto emulators = std::vector<std::unique_ptr<Emulator<true>>>{};
+	auto steppers = std::vector<Generator<Stop>>{};
+	auto cycles = std::vector<uint64_t>(count);
+
+	for (auto i = 0; i < count; ++i) {
+		emulators.push_back(std::make_unique<Emulator<true>>(path));
+		// Different budgets make the emulators drift apart
+		steppers.push_back(emulators.back()->stepper({.vblank = false, .cycle_budget = 1000 + static_cast<uint64_t>(i) * 37}));
+	}
+
+	// Round robin on one thread
+	for (auto round = 0; round < 50; ++round) {
+		for (auto i = 0; i < count; ++i) {
+			const auto stop = steppers[i].next();
+			REQUIRE(stop);
+			REQUIRE(stop->event == StopEvent::cycle_budget);
+			cycles[i] += stop->cycles;
+		}
+	}
+
+	for (auto i = 0; i < count; ++i) {
+		auto reference = Emulator<true>{path};
+		CHECK(reference.run_cycles(cycles[i]) == cycles[i]);
+
+		auto expected = EmulatorState{};
+		reference.save_state(expected);
+		auto actual = EmulatorState{};
+		emulators[i]->save_state(actual);
+		CHECK(actual == expected);
+	}
+}
@@ -4,6 +4,8 @@
 #include "cpu.h"
 #include "memory.h"
 
+#include <filesystem>
+#include <fstream>
 #include <iostream>
 #include <sstream>
 
@@ -58,3 +60,31 @@ auto getRandomFlags()
 {
 	return static_cast<uint8_t>(std::rand());
 }
+
+// Writes a ROM running `program` from 0x150 in an endless loop into the temp directory, returns its path
+inline auto write_rom(const std::string& filename, const std::vector<uint8_t>& program) -> std::string
+{
+	auto rom = std::vector<uint8_t>(0x8000, 0x00);
+
+	// nop; jp 0x150
+	const auto entry = std::array<uint8_t, 4>{0x00, 0xc3, 0x50, 0x01};
+	std::copy(begin(entry), end(entry), begin(rom) + 0x100);
+
+	// jr back to the start
+	std::copy(begin(program), end(program), begin(rom) + 0x150);
+	rom[0x150 + program.size()] = 0x18;
+	rom[0x150 + program.size() + 1] = static_cast<uint8_t>(-static_cast<int>(program.size() + 2));
+
+	const auto path = (std::filesystem::temp_directory_path() / filename).string();
+	auto file = std::ofstream(path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(rom.data()), static_cast<std::streamsize>(rom.size()));
+
+	return path;
+}
+
+// ROM with an endless loop changing registers, WRAM and VRAM
+inline auto write_test_rom(const std::string& filename) -> std::string
+{
+	// inc a; ld (0xc000), a; add a, b; inc b; ld (0x8000), a; ldh a, (0x44)
+	return write_rom(filename, {0x3c, 0xea, 0x00, 0xc0, 0x80, 0x04, 0xea, 0x00, 0x80, 0xf0, 0x44});
+}
@@ -0,0 +1,102 @@
+#include "catch2/catch.hpp"
+#include "synthetic_roms.h"
+#include "trace_diff.h"
+
+#include <filesystem>
+
+namespace {
+
+// binjgb log of our own emulator, written by append_binjgb_line()
+auto own_log(const std::vector<uint8_t>& rom, const size_t& instructions) -> std::string
+{
+	const auto names = get_all_instructions();
+	auto emulator = Emulator<true>{Cartridge{rom}};
+	emulator.set_headless_rendering(true);
+	auto log = std::string{};
+	for (auto i = size_t{0}; i < instructions; ++i) {
+		const auto record = emulator.instruction_record();
+		append_binjgb_line(log, record, instruction_record_mnemonic(record, names));
+		emulator.step();
+	}
+	return log;
+}
+
+} // namespace
+
+TEST_CASE("Log lines parse into the state they print", "[trace_diff]")
+{
+	auto line = BinjgbLine{};
+	REQUIRE(parse_binjgb_line("A:ff F:-N-C BC:abcd DE:1234 HL:c000 SP:dff0 PC:4a2f (cy: 4000000) ppu:+3|[00]0x4a2f: cb 00 \t\tRLC B ", line));
+	CHECK(line.registers == std::array<uint8_t, 8>{0xff, 0x50, 0xab, 0xcd, 0x12, 0x34, 0xc0, 0x00});
+	CHECK(line.SP == 0xdff0);
+	CHECK(line.PC == 0x4a2f);
+	CHECK(line.cycles == 4'000'000);
+	CHECK(line.ppu_mode == 3);
+
+	CHECK_FALSE(parse_binjgb_line("A:ff F:-N-C BC:abcd DE:1234 HL:c000 SP:dff0 PC:4a2f (cy: ) ppu:+3|", line));
+	CHECK_FALSE(parse_binjgb_line("A:fg F:-N-C BC:abcd DE:1234 HL:c000 SP:dff0 PC:4a2f (cy: 0) ppu:+3|", line));
+	CHECK_FALSE(parse_binjgb_line("A:ff F:N--C BC:abcd DE:1234 HL:c000 SP:dff0 PC:4a2f (cy: 0) ppu:+3|", line));
+	CHECK_FALSE(parse_binjgb_line("A:ff F:-N-C BC:abcd DE:1234 HL:c000 SP:dff0 PC:4a2f (cy: 0) ppu:+", line));
+}
+
+TEST_CASE("Emulator follows its own log and stops where it was changed", "[trace_diff]")
+{
+	const auto rom = synthetic_sprite_scene().rom;
+	const auto instructions = size_t{50'000};
+	auto log = own_log(rom, instructions);
+	const auto path = (std::filesystem::temp_directory_path() / "trace_diff_tests.log").string();
+	{
+		auto file = std::ofstream(path, std::ios::binary);
+		file << "binjgb log\n" << log;
+	}
+
+	{
+		const auto mapped = MappedFile{path};
+		auto emulator = Emulator<true>{Cartridge{rom}};
+		emulator.set_headless_rendering(true);
+		const auto result = trace_diff(emulator, mapped.view());
+		CHECK_FALSE(result.diverged);
+		CHECK(result.instructions == instructions);
+		CHECK(result.report.empty());
+	}
+	std::filesystem::remove(path);
+	CHECK_THROWS_AS(MappedFile{path}, std::runtime_error);
+
+	// HL of the 30001st instruction
+	auto line_start = size_t{0};
+	for (auto i = 0; i < 30'000; ++i) { line_start = log.find('\n', line_start) + 1; }
+	log[line_start + 31] = log[line_start + 31] == '0' ? '1' : '0';
+
+	auto emulator = Emulator<true>{Cartridge{rom}};
+	emulator.set_headless_rendering(true);
+	const auto result = trace_diff(emulator, log, TraceDiffOptions{.context = 3});
+	CHECK(result.diverged);
+	CHECK(result.instructions == 30'000);
+	CHECK(result.line_number == 30'001);
+	CHECK(result.report.find("Differs in H ") != std::string::npos);
+	// Three lines of context, each from the log and ours
+	CHECK(std::count(begin(result.report), end(result.report), '\n') == 1 + 3 * 2 + 2 + 1);
+
+	auto limited = Emulator<true>{Cartridge{rom}};
+	limited.set_headless_rendering(true);
+	CHECK(trace_diff(limited, log, TraceDiffOptions{.max_instructions = 1000}).instructions == 1000);
+	CHECK_THROWS_AS(trace_diff(limited, "A:01 F:Z-HC BC:0013\n"), std::runtime_error);
+}
+
+TEST_CASE("PPU mode of records is the one STAT shows", "[trace_diff]")
+{
+	for (const auto& synthetic : {synthetic_sprite_scene(), synthetic_scx_raster(), synthetic_halt_vblank()}) {
+		auto emulator = Emulator<true>{Cartridge{synthetic.rom}};
+		emulator.set_headless_rendering(true);
+		auto same = true;
+		for (auto i = 0; i < 100'000; ++i) {
+			// Reading STAT catches the display up, only now and then so cycles pile up in between
+			if (i % 97 == 0) {
+				const auto mode = emulator.instruction_record().ppu_mode;
+				same = same && mode == (emulator.read_memory(0xff41) & 0x3);
+			}
+			emulator.step();
+		}
+		CHECK(same);
+	}
+}
@@ -0,0 +1,58 @@
+#include "catch2/catch.hpp"
+#include "trace.h"
+
+#include <filesystem>
+
+TEST_CASE("Ring hands events over in order and drops them when full", "[trace]")
+{
+	auto ring = std::make_unique<TraceRing>(3);
+	for (auto i = uint64_t{0}; i < TraceRing::CAPACITY + 10; ++i) { ring->push({"event", i, 1, i, true}); }
+	CHECK(ring->dropped() == 10);
+
+	auto next = uint64_t{0};
+	auto in_order = true;
+	ring->drain([&](const TraceEvent& event) { in_order = in_order && event.value == next++; });
+	CHECK(in_order);
+	CHECK(next == TraceRing::CAPACITY);
+
+	ring->push({"after", 5, 0, 0, true});
+	auto names = std::string{};
+	ring->drain([&](const TraceEvent& event) { names += event.name; });
+	CHECK(names == "after");
+}
+
+TEST_CASE("Events are written as Chrome trace JSON", "[trace]")
+{
+	CHECK(trace_event_json({"frame", 1500, 16'000'000, 0, false}, 2) ==
+	      R"({"name": "frame", "ph": "X", "ts": 1.500, "dur": 16000.000, "pid": 1, "tid": 2})");
+	CHECK(trace_event_json({"rom_bank", 2000, 0, 3, true}, 1) ==
+	      R"({"name": "rom_bank", "ph": "i", "ts": 2.000, "s": "t", "args": {"value": 3}, "pid": 1, "tid": 1})");
+
+	const auto path = (std::filesystem::temp_directory_path() / "trace_tests.json").string();
+	{
+		auto tracer = Tracer{path};
+		const auto ring = tracer.add_ring();
+		ring->push({"first", 1000, 10, 0, false});
+		std::this_thread::sleep_for(Tracer::FLUSH_INTERVAL * 3);
+
+		auto other = std::thread{[&] { tracer.add_ring()->push({"second", 2000, 0, 1, true}); }};
+		other.join();
+	}
+
+	auto file = std::ifstream(path);
+	const auto json = std::string{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+	CHECK(json.rfind("[\n{\"name\": \"first\"", 0) == 0);
+	CHECK(json.find("\"tid\": 1},\n{\"name\": \"second\"") != std::string::npos);
+	CHECK(json.find("\"tid\": 2}\n]\n") != std::string::npos);
+	std::filesystem::remove(path);
+}
+
+TEST_CASE("Tracepoints compile to nothing unless enabled", "[trace]")
+{
+	auto evaluated = 0;
+	{
+		GRAYBOY_TRACE_SCOPE("test");
+		GRAYBOY_TRACE_INSTANT("test", ++evaluated);
+	}
+	CHECK(evaluated == (GRAYBOY_TRACEPOINTS_ENABLED ? 1 : 0));
+}
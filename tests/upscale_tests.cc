@@ -0,0 +1,32 @@
+#include "catch2/catch.hpp"
+#include "upscale.h"
+
+#include <vector>
+
+TEST_CASE("Upscaled pixels match nearest neighbour", "[upscale]")
+{
+	// Odd width covers the scalar tail after the SIMD part
+	for (const auto width : {160, 13}) {
+		const auto height = 9;
+		const auto src_pitch = width + 3;
+
+		auto src = std::vector<uint32_t>(src_pitch * height);
+		for (auto& pixel : src) { pixel = static_cast<uint32_t>(std::rand()); }
+
+		for (auto scale = 1; scale <= 6; ++scale) {
+			const auto dst_pitch = width * scale + 5;
+			auto dst = std::vector<uint32_t>(dst_pitch * height * scale);
+
+			upscale_nearest(src.data(), width, height, src_pitch, dst.data(), dst_pitch, scale);
+
+			auto mismatches = 0;
+			for (auto y = 0; y < height * scale; ++y) {
+				for (auto x = 0; x < width * scale; ++x) {
+					mismatches += dst[y * dst_pitch + x] != src[y / scale * src_pitch + x / scale];
+				}
+			}
+			INFO("width " << width << ", scale " << scale);
+			CHECK(mismatches == 0);
+		}
+	}
+}